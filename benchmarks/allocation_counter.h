@@ -0,0 +1,31 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BENCHMARKS_ALLOCATION_COUNTER_H_
+#define BENCHMARKS_ALLOCATION_COUNTER_H_
+
+#include <cstdint>
+
+namespace libmphoto {
+
+// Returns the number of heap allocations made through operator new by the
+// process so far. Allocations made by C libraries such as libxml through
+// malloc are not counted.
+uint64_t GetAllocationCount();
+
+}  // namespace libmphoto
+
+#endif  // BENCHMARKS_ALLOCATION_COUNTER_H_
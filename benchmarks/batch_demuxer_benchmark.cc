@@ -0,0 +1,90 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "libmphoto/batch/batch_demuxer.h"
+#include "libmphoto/remuxer/remuxer.h"
+#include "tests/common/io_helper.h"
+
+namespace libmphoto {
+
+namespace {
+
+constexpr size_t kCorpusSize = 512;
+
+// Every eighth motion photo of the corpus has a video about 25 times longer,
+// so item costs are skewed as in a mix of small jpegs and large files.
+constexpr size_t kLargeItemInterval = 8;
+constexpr int kLargeVideoRepeat = 25;
+
+// Returns a motion photo with the sample video repeated repeat times.
+std::string GenerateMotionPhoto(int repeat) {
+  std::string still =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/still.jpeg");
+  std::string video = GetBytesFromFile("sample_data/mp4/video.mp4");
+  std::string repeated_video;
+  for (int i = 0; i < repeat; i++) {
+    repeated_video += video;
+  }
+
+  Remuxer remuxer;
+  std::string motion_photo;
+  if (!remuxer.SetStill(still).ok() || !remuxer.SetVideo(repeated_video).ok() ||
+      !remuxer.Finalize(&motion_photo).ok()) {
+    abort();
+  }
+  return motion_photo;
+}
+
+void BM_BatchDemux(benchmark::State &state) {
+  std::string small_motion_photo = GenerateMotionPhoto(1);
+  std::string large_motion_photo = GenerateMotionPhoto(kLargeVideoRepeat);
+
+  // Each item has its own copy, as distinct files would.
+  std::vector<std::string> corpus;
+  for (size_t i = 0; i < kCorpusSize; i++) {
+    corpus.push_back(i % kLargeItemInterval == 0 ? large_motion_photo
+                                                 : small_motion_photo);
+  }
+  std::vector<BatchDemuxInput> inputs;
+  for (const std::string &bytes : corpus) {
+    inputs.push_back(BatchDemuxInput::FromBytes(bytes));
+  }
+
+  BatchDemuxerOptions options;
+  options.thread_count = state.range(0);
+  options.extract_video = true;
+  BatchDemuxer batch_demuxer(options);
+
+  for (auto _ : state) {
+    std::vector<absl::StatusOr<BatchDemuxResult>> results =
+        batch_demuxer.Demux(inputs);
+    benchmark::DoNotOptimize(results);
+  }
+  state.SetItemsProcessed(state.iterations() * kCorpusSize);
+}
+BENCHMARK(BM_BatchDemux)
+    ->RangeMultiplier(2)
+    ->Range(1, std::max(1u, std::thread::hardware_concurrency()))
+    ->UseRealTime();
+
+}  // namespace
+
+}  // namespace libmphoto
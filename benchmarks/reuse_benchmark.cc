@@ -0,0 +1,122 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "benchmarks/allocation_counter.h"
+#include "libmphoto/demuxer/demuxer.h"
+#include "libmphoto/remuxer/remuxer.h"
+#include "tests/common/io_helper.h"
+
+namespace libmphoto {
+
+namespace {
+
+constexpr char kMotionPhotoPath[] =
+    "sample_data/jpeg_motion_photo/motion_photo.jpeg";
+constexpr char kStillPath[] = "sample_data/jpeg/no_xmp.jpeg";
+constexpr char kVideoPath[] = "sample_data/mp4/video.mp4";
+
+// Demuxes the info, still and video of a motion photo, as done per file when
+// processing many files.
+void Demux(const std::string &motion_photo, Demuxer *demuxer) {
+  ImageInfo image_info;
+  absl::string_view still;
+  absl::string_view video;
+  if (!demuxer->InitWithoutCopy(motion_photo).ok() ||
+      !demuxer->GetInfo(&image_info).ok() ||
+      !demuxer->GetStillView(&still).ok() ||
+      !demuxer->GetVideoView(&video).ok()) {
+    abort();
+  }
+  benchmark::DoNotOptimize(still);
+  benchmark::DoNotOptimize(video);
+}
+
+// Reports the average number of allocations per iteration since start.
+void ReportAllocations(benchmark::State &state, uint64_t start) {
+  state.counters["allocations_per_file"] =
+      benchmark::Counter(GetAllocationCount() - start,
+                         benchmark::Counter::kAvgIterations);
+}
+
+void BM_DemuxWithNewDemuxer(benchmark::State &state) {
+  std::string motion_photo = GetBytesFromFile(kMotionPhotoPath);
+
+  uint64_t start = GetAllocationCount();
+  for (auto _ : state) {
+    Demuxer demuxer;
+    Demux(motion_photo, &demuxer);
+  }
+  ReportAllocations(state, start);
+}
+BENCHMARK(BM_DemuxWithNewDemuxer);
+
+void BM_DemuxWithReusedDemuxer(benchmark::State &state) {
+  std::string motion_photo = GetBytesFromFile(kMotionPhotoPath);
+
+  // Warm up so the steady state is measured.
+  Demuxer demuxer;
+  Demux(motion_photo, &demuxer);
+
+  uint64_t start = GetAllocationCount();
+  for (auto _ : state) {
+    Demux(motion_photo, &demuxer);
+  }
+  ReportAllocations(state, start);
+}
+BENCHMARK(BM_DemuxWithReusedDemuxer);
+
+void BM_RemuxWithReusedRemuxer(benchmark::State &state) {
+  std::string still = GetBytesFromFile(kStillPath);
+  std::string video = GetBytesFromFile(kVideoPath);
+  std::string motion_photo;
+
+  Remuxer remuxer;
+  uint64_t start = GetAllocationCount();
+  for (auto _ : state) {
+    remuxer.Reset();
+    if (!remuxer.SetStill(still).ok() || !remuxer.SetVideo(video).ok() ||
+        !remuxer.Finalize(&motion_photo).ok()) {
+      abort();
+    }
+  }
+  ReportAllocations(state, start);
+}
+BENCHMARK(BM_RemuxWithReusedRemuxer);
+
+void BM_RemuxToSegmentsWithoutCopy(benchmark::State &state) {
+  std::string still = GetBytesFromFile(kStillPath);
+  std::string video = GetBytesFromFile(kVideoPath);
+  std::vector<absl::string_view> segments;
+
+  Remuxer remuxer;
+  uint64_t start = GetAllocationCount();
+  for (auto _ : state) {
+    remuxer.Reset();
+    if (!remuxer.SetStillWithoutCopy(still).ok() ||
+        !remuxer.SetVideoWithoutCopy(video).ok() ||
+        !remuxer.Finalize(&segments).ok()) {
+      abort();
+    }
+  }
+  ReportAllocations(state, start);
+}
+BENCHMARK(BM_RemuxToSegmentsWithoutCopy);
+
+}  // namespace
+
+}  // namespace libmphoto
@@ -0,0 +1,119 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include "benchmark/benchmark.h"
+#include "libmphoto/demuxer/demuxer.h"
+#include "libmphoto/initialize.h"
+#include "libmphoto/remuxer/remuxer.h"
+#include "tests/common/io_helper.h"
+
+namespace libmphoto {
+
+namespace {
+
+constexpr char kJpegMotionPhotoPath[] =
+    "sample_data/jpeg_motion_photo/motion_photo.jpeg";
+constexpr char kHeicMotionPhotoPath[] =
+    "sample_data/heic_motion_photo/motion_photo.heic";
+constexpr char kStillPath[] = "sample_data/jpeg/existing_xmp.jpeg";
+constexpr char kVideoPath[] = "sample_data/mp4/video.mp4";
+
+// Each benchmark runs the same work on 1 to N threads with its own instances,
+// so items per second should grow with the thread count. Growth which stalls
+// below the number of cores points to a lock shared by all threads.
+void ApplyThreadRange(benchmark::internal::Benchmark *benchmark) {
+  benchmark->ThreadRange(
+      1, std::max<int>(1, std::thread::hardware_concurrency()));
+  benchmark->UseRealTime();
+}
+
+void DemuxerInit(benchmark::State &state, const char *path) {
+  Initialize();
+  std::string motion_photo = GetBytesFromFile(path);
+
+  Demuxer demuxer;
+  for (auto _ : state) {
+    if (!demuxer.InitWithoutCopy(motion_photo).ok()) {
+      abort();
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+void BM_JpegDemuxerInit(benchmark::State &state) {
+  DemuxerInit(state, kJpegMotionPhotoPath);
+}
+BENCHMARK(BM_JpegDemuxerInit)->Apply(ApplyThreadRange);
+
+void BM_HeicDemuxerInit(benchmark::State &state) {
+  DemuxerInit(state, kHeicMotionPhotoPath);
+}
+BENCHMARK(BM_HeicDemuxerInit)->Apply(ApplyThreadRange);
+
+// Reads the views of one demuxer shared by all threads as a const Demuxer.
+void BM_SharedDemuxerViews(benchmark::State &state) {
+  Initialize();
+  static const Demuxer *shared_demuxer = [] {
+    Demuxer *demuxer = new Demuxer();
+    if (!demuxer->Init(GetBytesFromFile(kJpegMotionPhotoPath)).ok()) {
+      abort();
+    }
+    return demuxer;
+  }();
+
+  ImageInfo image_info;
+  absl::string_view still;
+  absl::string_view video;
+  for (auto _ : state) {
+    if (!shared_demuxer->GetInfo(&image_info).ok() ||
+        !shared_demuxer->GetStillView(&still).ok() ||
+        !shared_demuxer->GetVideoView(&video).ok()) {
+      abort();
+    }
+    benchmark::DoNotOptimize(still.data());
+    benchmark::DoNotOptimize(video.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SharedDemuxerViews)->Apply(ApplyThreadRange);
+
+// Remuxes a still with existing xmp, which parses, edits and serializes it
+// through libxml on every call.
+void BM_RemuxerFinalize(benchmark::State &state) {
+  Initialize();
+  std::string still = GetBytesFromFile(kStillPath);
+  std::string video = GetBytesFromFile(kVideoPath);
+  std::string motion_photo;
+
+  Remuxer remuxer;
+  for (auto _ : state) {
+    remuxer.Reset();
+    if (!remuxer.SetStill(still).ok() || !remuxer.SetVideo(video).ok() ||
+        !remuxer.Finalize(&motion_photo).ok()) {
+      abort();
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RemuxerFinalize)->Apply(ApplyThreadRange);
+
+}  // namespace
+
+}  // namespace libmphoto
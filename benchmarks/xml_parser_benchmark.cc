@@ -0,0 +1,161 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "benchmark/benchmark.h"
+#include "libmphoto/common/xml/libxml_deleter.h"
+#include "libmphoto/common/xml/xml_parser.h"
+#include "libmphoto/common/xmp_io/jpeg_xmp_locator.h"
+#include "libmphoto/remuxer/remuxer.h"
+#include "libxml/parser.h"
+#include "libxml/xmlmemory.h"
+#include "tests/common/io_helper.h"
+
+namespace libmphoto {
+
+namespace {
+
+constexpr char kMotionPhotoPath[] =
+    "sample_data/jpeg_motion_photo/motion_photo.jpeg";
+constexpr char kStillPath[] = "sample_data/jpeg/existing_xmp.jpeg";
+constexpr char kVideoPath[] = "sample_data/mp4/video.mp4";
+
+// Counts the allocations libxml makes on each thread, which do not pass
+// through operator new.
+thread_local uint64_t xml_allocation_count = 0;
+
+void *CountingMalloc(size_t size) {
+  xml_allocation_count++;
+  return malloc(size);
+}
+
+void *CountingRealloc(void *ptr, size_t size) {
+  xml_allocation_count++;
+  return realloc(ptr, size);
+}
+
+char *CountingStrdup(const char *str) {
+  xml_allocation_count++;
+  return strdup(str);
+}
+
+// Returns the resident set size of the process in KiB.
+double GetResidentSetKiB() {
+  FILE *statm = fopen("/proc/self/statm", "r");
+  if (!statm) {
+    return 0;
+  }
+  long size = 0;
+  long resident = 0;
+  if (fscanf(statm, "%ld %ld", &size, &resident) != 2) {
+    resident = 0;
+  }
+  fclose(statm);
+  return static_cast<double>(resident) * sysconf(_SC_PAGESIZE) / 1024;
+}
+
+// Sets the counters shared by the benchmarks below. The resident set is
+// sampled once all threads have finished, so growth over long runs shows as
+// a larger value at higher iteration counts.
+void SetCounters(benchmark::State &state, uint64_t start_allocations) {
+  state.counters["xml_allocs"] = benchmark::Counter(
+      static_cast<double>(xml_allocation_count - start_allocations),
+      benchmark::Counter::kAvgIterations);
+  if (state.thread_index() == 0) {
+    state.counters["rss_kib"] = GetResidentSetKiB();
+  }
+}
+
+// Parses the xmp of a motion photo on each thread, with reuse of the
+// thread's parser context enabled by the first argument.
+void BM_ParseXmp(benchmark::State &state) {
+  std::string motion_photo = GetBytesFromFile(kMotionPhotoPath);
+  absl::string_view xmp;
+  if (!LocateJpegXmp(motion_photo, &xmp).ok()) {
+    abort();
+  }
+  bool reuse = state.range(0) != 0;
+  uint64_t start_allocations = xml_allocation_count;
+
+  for (auto _ : state) {
+    ScopedXmlParserReuse xml_parser_reuse(reuse);
+    std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc = ReadXmlFromMemory(xmp);
+    if (!xml_doc) {
+      abort();
+    }
+    benchmark::DoNotOptimize(xml_doc.get());
+  }
+
+  SetCounters(state, start_allocations);
+}
+BENCHMARK(BM_ParseXmp)
+    ->ArgName("reuse")
+    ->Arg(0)
+    ->Arg(1)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+void BM_RemuxerFinalize(benchmark::State &state) {
+  std::string still = GetBytesFromFile(kStillPath);
+  std::string video = GetBytesFromFile(kVideoPath);
+  std::string motion_photo;
+  RemuxerOptions options;
+  options.reuse_xml_parser = state.range(0) != 0;
+  uint64_t start_allocations = xml_allocation_count;
+
+  Remuxer remuxer(options);
+  for (auto _ : state) {
+    remuxer.Reset();
+    if (!remuxer.SetStill(still).ok() || !remuxer.SetVideo(video).ok() ||
+        !remuxer.Finalize(&motion_photo).ok()) {
+      abort();
+    }
+  }
+
+  SetCounters(state, start_allocations);
+}
+BENCHMARK(BM_RemuxerFinalize)
+    ->ArgName("reuse")
+    ->Arg(0)
+    ->Arg(1)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+}  // namespace
+
+}  // namespace libmphoto
+
+int main(int argc, char **argv) {
+  // The hooks must be installed before libxml allocates anything.
+  xmlMemSetup(free, libmphoto::CountingMalloc, libmphoto::CountingRealloc,
+              libmphoto::CountingStrdup);
+  xmlInitParser();
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
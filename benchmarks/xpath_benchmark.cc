@@ -0,0 +1,138 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <memory>
+#include <string>
+
+#include "benchmark/benchmark.h"
+#include "libmphoto/common/xml/libxml_deleter.h"
+#include "libmphoto/common/xml/xml_utils.h"
+#include "libmphoto/common/xmp_field_paths.h"
+#include "libmphoto/common/xmp_io/xmp_io_helper.h"
+#include "libmphoto/demuxer/demuxer.h"
+#include "libmphoto/remuxer/remuxer.h"
+#include "libxml/xpathInternals.h"
+#include "tests/common/io_helper.h"
+
+namespace libmphoto {
+
+namespace {
+
+constexpr char kMotionPhotoPath[] =
+    "sample_data/jpeg_motion_photo/motion_photo.jpeg";
+constexpr char kStillPath[] = "sample_data/jpeg/no_xmp.jpeg";
+constexpr char kVideoPath[] = "sample_data/mp4/video.mp4";
+
+// The fields read from the xmp of a motion photo by the document path.
+constexpr const char *kFieldXPaths[] = {
+    kMotionPhotoXPath,   kMotionPhotoVersionXPath,
+    kMotionPhotoPresentationTimestampUsXPath,
+    kImageMimeTypeXPath, kVideoMimeTypeXPath,
+    kVideoLengthXPath,   kStillPaddingXPath};
+
+std::unique_ptr<xmlDoc, LibXmlDeleter> GetMotionPhotoXmp() {
+  std::string motion_photo = GetBytesFromFile(kMotionPhotoPath);
+  std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc =
+      GetXmpIOHelper(motion_photo)->GetXmp(motion_photo);
+  if (!xml_doc) {
+    abort();
+  }
+  return xml_doc;
+}
+
+// Reads the fields as done before xpaths were cached, creating a context and
+// compiling each xpath per document.
+void BM_ReadFieldsWithUncachedXPaths(benchmark::State &state) {
+  std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc = GetMotionPhotoXmp();
+
+  for (auto _ : state) {
+    std::unique_ptr<xmlXPathContext, LibXmlDeleter> xpath_context(
+        xmlXPathNewContext(xml_doc.get()));
+    for (const auto &ns : kNamespaces) {
+      xmlXPathRegisterNs(xpath_context.get(),
+                         reinterpret_cast<const xmlChar *>(ns.first.c_str()),
+                         reinterpret_cast<const xmlChar *>(ns.second.c_str()));
+    }
+
+    for (const char *xpath : kFieldXPaths) {
+      std::unique_ptr<xmlXPathObject, LibXmlDeleter> xpath_object(
+          xmlXPathEvalExpression(reinterpret_cast<const xmlChar *>(xpath),
+                                 xpath_context.get()));
+      benchmark::DoNotOptimize(xpath_object.get());
+    }
+  }
+}
+BENCHMARK(BM_ReadFieldsWithUncachedXPaths);
+
+void BM_ReadFieldsWithCachedXPaths(benchmark::State &state) {
+  std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc = GetMotionPhotoXmp();
+  std::string value;
+
+  for (auto _ : state) {
+    auto xpath_context = GetXPathContext(kNamespaces, xml_doc.get());
+    for (const char *xpath : kFieldXPaths) {
+      benchmark::DoNotOptimize(
+          FindXmlAttributeValue(xpath, *xpath_context, &value));
+    }
+  }
+}
+BENCHMARK(BM_ReadFieldsWithCachedXPaths);
+
+void BM_ReadFieldsInOneWalk(benchmark::State &state) {
+  std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc = GetMotionPhotoXmp();
+  XmlFieldLookup lookup;
+
+  for (auto _ : state) {
+    if (!FindXmlAttributes(kFieldXPaths, sizeof(kFieldXPaths) / sizeof(char *),
+                           kNamespaces, *xml_doc, &lookup)
+             .ok()) {
+      abort();
+    }
+    benchmark::DoNotOptimize(lookup.found);
+  }
+}
+BENCHMARK(BM_ReadFieldsInOneWalk);
+
+void BM_DemuxerInit(benchmark::State &state) {
+  std::string motion_photo = GetBytesFromFile(kMotionPhotoPath);
+
+  Demuxer demuxer;
+  for (auto _ : state) {
+    if (!demuxer.InitWithoutCopy(motion_photo).ok()) {
+      abort();
+    }
+  }
+}
+BENCHMARK(BM_DemuxerInit);
+
+void BM_RemuxerFinalize(benchmark::State &state) {
+  std::string still = GetBytesFromFile(kStillPath);
+  std::string video = GetBytesFromFile(kVideoPath);
+  std::string motion_photo;
+
+  Remuxer remuxer;
+  for (auto _ : state) {
+    remuxer.Reset();
+    if (!remuxer.SetStill(still).ok() || !remuxer.SetVideo(video).ok() ||
+        !remuxer.Finalize(&motion_photo).ok()) {
+      abort();
+    }
+  }
+}
+BENCHMARK(BM_RemuxerFinalize);
+
+}  // namespace
+
+}  // namespace libmphoto
@@ -0,0 +1,97 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "libmphoto/batch/batch_demuxer.h"
+
+#include <utility>
+
+#include "absl/synchronization/mutex.h"
+
+namespace libmphoto {
+
+BatchDemuxInput BatchDemuxInput::FromPath(const std::string &path) {
+  BatchDemuxInput input;
+  input.path = path;
+  return input;
+}
+
+BatchDemuxInput BatchDemuxInput::FromBytes(const absl::string_view bytes) {
+  BatchDemuxInput input;
+  input.bytes = bytes;
+  return input;
+}
+
+BatchDemuxer::BatchDemuxer() : BatchDemuxer(BatchDemuxerOptions()) {}
+
+BatchDemuxer::BatchDemuxer(const BatchDemuxerOptions &options)
+    : options_(options), pool_(options.thread_count) {
+  for (int worker = 0; worker < pool_.thread_count(); worker++) {
+    demuxers_.emplace_back(new Demuxer(options_.demuxer_options));
+  }
+}
+
+std::vector<absl::StatusOr<BatchDemuxResult>> BatchDemuxer::Demux(
+    const std::vector<BatchDemuxInput> &inputs) {
+  std::vector<absl::StatusOr<BatchDemuxResult>> results(inputs.size());
+
+  // Each index is written by exactly one worker, so no locking is needed.
+  pool_.ParallelFor(inputs.size(), [this, &inputs, &results](int worker,
+                                                             size_t index) {
+    results[index] = DemuxInput(worker, inputs[index]);
+  });
+
+  return results;
+}
+
+void BatchDemuxer::Demux(const std::vector<BatchDemuxInput> &inputs,
+                         const Callback &callback) {
+  absl::Mutex callback_mutex;
+
+  pool_.ParallelFor(inputs.size(), [this, &inputs, &callback, &callback_mutex](
+                                       int worker, size_t index) {
+    absl::StatusOr<BatchDemuxResult> result = DemuxInput(worker, inputs[index]);
+    absl::MutexLock lock(&callback_mutex);
+    callback(index, std::move(result));
+  });
+}
+
+absl::StatusOr<BatchDemuxResult> BatchDemuxer::DemuxInput(
+    int worker, const BatchDemuxInput &input) {
+  Demuxer *demuxer = demuxers_[worker].get();
+  BatchDemuxResult result;
+
+  absl::Status status = input.path.empty()
+                            ? demuxer->InitWithoutCopy(input.bytes)
+                            : demuxer->InitFromFile(input.path);
+  if (status.ok()) {
+    status = demuxer->GetInfo(&result.image_info);
+  }
+  if (status.ok() && options_.extract_still) {
+    status = demuxer->GetStill(&result.still);
+  }
+  if (status.ok() && options_.extract_video) {
+    status = demuxer->GetVideo(&result.video);
+  }
+
+  // Releases the input, unmapping files promptly, while keeping the buffers
+  // of the demuxer for the next input.
+  demuxer->Reset();
+
+  if (!status.ok()) {
+    return status;
+  }
+  return result;
+}
+
+}  // namespace libmphoto
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBMPHOTO_BATCH_BATCH_DEMUXER_H_
+#define LIBMPHOTO_BATCH_BATCH_DEMUXER_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "libmphoto/batch/work_stealing_pool.h"
+#include "libmphoto/demuxer/demuxer.h"
+#include "libmphoto/demuxer/image_info.h"
+
+namespace libmphoto {
+
+// This struct holds a motion photo to demux in a batch, either the path of a
+// file or bytes in memory.
+struct BatchDemuxInput {
+  // Returns an input for the motion photo file at path.
+  static BatchDemuxInput FromPath(const std::string &path);
+
+  // Returns an input for motion photo bytes in memory. The bytes are
+  // borrowed, and must outlive the batch.
+  static BatchDemuxInput FromBytes(const absl::string_view bytes);
+
+  std::string path;
+  absl::string_view bytes;
+};
+
+// This struct holds what was demuxed from one motion photo of a batch.
+struct BatchDemuxResult {
+  ImageInfo image_info;
+
+  // The still and video, set only when extraction is enabled.
+  std::string still;
+  std::string video;
+};
+
+// This struct holds the options controlling a batch demuxer.
+struct BatchDemuxerOptions {
+  // Number of worker threads, or one per hardware thread if not positive.
+  int thread_count = 0;
+
+  // Whether to copy out the still and video of each motion photo, rather than
+  // only its information.
+  bool extract_still = false;
+  bool extract_video = false;
+
+  // Options for the demuxer of each worker.
+  DemuxerOptions demuxer_options;
+};
+
+// This class demuxes batches of motion photos in parallel on a work stealing
+// thread pool, so batches mixing small and large files stay balanced. Each
+// worker reuses one demuxer for all of the motion photos it handles.
+class BatchDemuxer {
+ public:
+  // Receives the result of the motion photo at index within the batch.
+  using Callback = std::function<void(
+      size_t index, absl::StatusOr<BatchDemuxResult> result)>;
+
+  BatchDemuxer();
+  explicit BatchDemuxer(const BatchDemuxerOptions &options);
+
+  // Demuxes each input, returning the results in input order.
+  std::vector<absl::StatusOr<BatchDemuxResult>> Demux(
+      const std::vector<BatchDemuxInput> &inputs);
+
+  // Demuxes each input, streaming each result to callback as it completes,
+  // out of input order. Callbacks are never run concurrently, but run on
+  // worker threads. Returns once every callback has run.
+  void Demux(const std::vector<BatchDemuxInput> &inputs,
+             const Callback &callback);
+
+ private:
+  BatchDemuxerOptions options_;
+  WorkStealingPool pool_;
+  // The demuxer reused by each worker.
+  std::vector<std::unique_ptr<Demuxer>> demuxers_;
+
+  // Demuxes one input with a worker's demuxer.
+  absl::StatusOr<BatchDemuxResult> DemuxInput(int worker,
+                                               const BatchDemuxInput &input);
+};
+
+}  // namespace libmphoto
+
+#endif  // LIBMPHOTO_BATCH_BATCH_DEMUXER_H_
@@ -0,0 +1,304 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "libmphoto/batch/batch_reader.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "libmphoto/batch/io_uring.h"
+#include "libmphoto/common/macros.h"
+#include "libmphoto/demuxer/demuxer.h"
+
+namespace libmphoto {
+
+namespace {
+
+// The state of a file being probed. Its buffer keeps its capacity when the
+// state is reused for the next file.
+struct ProbeState {
+  size_t index = 0;
+  int fd = -1;
+  uint64_t file_size = 0;
+  // Holds the leading bytes of the file, of which filled have been read so
+  // far, out of the buffer length needed for the next probe.
+  std::string buffer;
+  size_t filled = 0;
+  struct iovec iov;
+};
+
+// Opens the file at path and sizes the buffer for its first probe.
+absl::Status StartProbe(const std::string &path, size_t index,
+                        size_t initial_read_length, ProbeState *state) {
+  state->index = index;
+  state->filled = 0;
+  state->fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (state->fd < 0) {
+    return absl::NotFoundError(
+        absl::StrCat("Failed to open ", path, ": ", strerror(errno)));
+  }
+
+  struct stat file_stat;
+  if (fstat(state->fd, &file_stat) != 0) {
+    return absl::InternalError(
+        absl::StrCat("Failed to stat ", path, ": ", strerror(errno)));
+  }
+
+  state->file_size = file_stat.st_size;
+  state->buffer.resize(
+      std::min<uint64_t>(state->file_size, initial_read_length));
+  return absl::OkStatus();
+}
+
+void FinishProbe(ProbeState *state) {
+  if (state->fd >= 0) {
+    close(state->fd);
+    state->fd = -1;
+  }
+}
+
+// Probes the bytes read so far, once the buffer is full. Returns true with
+// result set if the probe completed, or false with the buffer grown if it
+// needs more of the file.
+bool ContinueProbe(ProbeState *state,
+                   absl::StatusOr<MotionPhotoLayout> *result) {
+  MotionPhotoLayout layout;
+  absl::Status status =
+      Demuxer::Probe(state->buffer, state->file_size, &layout);
+
+  if (absl::IsOutOfRange(status) &&
+      layout.required_prefix_length > state->buffer.length()) {
+    // Grow at least geometrically, as heic metadata is found by following a
+    // chain of boxes which may each need another read.
+    state->buffer.resize(std::min<uint64_t>(
+        state->file_size,
+        std::max<uint64_t>(layout.required_prefix_length,
+                           2 * state->buffer.length())));
+    return false;
+  }
+
+  if (status.ok()) {
+    *result = std::move(layout);
+  } else {
+    *result = status;
+  }
+  return true;
+}
+
+// Sets iov to the unread remainder of the buffer.
+void PrepareRead(ProbeState *state) {
+  state->iov.iov_base = &state->buffer[state->filled];
+  state->iov.iov_len = state->buffer.length() - state->filled;
+}
+
+// Accounts for a completed read of result bytes, returning an error if it
+// failed or the file ended early.
+absl::Status CompleteRead(ssize_t result, ProbeState *state) {
+  if (result < 0) {
+    return absl::InternalError(
+        absl::StrCat("Failed to read file: ", strerror(-result)));
+  }
+  if (result == 0) {
+    return absl::DataLossError("File is shorter than its reported size");
+  }
+
+  state->filled += result;
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+BatchReader::BatchReader() = default;
+
+BatchReader::BatchReader(const BatchReaderOptions &options)
+    : options_(options) {}
+
+absl::Status BatchReader::ProbeFiles(const std::vector<std::string> &paths,
+                                     const Callback &callback) {
+  if (!callback) {
+    return absl::InvalidArgumentError("Callback is null");
+  }
+
+  if (options_.queue_depth <= 0 || options_.fallback_threads <= 0) {
+    return absl::InvalidArgumentError(
+        "Queue depth and fallback threads must be positive");
+  }
+
+  used_io_uring_ = false;
+  if (!options_.disable_io_uring) {
+    absl::Status status = ProbeFilesWithIoUring(paths, callback);
+    if (!absl::IsUnimplemented(status)) {
+      return status;
+    }
+  }
+
+  ProbeFilesWithPread(paths, {}, 0, callback);
+  return absl::OkStatus();
+}
+
+absl::Status BatchReader::ProbeFilesWithIoUring(
+    const std::vector<std::string> &paths, const Callback &callback) {
+  // Each slot has at most one read in flight, so the ring never overflows.
+  // The slots are declared first so their buffers outlive the ring.
+  std::vector<ProbeState> slots(
+      std::min<size_t>(options_.queue_depth, paths.size()));
+
+  std::unique_ptr<IoUring> ring;
+  RETURN_IF_ERROR(IoUring::Create(options_.queue_depth, &ring));
+  used_io_uring_ = true;
+  size_t next_index = 0;
+  size_t in_flight = 0;
+
+  auto queue_read = [&ring](size_t slot_index, ProbeState *state) {
+    PrepareRead(state);
+    ring->QueueRead(state->fd, state->filled, &state->iov, slot_index);
+  };
+
+  // Starts the next file which opens successfully in slot, returning false
+  // once there are none left.
+  auto start_next = [&](size_t slot_index) {
+    ProbeState *state = &slots[slot_index];
+    while (next_index < paths.size()) {
+      size_t index = next_index++;
+      absl::Status status = StartProbe(paths[index], index,
+                                       options_.initial_read_length, state);
+      if (status.ok() && state->buffer.empty()) {
+        status = absl::InvalidArgumentError("File is empty");
+      }
+      if (status.ok()) {
+        queue_read(slot_index, state);
+        return true;
+      }
+      FinishProbe(state);
+      callback(index, status);
+    }
+    return false;
+  };
+
+  for (size_t slot_index = 0; slot_index < slots.size(); slot_index++) {
+    if (start_next(slot_index)) {
+      in_flight++;
+    }
+  }
+
+  while (in_flight > 0) {
+    if (!ring->SubmitAndWait().ok()) {
+      // The reads in flight may never complete, so their files and those not
+      // yet started are probed with pread instead.
+      std::vector<size_t> retry_indices;
+      for (ProbeState &state : slots) {
+        if (state.fd >= 0) {
+          retry_indices.push_back(state.index);
+          FinishProbe(&state);
+        }
+      }
+      ProbeFilesWithPread(paths, retry_indices, next_index, callback);
+      return absl::OkStatus();
+    }
+
+    uint64_t slot_index;
+    int result;
+    while (ring->PopCompletion(&slot_index, &result)) {
+      ProbeState *state = &slots[slot_index];
+      absl::StatusOr<MotionPhotoLayout> layout;
+      absl::Status status = CompleteRead(result, state);
+      if (status.ok()) {
+        if (state->filled < state->buffer.length() ||
+            !ContinueProbe(state, &layout)) {
+          queue_read(slot_index, state);
+          continue;
+        }
+      } else {
+        layout = status;
+      }
+
+      FinishProbe(state);
+      callback(state->index, std::move(layout));
+      if (!start_next(slot_index)) {
+        in_flight--;
+      }
+    }
+  }
+
+  return absl::OkStatus();
+}
+
+void BatchReader::ProbeFilesWithPread(const std::vector<std::string> &paths,
+                                      const std::vector<size_t> &retry_indices,
+                                      size_t first_index,
+                                      const Callback &callback) {
+  size_t file_count = retry_indices.size() + paths.size() - first_index;
+  std::atomic<size_t> next_file(0);
+  absl::Mutex callback_mutex;
+
+  auto worker = [&]() {
+    ProbeState state;
+    for (size_t file = next_file++; file < file_count; file = next_file++) {
+      size_t index = file < retry_indices.size()
+                         ? retry_indices[file]
+                         : first_index + file - retry_indices.size();
+      absl::StatusOr<MotionPhotoLayout> layout;
+      absl::Status status = StartProbe(paths[index], index,
+                                       options_.initial_read_length, &state);
+      if (status.ok() && state.buffer.empty()) {
+        status = absl::InvalidArgumentError("File is empty");
+      }
+
+      while (status.ok()) {
+        PrepareRead(&state);
+        ssize_t result = pread(state.fd, state.iov.iov_base, state.iov.iov_len,
+                               state.filled);
+        if (result < 0 && errno == EINTR) {
+          continue;
+        }
+        status = CompleteRead(result < 0 ? -errno : result, &state);
+        if (status.ok() && state.filled == state.buffer.length() &&
+            ContinueProbe(&state, &layout)) {
+          break;
+        }
+      }
+      if (!status.ok()) {
+        layout = status;
+      }
+
+      FinishProbe(&state);
+      absl::MutexLock lock(&callback_mutex);
+      callback(index, std::move(layout));
+    }
+  };
+
+  size_t thread_count = std::min<size_t>(options_.fallback_threads, file_count);
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < thread_count; i++) {
+    threads.emplace_back(worker);
+  }
+  // The calling thread takes part rather than waiting idle.
+  worker();
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+}
+
+}  // namespace libmphoto
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBMPHOTO_BATCH_BATCH_READER_H_
+#define LIBMPHOTO_BATCH_BATCH_READER_H_
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "libmphoto/demuxer/motion_photo_layout.h"
+
+namespace libmphoto {
+
+// This struct holds the options controlling how a batch reader issues reads.
+struct BatchReaderOptions {
+  // Maximum number of reads in flight at once.
+  int queue_depth = 64;
+
+  // Bytes read from the start of each file for its first probe. Files whose
+  // metadata lies further in are read further on later probes.
+  size_t initial_read_length = 64 * 1024;
+
+  // Number of threads issuing reads when io_uring is unavailable.
+  int fallback_threads = 8;
+
+  // If true, io_uring is not used even where it is available.
+  bool disable_io_uring = false;
+};
+
+// This class probes the layout of many motion photo files concurrently,
+// reading only the leading bytes needed to find their metadata. Reads are
+// submitted through io_uring where available, otherwise they are issued with
+// pread from a pool of threads. If io_uring fails partway through a batch,
+// the files it has not finished are probed with pread.
+class BatchReader {
+ public:
+  // Receives the layout of the file at index within the batch, or the error
+  // reading or probing it.
+  using Callback = std::function<void(
+      size_t index, absl::StatusOr<MotionPhotoLayout> layout)>;
+
+  BatchReader();
+  explicit BatchReader(const BatchReaderOptions &options);
+
+  // Probes each file in paths, calling callback once per file as its result
+  // completes, in completion order. Callbacks are never run concurrently, but
+  // may run on threads other than the calling thread. Returns once every
+  // callback has run, or an error if the reads could not be issued at all.
+  absl::Status ProbeFiles(const std::vector<std::string> &paths,
+                          const Callback &callback);
+
+  // Returns whether the last call to ProbeFiles used io_uring.
+  bool used_io_uring() const { return used_io_uring_; }
+
+ private:
+  BatchReaderOptions options_;
+  bool used_io_uring_ = false;
+
+  absl::Status ProbeFilesWithIoUring(const std::vector<std::string> &paths,
+                                     const Callback &callback);
+  // Probes the files at retry_indices, then every file from first_index on.
+  void ProbeFilesWithPread(const std::vector<std::string> &paths,
+                           const std::vector<size_t> &retry_indices,
+                           size_t first_index, const Callback &callback);
+};
+
+}  // namespace libmphoto
+
+#endif  // LIBMPHOTO_BATCH_BATCH_READER_H_
@@ -0,0 +1,254 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "libmphoto/batch/io_uring.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define LIBMPHOTO_HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+namespace libmphoto {
+
+namespace {
+
+// Calls to SubmitAndWait which succeed before they fail, or -1 if they don't.
+std::atomic<int> submits_before_failure(-1);
+
+}  // namespace
+
+void IoUring::SetSubmitFailureForTesting(int count) {
+  submits_before_failure = count;
+}
+
+#ifdef LIBMPHOTO_HAVE_IO_URING
+
+// Holds the mappings of the submission and completion rings shared with the
+// kernel, and pointers to the fields within them.
+struct IoUring::Rings {
+  void *sq_ring = MAP_FAILED;
+  size_t sq_ring_size = 0;
+  void *cq_ring = MAP_FAILED;
+  size_t cq_ring_size = 0;
+  struct io_uring_sqe *sqes = static_cast<struct io_uring_sqe *>(MAP_FAILED);
+  size_t sqes_size = 0;
+
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_entries;
+  unsigned *sq_array;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  struct io_uring_cqe *cqes;
+
+  ~Rings() {
+    if (sqes != MAP_FAILED) {
+      munmap(sqes, sqes_size);
+    }
+    if (cq_ring != MAP_FAILED && cq_ring != sq_ring) {
+      munmap(cq_ring, cq_ring_size);
+    }
+    if (sq_ring != MAP_FAILED) {
+      munmap(sq_ring, sq_ring_size);
+    }
+  }
+};
+
+namespace {
+
+template <typename T>
+T *RingField(void *ring, uint32_t offset) {
+  return reinterpret_cast<T *>(static_cast<char *>(ring) + offset);
+}
+
+}  // namespace
+
+absl::Status IoUring::Create(unsigned entries, std::unique_ptr<IoUring> *ring) {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int ring_fd = syscall(__NR_io_uring_setup, entries, &params);
+  if (ring_fd < 0) {
+    return absl::UnimplementedError(
+        absl::StrCat("io_uring is unavailable: ", strerror(errno)));
+  }
+
+  std::unique_ptr<Rings> rings(new Rings());
+  rings->sq_ring_size =
+      params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  rings->cq_ring_size =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+  // Newer kernels map both rings with a single mapping.
+  bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap) {
+    rings->sq_ring_size = rings->cq_ring_size =
+        std::max(rings->sq_ring_size, rings->cq_ring_size);
+  }
+
+  rings->sq_ring =
+      mmap(nullptr, rings->sq_ring_size, PROT_READ | PROT_WRITE,
+           MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+  if (rings->sq_ring != MAP_FAILED) {
+    rings->cq_ring =
+        single_mmap
+            ? rings->sq_ring
+            : mmap(nullptr, rings->cq_ring_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+  }
+  if (rings->cq_ring != MAP_FAILED) {
+    rings->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    rings->sqes = static_cast<struct io_uring_sqe *>(
+        mmap(nullptr, rings->sqes_size, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES));
+  }
+  if (rings->sqes == MAP_FAILED) {
+    int map_errno = errno;
+    rings.reset();
+    close(ring_fd);
+    return absl::InternalError(
+        absl::StrCat("Failed to map io_uring: ", strerror(map_errno)));
+  }
+
+  rings->sq_head = RingField<unsigned>(rings->sq_ring, params.sq_off.head);
+  rings->sq_tail = RingField<unsigned>(rings->sq_ring, params.sq_off.tail);
+  rings->sq_mask = RingField<unsigned>(rings->sq_ring, params.sq_off.ring_mask);
+  rings->sq_entries =
+      RingField<unsigned>(rings->sq_ring, params.sq_off.ring_entries);
+  rings->sq_array = RingField<unsigned>(rings->sq_ring, params.sq_off.array);
+  rings->cq_head = RingField<unsigned>(rings->cq_ring, params.cq_off.head);
+  rings->cq_tail = RingField<unsigned>(rings->cq_ring, params.cq_off.tail);
+  rings->cq_mask = RingField<unsigned>(rings->cq_ring, params.cq_off.ring_mask);
+  rings->cqes =
+      RingField<struct io_uring_cqe>(rings->cq_ring, params.cq_off.cqes);
+
+  ring->reset(new IoUring(ring_fd, std::move(rings)));
+  return absl::OkStatus();
+}
+
+IoUring::IoUring(int ring_fd, std::unique_ptr<Rings> rings)
+    : ring_fd_(ring_fd), rings_(std::move(rings)) {}
+
+IoUring::~IoUring() {
+  rings_.reset();
+  close(ring_fd_);
+}
+
+bool IoUring::QueueRead(int fd, uint64_t offset, const struct iovec *iov,
+                        uint64_t user_data) {
+  unsigned tail = *rings_->sq_tail;
+  unsigned head = __atomic_load_n(rings_->sq_head, __ATOMIC_ACQUIRE);
+  if (tail - head >= *rings_->sq_entries) {
+    return false;
+  }
+
+  unsigned index = tail & *rings_->sq_mask;
+  struct io_uring_sqe *sqe = &rings_->sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_READV;
+  sqe->fd = fd;
+  sqe->off = offset;
+  sqe->addr = reinterpret_cast<uint64_t>(iov);
+  sqe->len = 1;
+  sqe->user_data = user_data;
+  rings_->sq_array[index] = index;
+
+  // The entry must be visible to the kernel before the tail moves past it.
+  __atomic_store_n(rings_->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  pending_++;
+  return true;
+}
+
+absl::Status IoUring::SubmitAndWait() {
+  int remaining = submits_before_failure.load();
+  while (remaining > 0 &&
+         !submits_before_failure.compare_exchange_weak(remaining,
+                                                       remaining - 1)) {
+  }
+  if (remaining == 0) {
+    return absl::InternalError("Failed to enter io_uring: injected failure");
+  }
+
+  while (true) {
+    int submitted = syscall(__NR_io_uring_enter, ring_fd_, pending_, 1,
+                            IORING_ENTER_GETEVENTS, nullptr, 0);
+    if (submitted >= 0) {
+      pending_ -= submitted;
+      return absl::OkStatus();
+    }
+    if (errno != EINTR) {
+      return absl::InternalError(
+          absl::StrCat("Failed to enter io_uring: ", strerror(errno)));
+    }
+  }
+}
+
+bool IoUring::PopCompletion(uint64_t *user_data, int *result) {
+  unsigned head = *rings_->cq_head;
+  if (head == __atomic_load_n(rings_->cq_tail, __ATOMIC_ACQUIRE)) {
+    return false;
+  }
+
+  const struct io_uring_cqe &cqe = rings_->cqes[head & *rings_->cq_mask];
+  *user_data = cqe.user_data;
+  *result = cqe.res;
+
+  // The entry must be read before the kernel may reuse it.
+  __atomic_store_n(rings_->cq_head, head + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+#else  // LIBMPHOTO_HAVE_IO_URING
+
+struct IoUring::Rings {};
+
+absl::Status IoUring::Create(unsigned entries, std::unique_ptr<IoUring> *ring) {
+  return absl::UnimplementedError("io_uring is not supported on this platform");
+}
+
+IoUring::IoUring(int ring_fd, std::unique_ptr<Rings> rings)
+    : ring_fd_(ring_fd), rings_(std::move(rings)) {}
+
+IoUring::~IoUring() = default;
+
+bool IoUring::QueueRead(int fd, uint64_t offset, const struct iovec *iov,
+                        uint64_t user_data) {
+  return false;
+}
+
+absl::Status IoUring::SubmitAndWait() {
+  return absl::UnimplementedError("io_uring is not supported on this platform");
+}
+
+bool IoUring::PopCompletion(uint64_t *user_data, int *result) { return false; }
+
+#endif  // LIBMPHOTO_HAVE_IO_URING
+
+}  // namespace libmphoto
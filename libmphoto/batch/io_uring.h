@@ -0,0 +1,74 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBMPHOTO_BATCH_IO_URING_H_
+#define LIBMPHOTO_BATCH_IO_URING_H_
+
+#include <sys/uio.h>
+
+#include <cstdint>
+#include <memory>
+
+#include "absl/status/status.h"
+
+namespace libmphoto {
+
+// This class provides a minimal io_uring submission and completion queue for
+// reads, using the raw system calls so no liburing dependency is needed.
+class IoUring {
+ public:
+  // Creates a ring with room for entries queued reads, setting ring on
+  // success. Returns an unimplemented error where io_uring is unavailable,
+  // such as on older kernels or when it is blocked by a seccomp filter.
+  static absl::Status Create(unsigned entries, std::unique_ptr<IoUring> *ring);
+
+  ~IoUring();
+
+  IoUring(const IoUring &) = delete;
+  IoUring &operator=(const IoUring &) = delete;
+
+  // Queues a read from fd at offset into the buffer described by iov, tagged
+  // with user_data. The iovec must stay valid until the read completes.
+  // Returns false if the submission queue is full.
+  bool QueueRead(int fd, uint64_t offset, const struct iovec *iov,
+                 uint64_t user_data);
+
+  // Submits the queued reads and waits for at least one completion.
+  absl::Status SubmitAndWait();
+
+  // Makes SubmitAndWait fail on every ring once count further calls have
+  // succeeded, so callers' error handling can be tested. A negative count
+  // restores normal operation.
+  static void SetSubmitFailureForTesting(int count);
+
+  // Pops a completion, setting user_data to the tag of the read and result
+  // to the bytes read or a negated errno. Returns false if there are none.
+  bool PopCompletion(uint64_t *user_data, int *result);
+
+ private:
+  struct Rings;
+
+  IoUring(int ring_fd, std::unique_ptr<Rings> rings);
+
+  int ring_fd_;
+  std::unique_ptr<Rings> rings_;
+  // Reads queued but not yet submitted.
+  unsigned pending_ = 0;
+};
+
+}  // namespace libmphoto
+
+#endif  // LIBMPHOTO_BATCH_IO_URING_H_
@@ -0,0 +1,135 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "libmphoto/batch/work_stealing_pool.h"
+
+#include <algorithm>
+
+namespace libmphoto {
+
+WorkStealingPool::WorkStealingPool(int thread_count) {
+  if (thread_count <= 0) {
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  for (int worker = 0; worker < thread_count; worker++) {
+    ranges_.emplace_back(new Range());
+  }
+  for (int worker = 0; worker < thread_count; worker++) {
+    threads_.emplace_back(&WorkStealingPool::RunWorker, this, worker);
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  {
+    absl::MutexLock lock(&mutex_);
+    stopping_ = true;
+  }
+  for (std::thread &thread : threads_) {
+    thread.join();
+  }
+}
+
+void WorkStealingPool::ParallelFor(
+    size_t count, const std::function<void(int worker, size_t index)> &fn) {
+  if (count == 0) {
+    return;
+  }
+
+  // Split the indices into contiguous ranges, one per worker.
+  size_t workers = ranges_.size();
+  for (size_t worker = 0; worker < workers; worker++) {
+    absl::MutexLock lock(&ranges_[worker]->mutex);
+    ranges_[worker]->begin = count * worker / workers;
+    ranges_[worker]->end = count * (worker + 1) / workers;
+  }
+
+  absl::MutexLock lock(&mutex_);
+  fn_ = &fn;
+  active_workers_ = static_cast<int>(workers);
+  generation_++;
+  mutex_.Await(absl::Condition(
+      +[](int *active_workers) { return *active_workers == 0; },
+      &active_workers_));
+  fn_ = nullptr;
+}
+
+void WorkStealingPool::RunWorker(int worker) {
+  uint64_t seen_generation = 0;
+  while (true) {
+    const std::function<void(int, size_t)> *fn;
+    {
+      absl::MutexLock lock(&mutex_);
+      auto has_work = [this, seen_generation]() {
+        mutex_.AssertHeld();
+        return stopping_ || generation_ != seen_generation;
+      };
+      mutex_.Await(absl::Condition(&has_work));
+      if (stopping_) {
+        return;
+      }
+      seen_generation = generation_;
+      fn = fn_;
+    }
+
+    size_t index;
+    while (TakeIndex(worker, &index)) {
+      (*fn)(worker, index);
+    }
+
+    absl::MutexLock lock(&mutex_);
+    active_workers_--;
+  }
+}
+
+bool WorkStealingPool::TakeIndex(int worker, size_t *index) {
+  Range *own = ranges_[worker].get();
+  {
+    absl::MutexLock lock(&own->mutex);
+    if (own->begin < own->end) {
+      *index = own->begin++;
+      return true;
+    }
+  }
+
+  // Steal from the back of the first other range with work left, starting
+  // from the next worker so thieves spread across victims.
+  size_t workers = ranges_.size();
+  for (size_t offset = 1; offset < workers; offset++) {
+    Range *victim = ranges_[(worker + offset) % workers].get();
+    size_t begin;
+    size_t end;
+    {
+      absl::MutexLock lock(&victim->mutex);
+      if (victim->begin >= victim->end) {
+        continue;
+      }
+      end = victim->end;
+      begin = victim->end - (victim->end - victim->begin + 1) / 2;
+      victim->end = begin;
+    }
+
+    // Run the first stolen index now, and leave the rest to be taken from
+    // this worker's own range.
+    absl::MutexLock lock(&own->mutex);
+    *index = begin;
+    own->begin = begin + 1;
+    own->end = end;
+    return true;
+  }
+
+  return false;
+}
+
+}  // namespace libmphoto
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBMPHOTO_BATCH_WORK_STEALING_POOL_H_
+#define LIBMPHOTO_BATCH_WORK_STEALING_POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+
+namespace libmphoto {
+
+// This class provides a fixed pool of worker threads which run loops over
+// indices. Each worker starts with a contiguous range of the indices, and a
+// worker which runs out steals half of the remaining range of another, so
+// loops whose iterations vary widely in cost stay balanced.
+class WorkStealingPool {
+ public:
+  // Creates a pool of thread_count workers, or one per hardware thread if
+  // thread_count is not positive.
+  explicit WorkStealingPool(int thread_count = 0);
+
+  ~WorkStealingPool();
+
+  WorkStealingPool(const WorkStealingPool &) = delete;
+  WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+  // Returns the number of workers in the pool.
+  int thread_count() const { return static_cast<int>(threads_.size()); }
+
+  // Runs fn(worker, index) for each index in [0, count) across the workers,
+  // returning once all have run. worker is in [0, thread_count()) and
+  // identifies the thread, so per-thread state can be indexed by it. Must not
+  // be called concurrently or from within fn.
+  void ParallelFor(size_t count,
+                   const std::function<void(int worker, size_t index)> &fn);
+
+ private:
+  // The range of indices left for a worker, taken from the front by its
+  // worker and from the back by thieves.
+  struct Range {
+    absl::Mutex mutex;
+    size_t begin ABSL_GUARDED_BY(mutex) = 0;
+    size_t end ABSL_GUARDED_BY(mutex) = 0;
+  };
+
+  std::vector<std::unique_ptr<Range>> ranges_;
+  std::vector<std::thread> threads_;
+
+  absl::Mutex mutex_;
+  // Incremented for each loop, so workers can tell a new loop has started.
+  uint64_t generation_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Number of workers yet to finish the current loop.
+  int active_workers_ ABSL_GUARDED_BY(mutex_) = 0;
+  bool stopping_ ABSL_GUARDED_BY(mutex_) = false;
+  const std::function<void(int, size_t)> *fn_ ABSL_GUARDED_BY(mutex_) =
+      nullptr;
+
+  void RunWorker(int worker);
+
+  // Takes the next index of worker's own range, or steals part of another's
+  // range when it is empty. Returns false once no work is left to take.
+  bool TakeIndex(int worker, size_t *index);
+};
+
+}  // namespace libmphoto
+
+#endif  // LIBMPHOTO_BATCH_WORK_STEALING_POOL_H_
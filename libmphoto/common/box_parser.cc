@@ -0,0 +1,163 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "libmphoto/common/box_parser.h"
+
+#include "absl/base/internal/endian.h"
+
+namespace libmphoto {
+
+namespace {
+
+const absl::Status kTruncatedBoxHeaderError =
+    absl::InvalidArgumentError("Truncated box header");
+const absl::Status kInvalidBoxSizeError =
+    absl::InvalidArgumentError("Invalid box size");
+
+// Box sizes with special meaning.
+constexpr uint32_t kBoxSizeToEnd = 0;
+constexpr uint32_t kBoxSizeLarge = 1;
+
+}  // namespace
+
+absl::Status ParseBoxHeader(const absl::string_view data, uint64_t available,
+                            BoxHeader *header) {
+  if (data.length() < kBoxHeaderSize) {
+    return kTruncatedBoxHeaderError;
+  }
+
+  uint32_t size = absl::big_endian::Load32(data.data());
+  header->type = absl::big_endian::Load32(data.data() + 4);
+  header->header_size = kBoxHeaderSize;
+
+  if (size == kBoxSizeLarge) {
+    if (data.length() < kLargeBoxHeaderSize) {
+      return kTruncatedBoxHeaderError;
+    }
+    header->size = absl::big_endian::Load64(data.data() + kBoxHeaderSize);
+    header->header_size = kLargeBoxHeaderSize;
+  } else if (size == kBoxSizeToEnd) {
+    header->size = available;
+  } else {
+    header->size = size;
+  }
+
+  if (header->size < header->header_size || header->size > available) {
+    return kInvalidBoxSizeError;
+  }
+
+  return absl::OkStatus();
+}
+
+absl::Status WriteLargeBoxHeader(uint32_t type, uint64_t payload_length,
+                                 std::string *header) {
+  if (payload_length > UINT64_MAX - kLargeBoxHeaderSize) {
+    return kInvalidBoxSizeError;
+  }
+
+  // Written in place so the capacity of header is reused.
+  header->resize(kLargeBoxHeaderSize);
+  char *data = &(*header)[0];
+  absl::big_endian::Store32(data, kBoxSizeLarge);
+  absl::big_endian::Store32(data + 4, type);
+  absl::big_endian::Store64(data + kBoxHeaderSize,
+                            kLargeBoxHeaderSize + payload_length);
+  return absl::OkStatus();
+}
+
+BoxPayloadReader::BoxPayloadReader(const absl::string_view payload)
+    : payload_(payload), position_(0) {}
+
+bool BoxPayloadReader::ReadUint8(uint8_t *value) {
+  uint64_t result;
+  if (!ReadUint(1, &result)) {
+    return false;
+  }
+  *value = static_cast<uint8_t>(result);
+  return true;
+}
+
+bool BoxPayloadReader::ReadUint16(uint16_t *value) {
+  uint64_t result;
+  if (!ReadUint(2, &result)) {
+    return false;
+  }
+  *value = static_cast<uint16_t>(result);
+  return true;
+}
+
+bool BoxPayloadReader::ReadUint32(uint32_t *value) {
+  uint64_t result;
+  if (!ReadUint(4, &result)) {
+    return false;
+  }
+  *value = static_cast<uint32_t>(result);
+  return true;
+}
+
+bool BoxPayloadReader::ReadUint(size_t size, uint64_t *value) {
+  if (size > payload_.length() - position_) {
+    return false;
+  }
+
+  const char *data = payload_.data() + position_;
+  switch (size) {
+    case 0:
+      *value = 0;
+      break;
+    case 1:
+      *value = static_cast<unsigned char>(*data);
+      break;
+    case 2:
+      *value = absl::big_endian::Load16(data);
+      break;
+    case 4:
+      *value = absl::big_endian::Load32(data);
+      break;
+    case 8:
+      *value = absl::big_endian::Load64(data);
+      break;
+    default:
+      return false;
+  }
+
+  position_ += size;
+  return true;
+}
+
+bool BoxPayloadReader::ReadString(absl::string_view *value) {
+  size_t terminator = payload_.find('\0', position_);
+  if (terminator == absl::string_view::npos) {
+    return false;
+  }
+
+  *value = payload_.substr(position_, terminator - position_);
+  position_ = terminator + 1;
+  return true;
+}
+
+bool BoxPayloadReader::Skip(size_t length) {
+  if (length > payload_.length() - position_) {
+    return false;
+  }
+
+  position_ += length;
+  return true;
+}
+
+absl::string_view BoxPayloadReader::Remaining() const {
+  return payload_.substr(position_);
+}
+
+}  // namespace libmphoto
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBMPHOTO_COMMON_BOX_PARSER_H_
+#define LIBMPHOTO_COMMON_BOX_PARSER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+
+namespace libmphoto {
+
+// Returns the big endian integer representation of an ISOBMFF four character
+// code, ie. FourCC("meta").
+constexpr uint32_t FourCC(const char (&code)[5]) {
+  return static_cast<uint32_t>(static_cast<unsigned char>(code[0])) << 24 |
+         static_cast<uint32_t>(static_cast<unsigned char>(code[1])) << 16 |
+         static_cast<uint32_t>(static_cast<unsigned char>(code[2])) << 8 |
+         static_cast<uint32_t>(static_cast<unsigned char>(code[3]));
+}
+
+// Size of a compact box header, a 32 bit size followed by the type.
+constexpr size_t kBoxHeaderSize = 8;
+
+// Size of a box header with a 64 bit large size following the type.
+constexpr size_t kLargeBoxHeaderSize = 16;
+
+// Size of the version and flags fields which start a full box's payload.
+constexpr size_t kFullBoxHeaderSize = 4;
+
+// This struct holds the header fields of an ISOBMFF box.
+struct BoxHeader {
+  // Four character code of the box type.
+  uint32_t type;
+
+  // Byte length of the box, including its header.
+  uint64_t size;
+
+  // Byte length of the box header.
+  uint64_t header_size;
+};
+
+// Parses the header of the box at the start of data. available is the number
+// of bytes from the start of the box to the end of its parent, which bounds
+// the box size and is its size when the header specifies it extends to the
+// end. data must hold the complete header, up to kLargeBoxHeaderSize bytes.
+absl::Status ParseBoxHeader(const absl::string_view data, uint64_t available,
+                            BoxHeader *header);
+
+// Sets header to the header of a box of the given type with a 64 bit large
+// size, as ISOBMFF writes boxes which may exceed 4GB, whose payload is
+// payload_length bytes. Fails with an invalid argument error if the box size
+// overflows.
+absl::Status WriteLargeBoxHeader(uint32_t type, uint64_t payload_length,
+                                 std::string *header);
+
+// This class reads big endian fields sequentially from a box payload. Reads
+// fail once they would run past the end of the payload.
+class BoxPayloadReader {
+ public:
+  explicit BoxPayloadReader(const absl::string_view payload);
+
+  bool ReadUint8(uint8_t *value);
+  bool ReadUint16(uint16_t *value);
+  bool ReadUint32(uint32_t *value);
+
+  // Reads an unsigned integer of size bytes, where size is 0, 1, 2, 4 or 8.
+  bool ReadUint(size_t size, uint64_t *value);
+
+  // Reads a null terminated string, not including the terminator.
+  bool ReadString(absl::string_view *value);
+
+  bool Skip(size_t length);
+
+  // Returns the bytes which have not been read yet.
+  absl::string_view Remaining() const;
+
+ private:
+  absl::string_view payload_;
+  size_t position_;
+};
+
+}  // namespace libmphoto
+
+#endif  // LIBMPHOTO_COMMON_BOX_PARSER_H_
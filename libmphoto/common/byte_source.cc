@@ -0,0 +1,205 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "libmphoto/common/byte_source.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "libmphoto/common/macros.h"
+
+namespace libmphoto {
+
+namespace {
+
+// Returns an error if the range is not within a source of the given size.
+absl::Status CheckRange(uint64_t offset, size_t length, uint64_t size) {
+  if (offset > size || length > size - offset) {
+    return absl::OutOfRangeError(absl::StrCat("Range of ", length,
+                                              " bytes at offset ", offset,
+                                              " exceeds source size ", size));
+  }
+
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+absl::Status ByteSource::ReadPrefix(size_t max_length, std::string *scratch,
+                                    absl::string_view *result) {
+  return ReadAt(0, std::min<uint64_t>(Size(), max_length), scratch, result);
+}
+
+MemoryByteSource::MemoryByteSource(const absl::string_view bytes)
+    : bytes_(bytes) {}
+
+uint64_t MemoryByteSource::Size() { return bytes_.length(); }
+
+absl::Status MemoryByteSource::ReadAt(uint64_t offset, size_t length,
+                                      std::string *scratch,
+                                      absl::string_view *result) {
+  RETURN_IF_ERROR(CheckRange(offset, length, bytes_.length()));
+
+  *result = bytes_.substr(offset, length);
+  return absl::OkStatus();
+}
+
+absl::Status FileByteSource::Open(const std::string &path,
+                                  std::unique_ptr<FileByteSource> *file_source) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return absl::NotFoundError(
+        absl::StrCat("Failed to open ", path, ": ", strerror(errno)));
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    close(fd);
+    return absl::InternalError(
+        absl::StrCat("Failed to stat ", path, ": ", strerror(errno)));
+  }
+
+  file_source->reset(new FileByteSource(
+      fd, static_cast<uint64_t>(file_stat.st_size), /*owns_fd=*/true));
+  return absl::OkStatus();
+}
+
+absl::Status FileByteSource::FromFd(
+    int fd, std::unique_ptr<FileByteSource> *file_source) {
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Failed to stat fd ", fd, ": ", strerror(errno)));
+  }
+
+  file_source->reset(new FileByteSource(
+      fd, static_cast<uint64_t>(file_stat.st_size), /*owns_fd=*/false));
+  return absl::OkStatus();
+}
+
+FileByteSource::FileByteSource(int fd, uint64_t size, bool owns_fd)
+    : fd_(fd), size_(size), owns_fd_(owns_fd) {}
+
+FileByteSource::~FileByteSource() {
+  if (owns_fd_) {
+    close(fd_);
+  }
+}
+
+uint64_t FileByteSource::Size() { return size_; }
+
+absl::Status FileByteSource::ReadAt(uint64_t offset, size_t length,
+                                    std::string *scratch,
+                                    absl::string_view *result) {
+  RETURN_IF_ERROR(CheckRange(offset, length, size_));
+
+  scratch->resize(length);
+  size_t bytes_read = 0;
+  while (bytes_read < length) {
+    ssize_t count = pread(fd_, &(*scratch)[bytes_read], length - bytes_read,
+                          offset + bytes_read);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      return absl::DataLossError(
+          absl::StrCat("Failed to read ", length, " bytes at offset ", offset));
+    }
+    bytes_read += count;
+  }
+
+  *result = *scratch;
+  return absl::OkStatus();
+}
+
+int FileByteSource::fd() { return fd_; }
+
+CallbackByteSource::CallbackByteSource(uint64_t size,
+                                       ReadCallback read_callback)
+    : size_(size), read_callback_(std::move(read_callback)) {}
+
+uint64_t CallbackByteSource::Size() { return size_; }
+
+absl::Status CallbackByteSource::ReadAt(uint64_t offset, size_t length,
+                                        std::string *scratch,
+                                        absl::string_view *result) {
+  RETURN_IF_ERROR(CheckRange(offset, length, size_));
+  RETURN_IF_ERROR(read_callback_(offset, length, scratch));
+
+  if (scratch->length() != length) {
+    return absl::DataLossError(absl::StrCat(
+        "Read callback returned ", scratch->length(), " bytes, expected ",
+        length));
+  }
+
+  *result = *scratch;
+  return absl::OkStatus();
+}
+
+absl::Status PrefixCachingByteSource::Init(ByteSource *source,
+                                           size_t prefix_length) {
+  source_ = source;
+  return source_->ReadPrefix(prefix_length, &prefix_scratch_, &prefix_);
+}
+
+absl::Status PrefixCachingByteSource::ExtendPrefix(size_t prefix_length) {
+  if (prefix_.length() >= std::min<uint64_t>(source_->Size(), prefix_length)) {
+    return absl::OkStatus();
+  }
+
+  return source_->ReadPrefix(prefix_length, &prefix_scratch_, &prefix_);
+}
+
+uint64_t PrefixCachingByteSource::Size() { return source_->Size(); }
+
+absl::Status PrefixCachingByteSource::ReadAt(uint64_t offset, size_t length,
+                                             std::string *scratch,
+                                             absl::string_view *result) {
+  return ReadAtWithPrefix(source_, prefix_, offset, length, scratch, result);
+}
+
+absl::Status PrefixCachingByteSource::ReadPrefix(size_t max_length,
+                                                 std::string *scratch,
+                                                 absl::string_view *result) {
+  *result = prefix_.substr(0, max_length);
+  return absl::OkStatus();
+}
+
+int PrefixCachingByteSource::fd() { return source_->fd(); }
+
+absl::Status ReadAtWithPrefix(ByteSource *source, const absl::string_view prefix,
+                              uint64_t offset, size_t length,
+                              std::string *scratch, absl::string_view *result) {
+  if (offset <= prefix.length() && length <= prefix.length() - offset) {
+    *result = prefix.substr(offset, length);
+    return absl::OkStatus();
+  }
+
+  return source->ReadAt(offset, length, scratch, result);
+}
+
+bool IsViewOf(const absl::string_view view, const std::string &buffer) {
+  uintptr_t begin = reinterpret_cast<uintptr_t>(buffer.data());
+  uintptr_t data = reinterpret_cast<uintptr_t>(view.data());
+  return data >= begin && data + view.length() <= begin + buffer.length();
+}
+
+}  // namespace libmphoto
@@ -0,0 +1,181 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBMPHOTO_COMMON_BYTE_SOURCE_H_
+#define LIBMPHOTO_COMMON_BYTE_SOURCE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+
+namespace libmphoto {
+
+// Bytes read from the start of a byte source up front by parsers. This
+// typically covers all of the metadata preceding the image data.
+constexpr size_t kPrefixReadSize = 64 * 1024;
+
+// This interface provides random access reads over the bytes of a stream, so
+// that a stream can be parsed without holding all of its bytes in memory.
+class ByteSource {
+ public:
+  virtual ~ByteSource() = default;
+
+  // Returns the total number of bytes in the source.
+  virtual uint64_t Size() = 0;
+
+  // Reads length bytes starting at offset, setting result to a view of them.
+  // The view either points into scratch or into memory owned by the source,
+  // and is valid until scratch is modified or the source is destroyed.
+  virtual absl::Status ReadAt(uint64_t offset, size_t length,
+                              std::string *scratch,
+                              absl::string_view *result) = 0;
+
+  // Reads up to max_length leading bytes of the source, setting result to a
+  // view of them as with ReadAt. Sources may return fewer bytes when only
+  // fewer are readily available, so this is used for reads which are a
+  // prefetch rather than a requirement.
+  virtual absl::Status ReadPrefix(size_t max_length, std::string *scratch,
+                                  absl::string_view *result);
+
+  // Returns a file descriptor holding the bytes of the source at the same
+  // offsets, which allows ranges to be copied within the kernel, or -1 if the
+  // source is not backed by a file.
+  virtual int fd() { return -1; }
+};
+
+// Receives a stream of bytes in order, in one or more chunks. A chunk is only
+// valid for the duration of the call.
+using ByteSink = std::function<absl::Status(const absl::string_view bytes)>;
+
+// This class provides a byte source over bytes already in memory. Reads
+// return views into the bytes without copying them.
+class MemoryByteSource : public ByteSource {
+ public:
+  // The bytes are borrowed, and must outlive the source.
+  explicit MemoryByteSource(const absl::string_view bytes);
+
+  virtual uint64_t Size();
+
+  virtual absl::Status ReadAt(uint64_t offset, size_t length,
+                              std::string *scratch, absl::string_view *result);
+
+ private:
+  absl::string_view bytes_;
+};
+
+// This class provides a byte source over a file, reading ranges with pread.
+class FileByteSource : public ByteSource {
+ public:
+  // Opens the file at path, setting file_source on success.
+  static absl::Status Open(const std::string &path,
+                           std::unique_ptr<FileByteSource> *file_source);
+
+  // Reads the open file fd, setting file_source on success. The file
+  // descriptor is borrowed, and must outlive the source.
+  static absl::Status FromFd(int fd,
+                             std::unique_ptr<FileByteSource> *file_source);
+
+  virtual ~FileByteSource();
+
+  FileByteSource(const FileByteSource &) = delete;
+  FileByteSource &operator=(const FileByteSource &) = delete;
+
+  virtual uint64_t Size();
+
+  virtual absl::Status ReadAt(uint64_t offset, size_t length,
+                              std::string *scratch, absl::string_view *result);
+
+  virtual int fd();
+
+ private:
+  FileByteSource(int fd, uint64_t size, bool owns_fd);
+
+  int fd_;
+  uint64_t size_;
+  // Whether fd_ is closed when the source is destroyed.
+  bool owns_fd_;
+};
+
+// This class provides a byte source backed by a callback, for example one
+// issuing range requests against remote storage. The callback must set bytes
+// to exactly length bytes starting at offset.
+class CallbackByteSource : public ByteSource {
+ public:
+  using ReadCallback = std::function<absl::Status(
+      uint64_t offset, size_t length, std::string *bytes)>;
+
+  CallbackByteSource(uint64_t size, ReadCallback read_callback);
+
+  virtual uint64_t Size();
+
+  virtual absl::Status ReadAt(uint64_t offset, size_t length,
+                              std::string *scratch, absl::string_view *result);
+
+ private:
+  uint64_t size_;
+  ReadCallback read_callback_;
+};
+
+// This class provides a byte source over another, reading its leading bytes
+// once and serving reads within them from memory, so that parsers which each
+// start at the beginning of the source share a single read.
+class PrefixCachingByteSource : public ByteSource {
+ public:
+  // Reads up to prefix_length leading bytes of source. The source is
+  // borrowed, and must outlive this source or the next call to Init.
+  absl::Status Init(ByteSource *source, size_t prefix_length);
+
+  // Reads up to prefix_length leading bytes of the source in place of a
+  // shorter prefix. Views of the previous prefix are invalidated.
+  absl::Status ExtendPrefix(size_t prefix_length);
+
+  // Returns the leading bytes read by Init.
+  absl::string_view prefix() const { return prefix_; }
+
+  virtual uint64_t Size();
+
+  virtual absl::Status ReadAt(uint64_t offset, size_t length,
+                              std::string *scratch, absl::string_view *result);
+
+  virtual absl::Status ReadPrefix(size_t max_length, std::string *scratch,
+                                  absl::string_view *result);
+
+  virtual int fd();
+
+ private:
+  ByteSource *source_ = nullptr;
+  std::string prefix_scratch_;
+  absl::string_view prefix_;
+};
+
+// Reads length bytes starting at offset, serving them from prefix, the
+// already read leading bytes of the source, when it covers the range.
+// Otherwise the range is read from the source into scratch.
+absl::Status ReadAtWithPrefix(ByteSource *source, const absl::string_view prefix,
+                              uint64_t offset, size_t length,
+                              std::string *scratch, absl::string_view *result);
+
+// Returns true if view lies within the bytes of buffer.
+bool IsViewOf(const absl::string_view view, const std::string &buffer);
+
+}  // namespace libmphoto
+
+#endif  // LIBMPHOTO_COMMON_BYTE_SOURCE_H_
@@ -0,0 +1,269 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "libmphoto/common/fd_io.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/sendfile.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#include "absl/strings/str_cat.h"
+#include "libmphoto/common/macros.h"
+
+namespace libmphoto {
+
+namespace {
+
+// Size of the buffer used when bytes can't be copied within the kernel.
+constexpr size_t kCopyBufferSize = 1 << 20;
+
+// Largest count a single sendfile call transfers on Linux.
+constexpr size_t kMaxSendfileCount = 0x7ffff000;
+
+absl::Status GetErrnoError(const std::string &operation) {
+  return absl::InternalError(
+      absl::StrCat(operation, " failed: ", strerror(errno)));
+}
+
+#ifdef __linux__
+// Returns whether an errno from copy_file_range or sendfile means the pair of
+// file descriptors isn't supported, rather than that the copy failed.
+bool IsUnsupportedError(int error) {
+  return error == EINVAL || error == ENOSYS || error == EXDEV ||
+         error == EOPNOTSUPP;
+}
+#endif
+
+#ifdef FICLONERANGE
+// Clones length bytes starting at in_offset of in_fd to out_offset of out_fd,
+// returning false if the filesystem can't share them.
+bool CloneRange(int in_fd, uint64_t in_offset, uint64_t length, int out_fd,
+                uint64_t out_offset) {
+  struct file_clone_range range;
+  range.src_fd = in_fd;
+  range.src_offset = in_offset;
+  range.src_length = length;
+  range.dest_offset = out_offset;
+
+  int result;
+  do {
+    result = ioctl(out_fd, FICLONERANGE, &range);
+  } while (result < 0 && errno == EINTR);
+  return result == 0;
+}
+#endif
+
+}  // namespace
+
+absl::Status WriteToFd(int fd, const absl::string_view bytes) {
+  size_t written = 0;
+  while (written < bytes.length()) {
+    ssize_t count =
+        write(fd, bytes.data() + written, bytes.length() - written);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      return GetErrnoError("write");
+    }
+    written += count;
+  }
+
+  return absl::OkStatus();
+}
+
+absl::Status WriteToFdAt(int fd, const absl::string_view bytes,
+                         uint64_t offset) {
+  size_t written = 0;
+  while (written < bytes.length()) {
+    ssize_t count = pwrite(fd, bytes.data() + written,
+                           bytes.length() - written, offset + written);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      return GetErrnoError("pwrite");
+    }
+    written += count;
+  }
+
+  return absl::OkStatus();
+}
+
+absl::Status WriteSegmentsToFd(
+    int fd, const std::vector<absl::string_view> &segments) {
+  std::vector<struct iovec> iovecs;
+  iovecs.reserve(segments.size());
+  for (absl::string_view segment : segments) {
+    if (!segment.empty()) {
+      iovecs.push_back(
+          {const_cast<char *>(segment.data()), segment.length()});
+    }
+  }
+
+  size_t index = 0;
+  while (index < iovecs.size()) {
+    int count = static_cast<int>(
+        std::min<size_t>(iovecs.size() - index, IOV_MAX));
+    ssize_t written = writev(fd, &iovecs[index], count);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      return GetErrnoError("writev");
+    }
+
+    // Skip the segments written in full, then the written part of the next.
+    size_t remaining = written;
+    while (index < iovecs.size() && remaining >= iovecs[index].iov_len) {
+      remaining -= iovecs[index].iov_len;
+      index++;
+    }
+    if (remaining > 0) {
+      iovecs[index].iov_base =
+          static_cast<char *>(iovecs[index].iov_base) + remaining;
+      iovecs[index].iov_len -= remaining;
+    }
+  }
+
+  return absl::OkStatus();
+}
+
+absl::Status CopyFdRange(int in_fd, uint64_t offset, uint64_t length,
+                         int out_fd) {
+  off_t in_offset = static_cast<off_t>(offset);
+  uint64_t remaining = length;
+
+#ifdef __linux__
+  // copy_file_range rejects outputs opened for appending with the same error
+  // as a bad file descriptor, so they are found up front and skip it.
+  int out_flags = fcntl(out_fd, F_GETFL);
+  if (out_flags < 0) {
+    return GetErrnoError("fcntl");
+  }
+
+  // Prefer copy_file_range, which can share extents or copy on the device.
+  while (remaining > 0 && !(out_flags & O_APPEND)) {
+    ssize_t count =
+        copy_file_range(in_fd, &in_offset, out_fd, nullptr, remaining, 0);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count < 0 && IsUnsupportedError(errno)) {
+      break;
+    }
+    if (count < 0) {
+      return GetErrnoError("copy_file_range");
+    }
+    if (count == 0) {
+      return absl::DataLossError("Unexpected end of file");
+    }
+    remaining -= count;
+  }
+
+  // sendfile supports any output, such as sockets and pipes.
+  while (remaining > 0) {
+    ssize_t count = sendfile(out_fd, in_fd, &in_offset,
+                             std::min<uint64_t>(remaining, kMaxSendfileCount));
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count < 0 && IsUnsupportedError(errno)) {
+      break;
+    }
+    if (count < 0) {
+      return GetErrnoError("sendfile");
+    }
+    if (count == 0) {
+      return absl::DataLossError("Unexpected end of file");
+    }
+    remaining -= count;
+  }
+#endif
+
+  std::string buffer;
+  while (remaining > 0) {
+    buffer.resize(std::min<uint64_t>(remaining, kCopyBufferSize));
+    ssize_t count = pread(in_fd, &buffer[0], buffer.length(), in_offset);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count < 0) {
+      return GetErrnoError("pread");
+    }
+    if (count == 0) {
+      return absl::DataLossError("Unexpected end of file");
+    }
+    RETURN_IF_ERROR(WriteToFd(out_fd, absl::string_view(buffer.data(), count)));
+    in_offset += count;
+    remaining -= count;
+  }
+
+  return absl::OkStatus();
+}
+
+absl::Status CloneFdRange(int in_fd, uint64_t offset, uint64_t length,
+                          int out_fd) {
+#ifdef FICLONERANGE
+  uint64_t block_size = GetFdBlockSize(out_fd);
+  off_t out_offset = lseek(out_fd, 0, SEEK_CUR);
+  if (block_size == 0 || out_offset < 0 ||
+      offset % block_size != static_cast<uint64_t>(out_offset) % block_size) {
+    return CopyFdRange(in_fd, offset, length, out_fd);
+  }
+
+  uint64_t head = std::min<uint64_t>(
+      (block_size - offset % block_size) % block_size, length);
+  uint64_t middle = (length - head) / block_size * block_size;
+  if (middle == 0) {
+    return CopyFdRange(in_fd, offset, length, out_fd);
+  }
+
+  RETURN_IF_ERROR(CopyFdRange(in_fd, offset, head, out_fd));
+  if (CloneRange(in_fd, offset + head, middle, out_fd, out_offset + head)) {
+    // Cloning leaves the position of out_fd where it was.
+    if (lseek(out_fd, middle, SEEK_CUR) < 0) {
+      return GetErrnoError("lseek");
+    }
+  } else {
+    RETURN_IF_ERROR(CopyFdRange(in_fd, offset + head, middle, out_fd));
+  }
+  return CopyFdRange(in_fd, offset + head + middle, length - head - middle,
+                     out_fd);
+#else
+  return CopyFdRange(in_fd, offset, length, out_fd);
+#endif
+}
+
+uint64_t GetFdBlockSize(int fd) {
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_blksize <= 0) {
+    return 0;
+  }
+  return static_cast<uint64_t>(file_stat.st_blksize);
+}
+
+}  // namespace libmphoto
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBMPHOTO_COMMON_FD_IO_H_
+#define LIBMPHOTO_COMMON_FD_IO_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+
+namespace libmphoto {
+
+// Writes all of bytes to the current position of fd.
+absl::Status WriteToFd(int fd, const absl::string_view bytes);
+
+// Writes all of bytes to fd at offset, leaving the position of fd unchanged.
+absl::Status WriteToFdAt(int fd, const absl::string_view bytes,
+                         uint64_t offset);
+
+// Writes all of segments, in order, to the current position of fd using
+// writev, so the segments are not gathered into one buffer first.
+absl::Status WriteSegmentsToFd(int fd,
+                               const std::vector<absl::string_view> &segments);
+
+// Copies length bytes starting at offset of in_fd to the current position of
+// out_fd. The bytes are copied within the kernel with copy_file_range or
+// sendfile where supported, otherwise they are read and written through a
+// bounded buffer.
+absl::Status CopyFdRange(int in_fd, uint64_t offset, uint64_t length,
+                         int out_fd);
+
+// Copies length bytes starting at offset of in_fd to the current position of
+// out_fd, as with CopyFdRange, but shares the extents of in_fd with out_fd
+// where the filesystem supports reflinks, ie. XFS and btrfs. Only whole
+// blocks can be shared, so this requires offset and the position of out_fd
+// to have the same alignment within a block of out_fd. The aligned middle of
+// the range is then cloned with FICLONERANGE and the unaligned head and tail
+// are copied. Otherwise the whole range is copied with CopyFdRange.
+absl::Status CloneFdRange(int in_fd, uint64_t offset, uint64_t length,
+                          int out_fd);
+
+// Returns the block size of the filesystem holding fd, which is the
+// granularity CloneFdRange shares extents at, or 0 if it is unknown.
+uint64_t GetFdBlockSize(int fd);
+
+}  // namespace libmphoto
+
+#endif  // LIBMPHOTO_COMMON_FD_IO_H_
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBMPHOTO_COMMON_IMAGE_EDIT_H_
+#define LIBMPHOTO_COMMON_IMAGE_EDIT_H_
+
+#include <cstddef>
+#include <string>
+
+namespace libmphoto {
+
+// This struct describes an image updated by replacing a single range of its
+// bytes, so the update can be written out without copying the rest of the
+// image.
+struct ImageEdit {
+  // The range of the original image which is replaced.
+  size_t offset = 0;
+  size_t length = 0;
+
+  // The bytes replacing the range.
+  std::string replacement;
+
+  // True if the range is replaced by bytes of the same length, so the length
+  // of the image doesn't depend on the replacement.
+  bool in_place = false;
+};
+
+}  // namespace libmphoto
+
+#endif  // LIBMPHOTO_COMMON_IMAGE_EDIT_H_
@@ -0,0 +1,76 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "libmphoto/common/mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "absl/strings/str_cat.h"
+
+namespace libmphoto {
+
+absl::Status MappedFile::Open(const std::string &path,
+                              std::unique_ptr<MappedFile> *mapped_file) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return absl::NotFoundError(
+        absl::StrCat("Failed to open ", path, ": ", strerror(errno)));
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    close(fd);
+    return absl::InternalError(
+        absl::StrCat("Failed to stat ", path, ": ", strerror(errno)));
+  }
+
+  if (file_stat.st_size <= 0) {
+    close(fd);
+    return absl::InvalidArgumentError(absl::StrCat(path, " is empty"));
+  }
+
+  size_t length = static_cast<size_t>(file_stat.st_size);
+  void *address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  if (address == MAP_FAILED) {
+    close(fd);
+    return absl::InternalError(
+        absl::StrCat("Failed to map ", path, ": ", strerror(errno)));
+  }
+
+  mapped_file->reset(new MappedFile(fd, address, length));
+  return absl::OkStatus();
+}
+
+MappedFile::MappedFile(int fd, void *address, size_t length)
+    : fd_(fd), address_(address), length_(length) {}
+
+MappedFile::~MappedFile() {
+  munmap(address_, length_);
+  close(fd_);
+}
+
+absl::string_view MappedFile::data() const {
+  return absl::string_view(static_cast<const char *>(address_), length_);
+}
+
+int MappedFile::fd() const { return fd_; }
+
+}  // namespace libmphoto
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBMPHOTO_COMMON_MAPPED_FILE_H_
+#define LIBMPHOTO_COMMON_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+
+namespace libmphoto {
+
+// This class provides a read only memory mapping of a file. Pages are only
+// read from disk as they are touched, and the file is unmapped when the
+// MappedFile is destroyed.
+class MappedFile {
+ public:
+  // Maps the file at path, setting mapped_file on success.
+  static absl::Status Open(const std::string &path,
+                           std::unique_ptr<MappedFile> *mapped_file);
+
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  // Returns a view of the mapped bytes of the file.
+  absl::string_view data() const;
+
+  // Returns the file descriptor of the mapped file, which stays open for as
+  // long as the mapping.
+  int fd() const;
+
+ private:
+  MappedFile(int fd, void *address, size_t length);
+
+  int fd_;
+  void *address_;
+  size_t length_;
+};
+
+}  // namespace libmphoto
+
+#endif  // LIBMPHOTO_COMMON_MAPPED_FILE_H_
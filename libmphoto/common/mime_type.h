@@ -23,13 +23,22 @@
 namespace libmphoto {
 
 // Different possible mime types for containers in motion photo.
-enum class MimeType { kUnknownMimeType = 0, kImageJpeg, kImageHeic, kVideoMp4 };
+enum class MimeType {
+  kUnknownMimeType = 0,
+  kImageJpeg,
+  kImageHeic,
+  kVideoMp4,
+  kImageAvif,
+  kImageHeifSequence
+};
 
 static const std::map<MimeType, std::string> kMimeTypeToString = {
     {MimeType::kUnknownMimeType, "unknown"},
     {MimeType::kImageJpeg, "image/jpeg"},
     {MimeType::kImageHeic, "image/heic"},
-    {MimeType::kVideoMp4, "video/mp4"}};
+    {MimeType::kVideoMp4, "video/mp4"},
+    {MimeType::kImageAvif, "image/avif"},
+    {MimeType::kImageHeifSequence, "image/heif-sequence"}};
 
 }  // namespace libmphoto
 
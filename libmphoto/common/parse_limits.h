@@ -0,0 +1,41 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBMPHOTO_COMMON_PARSE_LIMITS_H_
+#define LIBMPHOTO_COMMON_PARSE_LIMITS_H_
+
+#include <cstddef>
+
+namespace libmphoto {
+
+// This struct holds the limits which bound the cost of parsing untrusted xmp.
+// Parsing stops as soon as one is exceeded, with a resource exhausted error.
+// The defaults admit any xmp written by a camera.
+struct ParseLimits {
+  // The most bytes of xmp parsed.
+  size_t max_xmp_bytes = 16 << 20;
+  // The deepest nesting of elements.
+  int max_depth = 256;
+  // The most attributes on one element.
+  int max_attributes = 1024;
+  // If false, xmp with a document type declaration is rejected, so no
+  // entities can be declared and none are expanded.
+  bool allow_dtd = false;
+};
+
+}  // namespace libmphoto
+
+#endif  // LIBMPHOTO_COMMON_PARSE_LIMITS_H_
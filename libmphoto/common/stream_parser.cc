@@ -16,51 +16,133 @@
 
 #include "libmphoto/common/stream_parser.h"
 
-#include <vector>
 #include <algorithm>
+#include <cstdint>
+#include <limits>
 
 #include "absl/strings/string_view.h"
+#include "libmphoto/common/box_parser.h"
 
 namespace libmphoto {
 
 namespace {
 
-constexpr int header_size = 16;
+constexpr uint32_t kFtypBoxType = FourCC("ftyp");
+
+// This struct maps an ftyp brand to the mime type of streams carrying it.
+// Generic brands only name the container structure, ie. any image item, and
+// give way to a specific brand listed alongside them.
+struct BrandMimeType {
+  uint32_t brand;
+  MimeType mime_type;
+  bool generic;
+};
+
+// Sorted by brand for binary search.
+constexpr BrandMimeType kBrandMimeTypes[] = {
+    {FourCC("avc1"), MimeType::kVideoMp4, false},
+    {FourCC("avif"), MimeType::kImageAvif, false},
+    {FourCC("avis"), MimeType::kImageAvif, false},
+    {FourCC("heic"), MimeType::kImageHeic, false},
+    {FourCC("heim"), MimeType::kImageHeic, false},
+    {FourCC("heis"), MimeType::kImageHeic, false},
+    {FourCC("heix"), MimeType::kImageHeic, false},
+    {FourCC("hevc"), MimeType::kImageHeifSequence, false},
+    {FourCC("hevm"), MimeType::kImageHeifSequence, false},
+    {FourCC("hevs"), MimeType::kImageHeifSequence, false},
+    {FourCC("hevx"), MimeType::kImageHeifSequence, false},
+    {FourCC("iso2"), MimeType::kVideoMp4, false},
+    {FourCC("isom"), MimeType::kVideoMp4, false},
+    {FourCC("mif1"), MimeType::kImageHeic, true},
+    {FourCC("mmp4"), MimeType::kVideoMp4, false},
+    {FourCC("mp41"), MimeType::kVideoMp4, false},
+    {FourCC("mp42"), MimeType::kVideoMp4, false},
+    {FourCC("mp71"), MimeType::kVideoMp4, false},
+    {FourCC("msf1"), MimeType::kImageHeifSequence, true},
+    {FourCC("msnv"), MimeType::kVideoMp4, false},
+    {FourCC("ndas"), MimeType::kVideoMp4, false},
+    {FourCC("ndsc"), MimeType::kVideoMp4, false},
+    {FourCC("ndsh"), MimeType::kVideoMp4, false},
+    {FourCC("ndsm"), MimeType::kVideoMp4, false},
+    {FourCC("ndsp"), MimeType::kVideoMp4, false},
+    {FourCC("ndss"), MimeType::kVideoMp4, false},
+    {FourCC("ndxc"), MimeType::kVideoMp4, false},
+    {FourCC("ndxh"), MimeType::kVideoMp4, false},
+    {FourCC("ndxm"), MimeType::kVideoMp4, false},
+    {FourCC("ndxp"), MimeType::kVideoMp4, false},
+    {FourCC("ndxs"), MimeType::kVideoMp4, false}};
+
+constexpr size_t kBrandMimeTypeCount =
+    sizeof(kBrandMimeTypes) / sizeof(kBrandMimeTypes[0]);
+
+constexpr bool BrandsAreSorted(size_t index) {
+  return index + 1 >= kBrandMimeTypeCount ||
+         (kBrandMimeTypes[index].brand < kBrandMimeTypes[index + 1].brand &&
+          BrandsAreSorted(index + 1));
+}
+
+static_assert(BrandsAreSorted(0), "kBrandMimeTypes must be sorted by brand");
+
+// Returns the entry for brand, or nullptr if the brand is not known.
+const BrandMimeType *FindBrand(uint32_t brand) {
+  const BrandMimeType *end = kBrandMimeTypes + kBrandMimeTypeCount;
+  const BrandMimeType *entry = std::lower_bound(
+      kBrandMimeTypes, end, brand,
+      [](const BrandMimeType &entry, uint32_t brand) {
+        return entry.brand < brand;
+      });
+  if (entry == end || entry->brand != brand) {
+    return nullptr;
+  }
+  return entry;
+}
+
+// Returns the mime type of an ISOBMFF stream from its ftyp box, or
+// kUnknownMimeType if the stream does not start with one.
+MimeType GetFtypMimeType(const absl::string_view stream) {
+  BoxHeader header;
+  if (!ParseBoxHeader(stream, std::numeric_limits<uint64_t>::max(), &header)
+           .ok() ||
+      header.type != kFtypBoxType) {
+    return MimeType::kUnknownMimeType;
+  }
+
+  // The box may extend past the bytes given, in which case only the brands
+  // within them are considered.
+  uint64_t box_end = std::min<uint64_t>(header.size, stream.length());
+  BoxPayloadReader reader(
+      stream.substr(header.header_size, box_end - header.header_size));
+
+  uint32_t major_brand;
+  if (!reader.ReadUint32(&major_brand) || !reader.Skip(sizeof(uint32_t))) {
+    return MimeType::kUnknownMimeType;
+  }
 
-const std::vector<const char *> kHeicFtyps = {
-    "ftypmif1", "ftypmsf1", "ftypheic", "ftypheix", "ftyphevc", "ftyphevx"};
+  const BrandMimeType *major = FindBrand(major_brand);
+  if (major && !major->generic) {
+    return major->mime_type;
+  }
 
-const std::vector<const char *> kMp4Ftyps = {
-    "avc1", "iso2", "isom", "mmp4", "mp41", "mp42", "mp71",
-    "msnv", "ndas", "ndsc", "ndsh", "ndsm", "ndsp", "ndss",
-    "ndxc", "ndxh", "ndxm", "ndxp", "ndxs"};
+  uint32_t compatible_brand;
+  while (reader.ReadUint32(&compatible_brand)) {
+    const BrandMimeType *compatible = FindBrand(compatible_brand);
+    if (compatible && !compatible->generic) {
+      return compatible->mime_type;
+    }
+  }
 
-bool AnyFtypPresentInHeader(absl::string_view header,
-                            std::vector<const char *> ftyps) {
-  return std::any_of(ftyps.begin(), ftyps.end(), [header](const char *ftyp) {
-    return header.find(ftyp) != std::string::npos;
-  });
+  return major ? major->mime_type : MimeType::kUnknownMimeType;
 }
 
 }  // namespace
 
 MimeType GetStreamMimeType(const absl::string_view stream) {
   // Check for FF D8 jpeg header.
-  if (stream.at(0) == '\xFF' && stream.at(1) == '\xD8') {
+  if (stream.length() >= 2 && stream[0] == '\xFF' && stream[1] == '\xD8') {
     return MimeType::kImageJpeg;
   }
 
-  absl::string_view header = absl::string_view(stream.data(), header_size);
-
-  if (AnyFtypPresentInHeader(header, kHeicFtyps)) {
-    return MimeType::kImageHeic;
-  }
-
-  if (AnyFtypPresentInHeader(header, kMp4Ftyps)) {
-    return MimeType::kVideoMp4;
-  }
-
-  return MimeType::kUnknownMimeType;
+  return GetFtypMimeType(stream);
 }
 
 }  // namespace libmphoto
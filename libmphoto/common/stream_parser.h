@@ -17,14 +17,25 @@
 #ifndef LIBMPHOTO_COMMON_STREAM_PARSER_H_
 #define LIBMPHOTO_COMMON_STREAM_PARSER_H_
 
-#include <string>
+#include <cstddef>
 
 #include "absl/strings/string_view.h"
 #include "libmphoto/common/mime_type.h"
 
 namespace libmphoto {
 
-// Returns the stream's mime type based on its header.
+// Bytes at the start of a stream needed to identify it, which hold a jpeg
+// start of image marker or an ftyp box header and major brand.
+constexpr size_t kMimeTypeHeaderSize = 16;
+
+// Bytes at the start of a stream which hold the ftyp box, compatible brands
+// included, of typical streams.
+constexpr size_t kMimeTypeSniffSize = 64;
+
+// Returns the stream's mime type based on its header. For ISOBMFF streams the
+// ftyp box is parsed from the given bytes, which may end within the box, and
+// its major brand is preferred over the compatible brands unless it only
+// names a generic image or sequence format.
 MimeType GetStreamMimeType(const absl::string_view stream);
 
 }  // namespace libmphoto
@@ -32,6 +32,10 @@ struct LibXmlDeleter {
   void operator()(xmlXPathObject *xpath_object) {
     xmlXPathFreeObject(xpath_object);
   }
+  void operator()(xmlParserCtxt *parser_context) {
+    xmlFreeParserCtxt(parser_context);
+  }
+  void operator()(xmlBuffer *buffer) { xmlBufferFree(buffer); }
 };
 
 }  // namespace libmphoto
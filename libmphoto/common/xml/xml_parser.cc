@@ -0,0 +1,239 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "libmphoto/common/xml/xml_parser.h"
+
+#include <utility>
+
+#include "absl/strings/str_format.h"
+#include "libxml/SAX2.h"
+#include "libxml/dict.h"
+#include "libxml/parser.h"
+#include "libmphoto/common/macros.h"
+
+namespace libmphoto {
+
+namespace {
+
+// The most dictionary entries kept across scopes. Xmp names repeat from file
+// to file, but interned whitespace and short values may not.
+constexpr int kMaxReusedDictionarySize = 16384;
+
+// This struct holds the parser state of a thread, set by the scopes open on
+// it.
+struct ThreadXmlParser {
+  ~ThreadXmlParser() { Release(); }
+
+  void Release() {
+    if (context) {
+      xmlFreeParserCtxt(context);
+      context = nullptr;
+    }
+  }
+
+  // The context reused while reuse scopes are open.
+  xmlParserCtxt *context = nullptr;
+  int scope_depth = 0;
+  // The limits of the innermost limits scope, and the first error in it.
+  const ParseLimits *limits = nullptr;
+  absl::Status limit_status;
+};
+
+ThreadXmlParser *GetThreadXmlParser() {
+  thread_local ThreadXmlParser thread_xml_parser;
+  return &thread_xml_parser;
+}
+
+// This struct holds the state of a parse held to limits, reached through the
+// _private field of its context.
+struct LimitedParse {
+  const ParseLimits *limits;
+  int depth;
+  absl::Status status;
+};
+
+void StopParse(xmlParserCtxt *context, absl::Status status) {
+  static_cast<LimitedParse *>(context->_private)->status = std::move(status);
+  xmlStopParser(context);
+}
+
+void StartElementWithLimits(void *ctx, const xmlChar *local_name,
+                            const xmlChar *prefix, const xmlChar *uri,
+                            int namespace_count, const xmlChar **namespaces,
+                            int attribute_count, int defaulted_count,
+                            const xmlChar **attributes) {
+  xmlParserCtxt *context = static_cast<xmlParserCtxt *>(ctx);
+  LimitedParse *parse = static_cast<LimitedParse *>(context->_private);
+  if (parse) {
+    if (++parse->depth > parse->limits->max_depth) {
+      StopParse(context, absl::ResourceExhaustedError(absl::StrFormat(
+                             "Xmp nesting exceeds a depth of %d",
+                             parse->limits->max_depth)));
+      return;
+    }
+    if (attribute_count > parse->limits->max_attributes) {
+      StopParse(context, absl::ResourceExhaustedError(absl::StrFormat(
+                             "Xmp element has more than %d attributes",
+                             parse->limits->max_attributes)));
+      return;
+    }
+  }
+
+  xmlSAX2StartElementNs(ctx, local_name, prefix, uri, namespace_count,
+                        namespaces, attribute_count, defaulted_count,
+                        attributes);
+}
+
+void EndElementWithLimits(void *ctx, const xmlChar *local_name,
+                          const xmlChar *prefix, const xmlChar *uri) {
+  xmlParserCtxt *context = static_cast<xmlParserCtxt *>(ctx);
+  LimitedParse *parse = static_cast<LimitedParse *>(context->_private);
+  if (parse) {
+    parse->depth--;
+  }
+
+  xmlSAX2EndElementNs(ctx, local_name, prefix, uri);
+}
+
+void InternalSubsetWithLimits(void *ctx, const xmlChar *name,
+                              const xmlChar *external_id,
+                              const xmlChar *system_id) {
+  xmlParserCtxt *context = static_cast<xmlParserCtxt *>(ctx);
+  LimitedParse *parse = static_cast<LimitedParse *>(context->_private);
+  if (parse && !parse->limits->allow_dtd) {
+    StopParse(context, absl::ResourceExhaustedError(
+                           "Xmp declares a dtd, which is not allowed"));
+    return;
+  }
+
+  xmlSAX2InternalSubset(ctx, name, external_id, system_id);
+}
+
+const absl::Status kMalformedXmlError =
+    absl::InvalidArgumentError("Failed to parse xml");
+
+// Parses xml with context, whose handlers are replaced by ones enforcing
+// limits, if not null.
+absl::Status ReadXml(const absl::string_view xml, const ParseLimits *limits,
+                     xmlParserCtxt *context,
+                     std::unique_ptr<xmlDoc, LibXmlDeleter> *xml_doc) {
+  context->sax->startElementNs = StartElementWithLimits;
+  context->sax->endElementNs = EndElementWithLimits;
+  context->sax->internalSubset = InternalSubsetWithLimits;
+
+  LimitedParse parse = {limits, 0, absl::OkStatus()};
+  context->_private = limits ? &parse : nullptr;
+  xml_doc->reset(xmlCtxtReadMemory(context, xml.data(), xml.length(), ".xml",
+                                   nullptr, limits ? XML_PARSE_NONET : 0));
+  context->_private = nullptr;
+
+  if (!parse.status.ok()) {
+    xml_doc->reset();
+    GetThreadXmlParser()->limit_status.Update(parse.status);
+    return parse.status;
+  }
+
+  return *xml_doc ? absl::OkStatus() : kMalformedXmlError;
+}
+
+}  // namespace
+
+absl::Status ReadXmlFromMemory(
+    const absl::string_view xml,
+    std::unique_ptr<xmlDoc, LibXmlDeleter> *xml_doc) {
+  xml_doc->reset();
+  RETURN_IF_ERROR(CheckXmlLength(xml.length()));
+
+  ThreadXmlParser *parser = GetThreadXmlParser();
+  if (parser->scope_depth > 0 && !parser->context) {
+    parser->context = xmlNewParserCtxt();
+  }
+
+  // The reused context is reset by each read but keeps its dictionary, which
+  // the document takes a reference to.
+  if (parser->scope_depth > 0 && parser->context) {
+    return ReadXml(xml, parser->limits, parser->context, xml_doc);
+  }
+
+  if (!parser->limits) {
+    xml_doc->reset(xmlReadMemory(xml.data(), xml.length(), ".xml", nullptr, 0));
+    return *xml_doc ? absl::OkStatus() : kMalformedXmlError;
+  }
+
+  std::unique_ptr<xmlParserCtxt, LibXmlDeleter> context(xmlNewParserCtxt());
+  if (!context) {
+    return absl::InternalError("Failed to create xml parser context");
+  }
+  return ReadXml(xml, parser->limits, context.get(), xml_doc);
+}
+
+std::unique_ptr<xmlDoc, LibXmlDeleter> ReadXmlFromMemory(
+    const absl::string_view xml) {
+  std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc;
+  ReadXmlFromMemory(xml, &xml_doc).IgnoreError();
+  return xml_doc;
+}
+
+absl::Status CheckXmlLength(size_t length) {
+  ThreadXmlParser *parser = GetThreadXmlParser();
+  if (parser->limits && length > parser->limits->max_xmp_bytes) {
+    absl::Status status = absl::ResourceExhaustedError(
+        absl::StrFormat("Xmp of %u bytes exceeds the limit of %u bytes",
+                        length, parser->limits->max_xmp_bytes));
+    parser->limit_status.Update(status);
+    return status;
+  }
+
+  return absl::OkStatus();
+}
+
+ScopedXmlParseLimits::ScopedXmlParseLimits(const ParseLimits &limits)
+    : limits_(limits) {
+  ThreadXmlParser *parser = GetThreadXmlParser();
+  previous_limits_ = parser->limits;
+  previous_status_ = parser->limit_status;
+  parser->limits = &limits_;
+  parser->limit_status = absl::OkStatus();
+}
+
+ScopedXmlParseLimits::~ScopedXmlParseLimits() {
+  ThreadXmlParser *parser = GetThreadXmlParser();
+  parser->limits = previous_limits_;
+  parser->limit_status = previous_status_;
+}
+
+absl::Status ScopedXmlParseLimits::status() const {
+  return GetThreadXmlParser()->limit_status;
+}
+
+ScopedXmlParserReuse::ScopedXmlParserReuse(bool enabled) : enabled_(enabled) {
+  if (enabled_) {
+    GetThreadXmlParser()->scope_depth++;
+  }
+}
+
+ScopedXmlParserReuse::~ScopedXmlParserReuse() {
+  if (!enabled_) {
+    return;
+  }
+
+  ThreadXmlParser *parser = GetThreadXmlParser();
+  if (--parser->scope_depth == 0 && parser->context &&
+      xmlDictSize(parser->context->dict) > kMaxReusedDictionarySize) {
+    parser->Release();
+  }
+}
+
+}  // namespace libmphoto
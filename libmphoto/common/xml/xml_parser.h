@@ -0,0 +1,88 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBMPHOTO_COMMON_XML_XML_PARSER_H_
+#define LIBMPHOTO_COMMON_XML_XML_PARSER_H_
+
+#include <cstddef>
+#include <memory>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "libxml/tree.h"
+#include "libmphoto/common/parse_limits.h"
+#include "libmphoto/common/xml/libxml_deleter.h"
+
+namespace libmphoto {
+
+// Parses xml into a document. Returns a resource exhausted error if it
+// exceeds the limits of an enclosing ScopedXmlParseLimits, or an invalid
+// argument error if it is malformed. While a ScopedXmlParserReuse is enabled
+// on the calling thread, the thread's parser context is reused rather than
+// one being created per document.
+absl::Status ReadXmlFromMemory(const absl::string_view xml,
+                               std::unique_ptr<xmlDoc, LibXmlDeleter> *xml_doc);
+
+// As above, returning nullptr on any error.
+std::unique_ptr<xmlDoc, LibXmlDeleter> ReadXmlFromMemory(
+    const absl::string_view xml);
+
+// Returns a resource exhausted error if length bytes of xml exceed the limits
+// of an enclosing ScopedXmlParseLimits, recording it in the scope. For xml
+// parsed by other libraries.
+absl::Status CheckXmlLength(size_t length);
+
+// While an instance is alive, xml parsed on this thread through
+// ReadXmlFromMemory is held to its limits.
+class ScopedXmlParseLimits {
+ public:
+  explicit ScopedXmlParseLimits(const ParseLimits &limits);
+  ~ScopedXmlParseLimits();
+
+  ScopedXmlParseLimits(const ScopedXmlParseLimits &) = delete;
+  ScopedXmlParseLimits &operator=(const ScopedXmlParseLimits &) = delete;
+
+  // Returns the error for the first limit exceeded in the scope, if any.
+  absl::Status status() const;
+
+ private:
+  ParseLimits limits_;
+  const ParseLimits *previous_limits_;
+  absl::Status previous_status_;
+};
+
+// While an enabled instance is alive, documents parsed by ReadXmlFromMemory on
+// this thread share one parser context and its dictionary, so element and
+// attribute names, namespace uris and short values are interned once rather
+// than allocated for every document. When the outermost scope closes, the
+// context is released if its dictionary has grown past a bound, keeping
+// memory flat over long runs. Documents parsed in the scope reference the
+// dictionary, so they must be freed on the same thread.
+class ScopedXmlParserReuse {
+ public:
+  explicit ScopedXmlParserReuse(bool enabled);
+  ~ScopedXmlParserReuse();
+
+  ScopedXmlParserReuse(const ScopedXmlParserReuse &) = delete;
+  ScopedXmlParserReuse &operator=(const ScopedXmlParserReuse &) = delete;
+
+ private:
+  bool enabled_;
+};
+
+}  // namespace libmphoto
+
+#endif  // LIBMPHOTO_COMMON_XML_XML_PARSER_H_
@@ -0,0 +1,331 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "libmphoto/common/xml/xml_pull_parser.h"
+
+#include "absl/strings/match.h"
+#include "libmphoto/common/macros.h"
+
+namespace libmphoto {
+
+namespace {
+
+constexpr char kByteOrderMark[] = "\xEF\xBB\xBF";
+constexpr char kXmlNamespaceUri[] = "http://www.w3.org/XML/1998/namespace";
+
+const absl::Status kUnexpectedEndError =
+    absl::InvalidArgumentError("Unexpected end of xml document");
+
+bool IsWhitespace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool IsWhitespace(const absl::string_view text) {
+  for (char c : text) {
+    if (!IsWhitespace(c)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool IsNameDelimiter(char c) {
+  return IsWhitespace(c) || c == '/' || c == '>' || c == '<' || c == '=' ||
+         c == '"' || c == '\'';
+}
+
+}  // namespace
+
+constexpr int XmlPullParser::kMaxDepth;
+constexpr size_t XmlPullParser::kMaxAttributes;
+constexpr size_t XmlPullParser::kMaxNamespaces;
+
+XmlPullParser::XmlPullParser(const absl::string_view xml) : xml_(xml) {
+  if (absl::StartsWith(xml_, kByteOrderMark)) {
+    position_ = sizeof(kByteOrderMark) - 1;
+  }
+}
+
+absl::Status XmlPullParser::Next(Event *event) {
+  if (pop_pending_) {
+    PopElement();
+  }
+
+  attribute_count_ = 0;
+  if (self_closing_) {
+    self_closing_ = false;
+    pop_pending_ = true;
+    *event = Event::kEndElement;
+    return absl::OkStatus();
+  }
+
+  while (true) {
+    size_t open = xml_.find('<', position_);
+    if (depth_ == 0 &&
+        !IsWhitespace(xml_.substr(position_, open - position_))) {
+      return absl::InvalidArgumentError(
+          "Content outside of the xml root element");
+    }
+
+    if (open == absl::string_view::npos) {
+      if (!root_seen_ || depth_ > 0) {
+        return kUnexpectedEndError;
+      }
+      position_ = xml_.length();
+      *event = Event::kEndDocument;
+      return absl::OkStatus();
+    }
+
+    position_ = open;
+    absl::string_view markup = xml_.substr(open);
+    absl::string_view terminator;
+    if (absl::StartsWith(markup, "<?")) {
+      terminator = "?>";
+    } else if (absl::StartsWith(markup, "<!--")) {
+      terminator = "-->";
+    } else if (absl::StartsWith(markup, "<![CDATA[")) {
+      if (depth_ == 0) {
+        return absl::InvalidArgumentError(
+            "Character data outside of the xml root element");
+      }
+      terminator = "]]>";
+    } else if (absl::StartsWith(markup, "<!")) {
+      return absl::UnimplementedError(
+          "Xml document type declarations are not supported");
+    } else if (absl::StartsWith(markup, "</")) {
+      return ParseEndTag(event);
+    } else {
+      return ParseStartTag(event);
+    }
+
+    // Processing instructions, comments and character data are skipped.
+    size_t end = xml_.find(terminator, open + 2);
+    if (end == absl::string_view::npos) {
+      return kUnexpectedEndError;
+    }
+    position_ = end + terminator.length();
+  }
+}
+
+absl::Status XmlPullParser::ParseStartTag(Event *event) {
+  if (root_seen_ && depth_ == 0) {
+    return absl::InvalidArgumentError("Xml document has multiple roots");
+  }
+
+  if (depth_ == kMaxDepth) {
+    return absl::UnimplementedError("Xml elements are nested too deeply");
+  }
+
+  position_++;
+  absl::string_view qualified_name;
+  RETURN_IF_ERROR(ParseName(&qualified_name));
+
+  // Namespace declarations are in scope for the whole tag, so attribute names
+  // are only resolved once all of them have been read.
+  int depth = depth_ + 1;
+  while (true) {
+    size_t attribute_start = position_;
+    SkipWhitespace();
+    if (position_ >= xml_.length()) {
+      return kUnexpectedEndError;
+    }
+
+    if (xml_[position_] == '>') {
+      position_++;
+      break;
+    }
+
+    if (xml_.substr(position_, 2) == "/>") {
+      position_ += 2;
+      self_closing_ = true;
+      break;
+    }
+
+    if (position_ == attribute_start) {
+      return absl::InvalidArgumentError(
+          "Xml attributes must be separated by whitespace");
+    }
+
+    absl::string_view attribute_name;
+    RETURN_IF_ERROR(ParseName(&attribute_name));
+    SkipWhitespace();
+    if (position_ >= xml_.length() || xml_[position_] != '=') {
+      return absl::InvalidArgumentError("Xml attribute has no value");
+    }
+    position_++;
+    SkipWhitespace();
+    if (position_ >= xml_.length() ||
+        (xml_[position_] != '"' && xml_[position_] != '\'')) {
+      return absl::InvalidArgumentError("Xml attribute value is not quoted");
+    }
+
+    size_t value_end = xml_.find(xml_[position_], position_ + 1);
+    if (value_end == absl::string_view::npos) {
+      return kUnexpectedEndError;
+    }
+    absl::string_view value =
+        xml_.substr(position_ + 1, value_end - position_ - 1);
+    position_ = value_end + 1;
+
+    if (value.find('<') != absl::string_view::npos) {
+      return absl::InvalidArgumentError("Xml attribute value contains '<'");
+    }
+    if (value.find('&') != absl::string_view::npos) {
+      return absl::UnimplementedError(
+          "Xml entity references in attribute values are not supported");
+    }
+
+    if (attribute_name == "xmlns") {
+      RETURN_IF_ERROR(AddNamespace(absl::string_view(), value));
+      namespaces_[namespace_count_ - 1].depth = depth;
+    } else if (absl::StartsWith(attribute_name, "xmlns:")) {
+      if (value.empty()) {
+        return absl::InvalidArgumentError("Xml namespace prefix has no uri");
+      }
+      RETURN_IF_ERROR(AddNamespace(attribute_name.substr(6), value));
+      namespaces_[namespace_count_ - 1].depth = depth;
+    } else {
+      if (attribute_count_ == kMaxAttributes) {
+        return absl::UnimplementedError("Xml element has too many attributes");
+      }
+      for (size_t i = 0; i < attribute_count_; i++) {
+        if (attributes_[i].name.local_name == attribute_name) {
+          return absl::InvalidArgumentError("Duplicate xml attribute");
+        }
+      }
+      // The qualified name is held in the local name until it is resolved.
+      attributes_[attribute_count_].name.local_name = attribute_name;
+      attributes_[attribute_count_].value = value;
+      attribute_count_++;
+    }
+  }
+
+  RETURN_IF_ERROR(ResolveName(qualified_name, true, &name_));
+  for (size_t i = 0; i < attribute_count_; i++) {
+    Name *name = &attributes_[i].name;
+    RETURN_IF_ERROR(ResolveName(name->local_name, false, name));
+  }
+
+  open_elements_[depth_] = qualified_name;
+  depth_ = depth;
+  root_seen_ = true;
+  *event = Event::kStartElement;
+  return absl::OkStatus();
+}
+
+absl::Status XmlPullParser::ParseEndTag(Event *event) {
+  position_ += 2;
+  absl::string_view qualified_name;
+  RETURN_IF_ERROR(ParseName(&qualified_name));
+  SkipWhitespace();
+  if (position_ >= xml_.length() || xml_[position_] != '>') {
+    return absl::InvalidArgumentError("Xml end tag is not closed");
+  }
+  position_++;
+
+  if (depth_ == 0 || open_elements_[depth_ - 1] != qualified_name) {
+    return absl::InvalidArgumentError(
+        "Xml end tag does not match the open element");
+  }
+
+  RETURN_IF_ERROR(ResolveName(qualified_name, true, &name_));
+  pop_pending_ = true;
+  *event = Event::kEndElement;
+  return absl::OkStatus();
+}
+
+absl::Status XmlPullParser::ParseName(absl::string_view *name) {
+  size_t start = position_;
+  while (position_ < xml_.length() && !IsNameDelimiter(xml_[position_])) {
+    position_++;
+  }
+
+  if (position_ == start) {
+    return absl::InvalidArgumentError("Expected an xml name");
+  }
+
+  *name = xml_.substr(start, position_ - start);
+  return absl::OkStatus();
+}
+
+absl::Status XmlPullParser::AddNamespace(const absl::string_view prefix,
+                                         const absl::string_view uri) {
+  if (namespace_count_ == kMaxNamespaces) {
+    return absl::UnimplementedError("Too many xml namespace declarations");
+  }
+
+  namespaces_[namespace_count_].prefix = prefix;
+  namespaces_[namespace_count_].uri = uri;
+  namespace_count_++;
+  return absl::OkStatus();
+}
+
+absl::Status XmlPullParser::ResolveName(const absl::string_view qualified_name,
+                                        bool is_element, Name *name) const {
+  size_t colon = qualified_name.find(':');
+  absl::string_view prefix;
+  if (colon == absl::string_view::npos) {
+    name->local_name = qualified_name;
+  } else {
+    prefix = qualified_name.substr(0, colon);
+    name->local_name = qualified_name.substr(colon + 1);
+    if (prefix.empty() || name->local_name.empty() ||
+        name->local_name.find(':') != absl::string_view::npos) {
+      return absl::InvalidArgumentError("Malformed xml qualified name");
+    }
+  }
+
+  // Unprefixed attributes are in no namespace, unprefixed elements are in the
+  // default namespace if one is declared.
+  name->uri = absl::string_view();
+  if (prefix.empty() && !is_element) {
+    return absl::OkStatus();
+  }
+
+  if (prefix == "xml") {
+    name->uri = kXmlNamespaceUri;
+    return absl::OkStatus();
+  }
+
+  for (size_t i = namespace_count_; i > 0; i--) {
+    if (namespaces_[i - 1].prefix == prefix) {
+      name->uri = namespaces_[i - 1].uri;
+      return absl::OkStatus();
+    }
+  }
+
+  if (!prefix.empty()) {
+    return absl::InvalidArgumentError("Undeclared xml namespace prefix");
+  }
+
+  return absl::OkStatus();
+}
+
+void XmlPullParser::SkipWhitespace() {
+  while (position_ < xml_.length() && IsWhitespace(xml_[position_])) {
+    position_++;
+  }
+}
+
+void XmlPullParser::PopElement() {
+  while (namespace_count_ > 0 &&
+         namespaces_[namespace_count_ - 1].depth == depth_) {
+    namespace_count_--;
+  }
+  depth_--;
+  pop_pending_ = false;
+}
+
+}  // namespace libmphoto
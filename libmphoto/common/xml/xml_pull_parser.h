@@ -0,0 +1,108 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBMPHOTO_COMMON_XML_XML_PULL_PARSER_H_
+#define LIBMPHOTO_COMMON_XML_XML_PULL_PARSER_H_
+
+#include <cstddef>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+
+namespace libmphoto {
+
+// This class provides a minimal, non-validating pull parser over an xml
+// document in memory. Names, namespace uris and attribute values are views
+// into the document, so parsing allocates nothing. Constructs which would need
+// a full parser to interpret, such as document type declarations and entity
+// references in attribute values, are rejected with an unimplemented error so
+// the caller can fall back to one.
+class XmlPullParser {
+ public:
+  enum class Event { kStartElement, kEndElement, kEndDocument };
+
+  // A namespace qualified name. The uri is empty for names in no namespace.
+  struct Name {
+    absl::string_view uri;
+    absl::string_view local_name;
+  };
+
+  struct Attribute {
+    Name name;
+    absl::string_view value;
+  };
+
+  explicit XmlPullParser(const absl::string_view xml);
+
+  // Sets event to the next event in the document. Self closing elements
+  // produce both a start and an end event. Once the root element is closed,
+  // checks that only whitespace, comments and processing instructions remain
+  // and returns kEndDocument.
+  absl::Status Next(Event *event);
+
+  // The depth of the element of the current event, 1 for the root element.
+  int depth() const { return depth_; }
+
+  // The name of the element of the current event.
+  const Name &name() const { return name_; }
+
+  // The attributes of the element of the current start event, not including
+  // namespace declarations.
+  size_t attribute_count() const { return attribute_count_; }
+  const Attribute &attribute(size_t index) const { return attributes_[index]; }
+
+ private:
+  static constexpr int kMaxDepth = 32;
+  static constexpr size_t kMaxAttributes = 32;
+  static constexpr size_t kMaxNamespaces = 32;
+
+  struct Namespace {
+    absl::string_view prefix;
+    absl::string_view uri;
+    int depth;
+  };
+
+  absl::string_view xml_;
+  size_t position_ = 0;
+  int depth_ = 0;
+  bool root_seen_ = false;
+  // Set when the current event ends an element, which is popped on the next
+  // call so depth and name still describe it.
+  bool pop_pending_ = false;
+  // Set when the current event starts a self closing element.
+  bool self_closing_ = false;
+  Name name_;
+  // Qualified names of the open elements, to match against end tags.
+  absl::string_view open_elements_[kMaxDepth];
+  Namespace namespaces_[kMaxNamespaces];
+  size_t namespace_count_ = 0;
+  Attribute attributes_[kMaxAttributes];
+  size_t attribute_count_ = 0;
+
+  absl::Status ParseStartTag(Event *event);
+  absl::Status ParseEndTag(Event *event);
+  absl::Status ParseName(absl::string_view *name);
+  absl::Status AddNamespace(const absl::string_view prefix,
+                            const absl::string_view uri);
+  absl::Status ResolveName(const absl::string_view qualified_name,
+                           bool is_element, Name *name) const;
+  void SkipWhitespace();
+  void PopElement();
+};
+
+}  // namespace libmphoto
+
+#endif  // LIBMPHOTO_COMMON_XML_XML_PULL_PARSER_H_
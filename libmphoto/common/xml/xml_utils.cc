@@ -14,8 +14,17 @@
 
 #include "libmphoto/common/xml/xml_utils.h"
 
+#include <algorithm>
+#include <cstring>
 #include <memory>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/strip.h"
+#include "absl/synchronization/mutex.h"
+#include "libxml/hash.h"
 #include "libxml/parser.h"
 #include "libxml/xpathInternals.h"
 #include "libmphoto/common/xml/libxml_deleter.h"
@@ -25,9 +34,88 @@ namespace libmphoto {
 
 namespace {
 
+// The most xpath contexts kept for reuse, past which released contexts are
+// freed.
+constexpr size_t kMaxPooledXPathContexts = 64;
+
+// This class holds the compiled form of every xpath evaluated on a thread, as
+// compiling costs more than evaluating the short xpaths used. Evaluation
+// writes to compiled xpaths which call functions, so each thread compiles its
+// own. Entries are only freed when the thread exits, as the xpaths used are
+// the constants of xmp_field_paths.h.
+class XPathCache {
+ public:
+  static XPathCache *Get() {
+    thread_local XPathCache cache;
+    return &cache;
+  }
+
+  ~XPathCache() {
+    for (const auto &entry : compiled_xpaths_) {
+      xmlXPathFreeCompExpr(entry.second);
+    }
+  }
+
+  // Returns the compiled xpath, or nullptr if it does not compile.
+  xmlXPathCompExpr *Compile(const char *xpath) {
+    auto it = compiled_xpaths_.find(absl::string_view(xpath));
+    if (it != compiled_xpaths_.end()) {
+      return it->second;
+    }
+
+    xmlXPathCompExpr *compiled_xpath =
+        xmlXPathCompile(reinterpret_cast<const xmlChar *>(xpath));
+    if (compiled_xpath) {
+      compiled_xpaths_.emplace(xpath, compiled_xpath);
+    }
+    return compiled_xpath;
+  }
+
+ private:
+  absl::flat_hash_map<std::string, xmlXPathCompExpr *> compiled_xpaths_;
+};
+
+// This class holds released xpath contexts, which keep their registered
+// namespaces for the next document they are used with.
+class XPathContextPool {
+ public:
+  static XPathContextPool *Get() {
+    static XPathContextPool *pool = new XPathContextPool();
+    return pool;
+  }
+
+  // Returns a pooled context, or nullptr if the pool is empty.
+  xmlXPathContext *Acquire() {
+    absl::MutexLock lock(&mutex_);
+    if (xpath_contexts_.empty()) {
+      return nullptr;
+    }
+
+    xmlXPathContext *xpath_context = xpath_contexts_.back();
+    xpath_contexts_.pop_back();
+    return xpath_context;
+  }
+
+  void Release(xmlXPathContext *xpath_context) {
+    {
+      absl::MutexLock lock(&mutex_);
+      if (xpath_contexts_.size() < kMaxPooledXPathContexts) {
+        xpath_contexts_.push_back(xpath_context);
+        return;
+      }
+    }
+
+    xmlXPathFreeContext(xpath_context);
+  }
+
+ private:
+  absl::Mutex mutex_;
+  std::vector<xmlXPathContext *> xpath_contexts_ ABSL_GUARDED_BY(mutex_);
+};
+
 absl::Status RegisterNamespaces(
     const std::vector<std::pair<const std::string, const std::string>>
-        namespaces,
+        &namespaces,
     xmlXPathContext *xpath_context) {
   for (const auto &ns : namespaces) {
     if (xmlXPathRegisterNs(
@@ -41,71 +129,369 @@ absl::Status RegisterNamespaces(
   return absl::OkStatus();
 }
 
-}  // namespace
+// Returns true if exactly namespaces are registered with the xpath context.
+bool HasNamespaces(
+    const std::vector<std::pair<const std::string, const std::string>>
+        &namespaces,
+    const xmlXPathContext &xpath_context) {
+  if (!xpath_context.nsHash || xmlHashSize(xpath_context.nsHash) !=
+                                    static_cast<int>(namespaces.size())) {
+    return false;
+  }
+
+  for (const auto &ns : namespaces) {
+    const char *uri = static_cast<const char *>(xmlHashLookup(
+        xpath_context.nsHash,
+        reinterpret_cast<const xmlChar *>(ns.first.c_str())));
+    if (!uri || std::strcmp(uri, ns.second.c_str()) != 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// The most steps in the xpath of a field resolved by FindXmlAttributes.
+constexpr int kMaxXmlFieldSteps = 12;
+
+const absl::Status kUnsupportedFieldXPathError = absl::InvalidArgumentError(
+    "Field xpath is not a path of child elements to an attribute");
+
+// This struct holds one step of a field xpath, matching elements or
+// attributes by name, and elements optionally by position among the siblings
+// matching the name. A position of 0 matches every sibling.
+struct XmlFieldStep {
+  absl::string_view uri;
+  absl::string_view local_name;
+  int position;
+};
+
+// This struct holds a parsed field xpath. It is left uninitialized until
+// parsed, as a table of them is built per lookup.
+struct XmlField {
+  XmlFieldStep elements[kMaxXmlFieldSteps];
+  int element_count;
+  XmlFieldStep attribute;
+};
+
+// Parses a step such as Container:Item or rdf:li[2], resolving its prefix.
+absl::Status ParseXmlFieldStep(
+    absl::string_view text,
+    const std::vector<std::pair<const std::string, const std::string>>
+        &namespaces,
+    XmlFieldStep *step) {
+  *step = XmlFieldStep();
+  size_t bracket = text.find('[');
+  if (bracket != absl::string_view::npos) {
+    if (!absl::ConsumeSuffix(&text, "]") ||
+        !absl::SimpleAtoi(text.substr(bracket + 1), &step->position) ||
+        step->position < 1) {
+      return kUnsupportedFieldXPathError;
+    }
+    text = text.substr(0, bracket);
+  }
+
+  size_t colon = text.find(':');
+  absl::string_view prefix;
+  if (colon == absl::string_view::npos) {
+    step->local_name = text;
+  } else {
+    prefix = text.substr(0, colon);
+    step->local_name = text.substr(colon + 1);
+  }
+
+  // Name tests other than plain names, such as wildcards, are not supported.
+  if (step->local_name.empty() ||
+      step->local_name.find_first_of("*()[]@:=") != absl::string_view::npos) {
+    return kUnsupportedFieldXPathError;
+  }
+
+  if (prefix.empty()) {
+    return absl::OkStatus();
+  }
+
+  for (const auto &ns : namespaces) {
+    if (ns.first == prefix) {
+      step->uri = ns.second;
+      return absl::OkStatus();
+    }
+  }
+
+  return absl::InvalidArgumentError(
+      absl::StrCat("Unregistered namespace prefix in xpath: ", prefix));
+}
+
+absl::Status ParseXmlField(
+    const char *xpath,
+    const std::vector<std::pair<const std::string, const std::string>>
+        &namespaces,
+    XmlField *field) {
+  field->element_count = 0;
+  absl::string_view path(xpath);
+  while (absl::ConsumePrefix(&path, "/")) {
+    absl::string_view text = path.substr(0, path.find('/'));
+    path.remove_prefix(text.length());
+
+    if (absl::ConsumePrefix(&text, "@")) {
+      if (!path.empty() || text.find('[') != absl::string_view::npos) {
+        return kUnsupportedFieldXPathError;
+      }
+      return ParseXmlFieldStep(text, namespaces, &field->attribute);
+    }
+
+    if (field->element_count == kMaxXmlFieldSteps) {
+      return kUnsupportedFieldXPathError;
+    }
+    RETURN_IF_ERROR(ParseXmlFieldStep(
+        text, namespaces, &field->elements[field->element_count++]));
+  }
+
+  return kUnsupportedFieldXPathError;
+}
+
+// Compares without measuring the length of the libxml string first.
+bool Equals(const absl::string_view view, const xmlChar *text) {
+  const char *chars = reinterpret_cast<const char *>(text);
+  return std::strncmp(chars, view.data(), view.length()) == 0 &&
+         chars[view.length()] == '\0';
+}
+
+bool MatchesXmlFieldStep(const XmlFieldStep &step, const xmlNs *ns,
+                         const xmlChar *name) {
+  if (!Equals(step.local_name, name)) {
+    return false;
+  }
+
+  // Unprefixed steps match names in no namespace, as in xpath.
+  if (!ns || !ns->href) {
+    return step.uri.empty();
+  }
+  return Equals(step.uri, ns->href);
+}
+
+// Matches the children of an element at depth against the fields in active,
+// recursing into those which match a step of a field with steps left. pending
+// holds the fields whose first attribute is yet to be found, and the walk
+// stops once there are none.
+void MatchXmlFields(const xmlNode *first_child, int depth, uint32_t active,
+                    const XmlField *fields, size_t count, uint32_t *pending,
+                    xmlAttr **attributes) {
+  // The number of siblings so far matching each field's step at this depth.
+  int matches[kMaxXmlFields] = {};
+
+  for (const xmlNode *node = first_child; node && (active & *pending);
+       node = node->next) {
+    if (node->type != XML_ELEMENT_NODE) {
+      continue;
+    }
+
+    uint32_t matched = 0;
+    for (size_t i = 0; i < count; i++) {
+      const XmlFieldStep &step = fields[i].elements[depth];
+      if ((active & *pending & (1u << i)) &&
+          MatchesXmlFieldStep(step, node->ns, node->name) &&
+          (++matches[i] == step.position || step.position == 0)) {
+        matched |= 1u << i;
+      }
+    }
+
+    // An element's attributes precede its descendants in document order.
+    uint32_t deeper = 0;
+    for (size_t i = 0; i < count; i++) {
+      if (!(matched & (1u << i))) {
+        continue;
+      }
+
+      if (fields[i].element_count > depth + 1) {
+        deeper |= 1u << i;
+        continue;
+      }
+
+      for (xmlAttr *attribute = node->properties; attribute;
+           attribute = attribute->next) {
+        if (MatchesXmlFieldStep(fields[i].attribute, attribute->ns,
+                                attribute->name)) {
+          attributes[i] = attribute;
+          *pending &= ~(1u << i);
+          break;
+        }
+      }
+    }
+
+    if (deeper) {
+      MatchXmlFields(node->children, depth + 1, deeper, fields, count, pending,
+                     attributes);
+    }
+  }
+}
+
+// Returns the first node matching xpath, or nullptr if there is none.
+xmlNode *FindXmlNode(const char *xpath, const xmlXPathContext &xpath_context) {
+  xmlXPathCompExpr *compiled_xpath = XPathCache::Get()->Compile(xpath);
+  if (!compiled_xpath) {
+    return nullptr;
+  }
 
-absl::Status GetXmlNode(const std::string &xpath,
-                        const xmlXPathContext &xpath_context,
-                        xmlNode **xml_node) {
   std::unique_ptr<xmlXPathObject, LibXmlDeleter> xpath_object(
-      xmlXPathEvalExpression(reinterpret_cast<const xmlChar *>(xpath.c_str()),
-                             const_cast<xmlXPathContext *>(&xpath_context)));
+      xmlXPathCompiledEval(compiled_xpath,
+                           const_cast<xmlXPathContext *>(&xpath_context)));
 
   if (!xpath_object || !xpath_object->nodesetval ||
+      xpath_object->nodesetval->nodeNr == 0 ||
       !xpath_object->nodesetval->nodeTab) {
-    return absl::NotFoundError("No node found for xpath: " + xpath);
+    return nullptr;
+  }
+
+  return xpath_object->nodesetval->nodeTab[0];
+}
+
+}  // namespace
+
+absl::Status GetXmlNode(const char *xpath, const xmlXPathContext &xpath_context,
+                        xmlNode **xml_node) {
+  *xml_node = FindXmlNode(xpath, xpath_context);
+
+  if (!*xml_node) {
+    return absl::NotFoundError(
+        absl::StrCat("No node found for xpath: ", xpath));
   }
 
-  *xml_node = xpath_object->nodesetval->nodeTab[0];
   return absl::OkStatus();
 }
 
-absl::Status GetXmlAttributeValue(const std::string &xpath,
+absl::Status GetXmlAttributeValue(const char *xpath,
                                   const xmlXPathContext &xpath_context,
                                   std::string *result) {
-  xmlNode *xml_node;
-  RETURN_IF_ERROR(GetXmlNode(xpath, xpath_context, &xml_node));
-  if (!xml_node->children || !xml_node->children->content) {
-    return absl::NotFoundError("No content found for xpath: " + xpath);
+  if (!FindXmlAttributeValue(xpath, xpath_context, result)) {
+    return absl::NotFoundError(
+        absl::StrCat("No content found for xpath: ", xpath));
   }
 
-  // The value is the content of the first child.
-  *result = std::string(reinterpret_cast<char *>(xml_node->children->content));
   return absl::OkStatus();
 }
 
-absl::Status SetXmlAttributeValue(const std::string &xpath,
-                                  const std::string &value,
+bool FindXmlAttributeValue(const char *xpath,
+                           const xmlXPathContext &xpath_context,
+                           std::string *result) {
+  xmlNode *xml_node = FindXmlNode(xpath, xpath_context);
+  if (!xml_node || !xml_node->children || !xml_node->children->content) {
+    return false;
+  }
+
+  // The value is the content of the first child. It is assigned rather than
+  // constructed so the capacity of result is reused.
+  result->assign(reinterpret_cast<char *>(xml_node->children->content));
+  return true;
+}
+
+absl::Status SetXmlAttributeValue(const char *xpath,
+                                  const absl::string_view value,
                                   xmlXPathContext *xpath_context) {
-  std::unique_ptr<xmlXPathObject, LibXmlDeleter> xpath_object(
-      xmlXPathEvalExpression(reinterpret_cast<const xmlChar *>(xpath.c_str()),
-                             xpath_context));
+  xmlNode *xml_node = FindXmlNode(xpath, *xpath_context);
 
-  if (!xpath_object || !xpath_object->nodesetval ||
-      !xpath_object->nodesetval->nodeTab ||
-      !xpath_object->nodesetval->nodeTab[0]->children ||
-      !xpath_object->nodesetval->nodeTab[0]->children->content) {
-    return absl::NotFoundError("No value found for xpath: " + xpath);
+  if (!xml_node || !xml_node->children || !xml_node->children->content) {
+    return absl::NotFoundError(
+        absl::StrCat("No value found for xpath: ", xpath));
+  }
+
+  xmlNodeSetContentLen(xml_node,
+                       reinterpret_cast<const xmlChar *>(value.data()),
+                       value.length());
+
+  return absl::OkStatus();
+}
+
+absl::Status FindXmlAttributes(
+    const char *const *xpaths, size_t count,
+    const std::vector<std::pair<const std::string, const std::string>>
+        &namespaces,
+    const xmlDoc &xml_doc, XmlFieldLookup *lookup) {
+  if (count > kMaxXmlFields) {
+    return absl::InvalidArgumentError("Too many xml fields to find at once");
+  }
+
+  XmlField fields[kMaxXmlFields];
+  for (size_t i = 0; i < count; i++) {
+    RETURN_IF_ERROR(ParseXmlField(xpaths[i], namespaces, &fields[i]));
+  }
+
+  uint32_t all = count == kMaxXmlFields ? UINT32_MAX : (1u << count) - 1;
+  uint32_t pending = all;
+  std::fill(lookup->attributes, lookup->attributes + kMaxXmlFields, nullptr);
+  MatchXmlFields(xml_doc.children, 0, all, fields, count, &pending,
+                 lookup->attributes);
+
+  // As with an xpath lookup, the first attribute selected must have a value.
+  lookup->found = 0;
+  for (size_t i = 0; i < count; i++) {
+    xmlAttr *attribute = lookup->attributes[i];
+    if (attribute && attribute->children && attribute->children->content) {
+      lookup->found |= 1u << i;
+    } else {
+      lookup->attributes[i] = nullptr;
+    }
   }
+  lookup->missing = all & ~lookup->found;
+
+  return absl::OkStatus();
+}
 
-  xmlNodeSetContent(xpath_object->nodesetval->nodeTab[0],
-                    reinterpret_cast<const xmlChar *>(value.c_str()));
+absl::Status CheckXmlFieldsFound(const XmlFieldLookup &lookup,
+                                 uint32_t required, const char *const *xpaths) {
+  for (size_t i = 0; i < kMaxXmlFields; i++) {
+    if (required & lookup.missing & (1u << i)) {
+      return absl::NotFoundError(
+          absl::StrCat("No value found for xpath: ", xpaths[i]));
+    }
+  }
 
   return absl::OkStatus();
 }
 
-std::unique_ptr<xmlXPathContext, LibXmlDeleter> GetXPathContext(
+absl::string_view GetXmlAttributeValue(const xmlAttr &attribute) {
+  return reinterpret_cast<const char *>(attribute.children->content);
+}
+
+void SetXmlAttributeValue(const absl::string_view value, xmlAttr *attribute) {
+  xmlNodeSetContentLen(reinterpret_cast<xmlNode *>(attribute),
+                       reinterpret_cast<const xmlChar *>(value.data()),
+                       value.length());
+}
+
+void XPathContextReleaser::operator()(xmlXPathContext *xpath_context) {
+  xpath_context->doc = nullptr;
+  xpath_context->node = nullptr;
+  XPathContextPool::Get()->Release(xpath_context);
+}
+
+std::unique_ptr<xmlXPathContext, XPathContextReleaser> GetXPathContext(
     const std::vector<std::pair<const std::string, const std::string>>
-        namespaces,
+        &namespaces,
     xmlDoc *xml_doc) {
-  std::unique_ptr<xmlXPathContext, LibXmlDeleter> xpath_context(
-      xmlXPathNewContext(xml_doc));
+  std::unique_ptr<xmlXPathContext, XPathContextReleaser> xpath_context(
+      XPathContextPool::Get()->Acquire());
 
   if (!xpath_context) {
-    return nullptr;
+    xpath_context.reset(xmlXPathNewContext(xml_doc));
+    if (!xpath_context) {
+      return nullptr;
+    }
+
+    // Result objects are recycled by the context rather than reallocated.
+    xmlXPathContextSetCache(xpath_context.get(), 1, -1, 0);
   }
 
-  if (!RegisterNamespaces(namespaces, xpath_context.get()).ok()) {
-    return nullptr;
+  // A pooled context is reset to the state of a new one over xml_doc.
+  xpath_context->doc = xml_doc;
+  xpath_context->node = nullptr;
+  xpath_context->contextSize = -1;
+  xpath_context->proximityPosition = -1;
+
+  if (!HasNamespaces(namespaces, *xpath_context)) {
+    xmlXPathRegisteredNsCleanup(xpath_context.get());
+    if (!RegisterNamespaces(namespaces, xpath_context.get()).ok()) {
+      return nullptr;
+    }
   }
 
   return xpath_context;
@@ -17,12 +17,15 @@
 #ifndef LIBMPHOTO_COMMON_XML_XML_UTILS_H_
 #define LIBMPHOTO_COMMON_XML_XML_UTILS_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 #include <utility>
 #include <string>
 #include <memory>
 
 #include "absl/status/status.h"
+#include "absl/strings/string_view.h"
 #include "libxml/xpath.h"
 #include "libxml/tree.h"
 #include "libmphoto/common/xml/libxml_deleter.h"
@@ -33,24 +36,77 @@ static const absl::Status kFailedXPathCreationError =
     absl::InternalError("Failed to create xpath context");
 
 // Gets a particular xml node.
-absl::Status GetXmlNode(const std::string &xpath,
-                        const xmlXPathContext &xpath_context,
+absl::Status GetXmlNode(const char *xpath, const xmlXPathContext &xpath_context,
                         xmlNode **xml_node);
 
 // Gets the value of a particular xml attribute.
-absl::Status GetXmlAttributeValue(const std::string &xpath,
+absl::Status GetXmlAttributeValue(const char *xpath,
                                   const xmlXPathContext &xpath_context,
                                   std::string *result);
 
+// Gets the value of a particular xml attribute if it is present, returning
+// false without building an error when it is not.
+bool FindXmlAttributeValue(const char *xpath,
+                           const xmlXPathContext &xpath_context,
+                           std::string *result);
+
 // Sets the value of a particular xml attribute.
-absl::Status SetXmlAttributeValue(const std::string &xpath,
-                                  const std::string &value,
+absl::Status SetXmlAttributeValue(const char *xpath,
+                                  const absl::string_view value,
                                   xmlXPathContext *xpath_context);
 
-// Returns a xpath context with namespaces registered.
-std::unique_ptr<xmlXPathContext, LibXmlDeleter> GetXPathContext(
+// The most fields resolved by a single FindXmlAttributes call, one per bit of
+// its masks.
+constexpr size_t kMaxXmlFields = 32;
+
+// This struct holds the result of resolving a table of attribute xpaths.
+struct XmlFieldLookup {
+  // The attribute selected by each xpath if found with a value, otherwise
+  // nullptr.
+  xmlAttr *attributes[kMaxXmlFields];
+  // Bit i is set if the attribute selected by xpaths[i] was found with a
+  // value, as FindXmlAttributeValue would.
+  uint32_t found;
+  // Bit i is set if it was not.
+  uint32_t missing;
+};
+
+// Resolves the attributes selected by count xpaths in a single walk of the
+// document, rather than descending from the root once per xpath. As with
+// evaluating each xpath, the first attribute in document order is selected.
+// The xpaths are limited to absolute paths of child element steps, each with
+// an optional position, followed by an attribute step, such as
+// /x:a/y:b[2]/@y:c. Returns an error for other xpaths or unknown prefixes.
+absl::Status FindXmlAttributes(
+    const char *const *xpaths, size_t count,
+    const std::vector<std::pair<const std::string, const std::string>>
+        &namespaces,
+    const xmlDoc &xml_doc, XmlFieldLookup *lookup);
+
+// Returns a not found error for the first field in the required mask missing
+// from lookup, or ok if all of them were found.
+absl::Status CheckXmlFieldsFound(const XmlFieldLookup &lookup,
+                                 uint32_t required, const char *const *xpaths);
+
+// Gets the value of an attribute found by FindXmlAttributes.
+absl::string_view GetXmlAttributeValue(const xmlAttr &attribute);
+
+// Sets the value of an attribute found by FindXmlAttributes.
+void SetXmlAttributeValue(const absl::string_view value, xmlAttr *attribute);
+
+// Returns xpath contexts from GetXPathContext to a pool rather than freeing
+// them.
+struct XPathContextReleaser {
+  void operator()(xmlXPathContext *xpath_context);
+};
+
+// Returns a xpath context with namespaces registered. Contexts are pooled
+// across documents, and namespaces are only registered again when they differ
+// from those a pooled context was last used with. Xpaths evaluated by the
+// functions above are compiled once per process and cached.
+std::unique_ptr<xmlXPathContext, XPathContextReleaser> GetXPathContext(
     const std::vector<std::pair<const std::string, const std::string>>
-        namespaces,
+        &namespaces,
     xmlDoc *xml_doc);
 
 }  // namespace libmphoto
@@ -23,13 +23,24 @@
 
 namespace libmphoto {
 
+// Namespace uris of the motion photo metadata.
+constexpr char kXmpMetaNamespaceUri[] = "adobe:ns:meta/";
+constexpr char kRdfNamespaceUri[] =
+    "http://www.w3.org/1999/02/22-rdf-syntax-ns#";
+constexpr char kCameraNamespaceUri[] =
+    "http://ns.google.com/photos/1.0/camera/";
+constexpr char kContainerNamespaceUri[] =
+    "http://ns.google.com/photos/1.0/container/";
+constexpr char kItemNamespaceUri[] =
+    "http://ns.google.com/photos/1.0/container/item/";
+
 const std::vector<std::pair<const std::string, const std::string>> kNamespaces =
-    {{"x", "adobe:ns:meta/"},
-     {"rdf", "http://www.w3.org/1999/02/22-rdf-syntax-ns#"},
-     {"Camera", "http://ns.google.com/photos/1.0/camera/"},
-     {"Container", "http://ns.google.com/photos/1.0/container/"},
-     {"Item", "http://ns.google.com/photos/1.0/container/item/"},
-     {"GCamera", "http://ns.google.com/photos/1.0/camera/"}};
+    {{"x", kXmpMetaNamespaceUri},
+     {"rdf", kRdfNamespaceUri},
+     {"Camera", kCameraNamespaceUri},
+     {"Container", kContainerNamespaceUri},
+     {"Item", kItemNamespaceUri},
+     {"GCamera", kCameraNamespaceUri}};
 
 // Motion Photo Spec metadata xpaths.
 constexpr char kMotionPhotoXPath[] =
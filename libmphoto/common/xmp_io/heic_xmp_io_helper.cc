@@ -14,13 +14,17 @@
 
 #include "libmphoto/common/xmp_io/heic_xmp_io_helper.h"
 
+#include <algorithm>
+#include <string>
+#include <utility>
 #include <vector>
 
-#include "libxml/parser.h"
 #include "libheif/heif.h"
 #include "libheif/heif_api_structs.h"
 #include "libheif/error.h"
+#include "libmphoto/common/box_parser.h"
 #include "libmphoto/common/macros.h"
+#include "libmphoto/common/xml/xml_parser.h"
 #include "libmphoto/common/xmp_io/libheif_deleter.h"
 
 namespace libmphoto {
@@ -32,10 +36,218 @@ namespace {
 constexpr char kMetadataTypeXmp[] = "mime";
 constexpr char kContentTypeXmp[] = "application/rdf+xml";
 
-}  // namespace
+constexpr uint32_t kMetaBoxType = FourCC("meta");
+constexpr uint32_t kItemInfoBoxType = FourCC("iinf");
+constexpr uint32_t kItemInfoEntryBoxType = FourCC("infe");
+constexpr uint32_t kItemLocationBoxType = FourCC("iloc");
+constexpr uint32_t kItemDataBoxType = FourCC("idat");
+constexpr uint32_t kMimeItemType = FourCC("mime");
 
-std::unique_ptr<xmlDoc, LibXmlDeleter> HeicXmpIOHelper::GetXmp(
-    const std::string &image) {
+const absl::Status kXmpNotFoundError =
+    absl::NotFoundError("No xmp found in heic");
+
+// Item location construction methods, as per ISO 14496-12.
+constexpr uint64_t kFileOffsetConstructionMethod = 0;
+constexpr uint64_t kIdatOffsetConstructionMethod = 1;
+
+// This struct holds where an item's data is stored.
+struct ItemLocation {
+  uint64_t construction_method = kFileOffsetConstructionMethod;
+  uint64_t base_offset = 0;
+  // Offset and length of each extent, relative to the base offset.
+  std::vector<std::pair<uint64_t, uint64_t>> extents;
+};
+
+// Finds the child box of the given type within a container's payload,
+// setting box to the whole child box.
+bool FindChildBox(const absl::string_view payload, uint32_t type,
+                  absl::string_view *box, BoxHeader *header) {
+  size_t offset = 0;
+  while (offset < payload.length()) {
+    if (!ParseBoxHeader(payload.substr(offset), payload.length() - offset,
+                        header)
+             .ok()) {
+      return false;
+    }
+
+    if (header->type == type) {
+      *box = payload.substr(offset, header->size);
+      return true;
+    }
+
+    offset += header->size;
+  }
+
+  return false;
+}
+
+// Finds the id of the xmp item in the payload of an iinf box.
+bool FindXmpItemId(const absl::string_view iinf_payload, uint32_t *item_id) {
+  BoxPayloadReader reader(iinf_payload);
+  uint8_t version;
+  if (!reader.ReadUint8(&version) || !reader.Skip(3) ||
+      !reader.Skip(version == 0 ? 2 : 4)) {
+    return false;
+  }
+
+  absl::string_view entries = reader.Remaining();
+  size_t offset = 0;
+  while (offset < entries.length()) {
+    BoxHeader header;
+    if (!ParseBoxHeader(entries.substr(offset), entries.length() - offset,
+                        &header)
+             .ok()) {
+      return false;
+    }
+
+    absl::string_view entry = entries.substr(offset, header.size);
+    offset += header.size;
+    if (header.type != kItemInfoEntryBoxType) {
+      continue;
+    }
+
+    BoxPayloadReader entry_reader(entry.substr(header.header_size));
+    uint8_t entry_version;
+    if (!entry_reader.ReadUint8(&entry_version) || !entry_reader.Skip(3)) {
+      return false;
+    }
+
+    // Version 0 and 1 entries have no item type, and are described by a
+    // content type just as mime items are.
+    uint64_t id;
+    uint32_t item_type = kMimeItemType;
+    absl::string_view item_name;
+    if (!entry_reader.ReadUint(entry_version == 3 ? 4 : 2, &id) ||
+        !entry_reader.Skip(2) ||
+        (entry_version >= 2 && !entry_reader.ReadUint32(&item_type)) ||
+        !entry_reader.ReadString(&item_name)) {
+      return false;
+    }
+
+    absl::string_view content_type;
+    if (item_type == kMimeItemType &&
+        entry_reader.ReadString(&content_type) &&
+        content_type == kContentTypeXmp) {
+      *item_id = static_cast<uint32_t>(id);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Finds the location of an item in the payload of an iloc box.
+bool FindItemLocation(const absl::string_view iloc_payload, uint32_t item_id,
+                      ItemLocation *location) {
+  BoxPayloadReader reader(iloc_payload);
+  uint8_t version;
+  uint8_t offset_and_length_size;
+  uint8_t base_offset_and_index_size;
+  if (!reader.ReadUint8(&version) || version > 2 || !reader.Skip(3) ||
+      !reader.ReadUint8(&offset_and_length_size) ||
+      !reader.ReadUint8(&base_offset_and_index_size)) {
+    return false;
+  }
+
+  size_t offset_size = offset_and_length_size >> 4;
+  size_t length_size = offset_and_length_size & 0xF;
+  size_t base_offset_size = base_offset_and_index_size >> 4;
+  size_t index_size = version > 0 ? base_offset_and_index_size & 0xF : 0;
+
+  uint64_t item_count;
+  if (!reader.ReadUint(version < 2 ? 2 : 4, &item_count)) {
+    return false;
+  }
+
+  for (uint64_t i = 0; i < item_count; i++) {
+    uint64_t id;
+    uint64_t construction_method = kFileOffsetConstructionMethod;
+    uint64_t base_offset;
+    uint16_t extent_count;
+    if (!reader.ReadUint(version < 2 ? 2 : 4, &id) ||
+        (version > 0 && !reader.ReadUint(2, &construction_method)) ||
+        !reader.Skip(2) || !reader.ReadUint(base_offset_size, &base_offset) ||
+        !reader.ReadUint16(&extent_count)) {
+      return false;
+    }
+
+    location->extents.clear();
+    for (uint16_t j = 0; j < extent_count; j++) {
+      uint64_t extent_index;
+      uint64_t extent_offset;
+      uint64_t extent_length;
+      if (!reader.ReadUint(index_size, &extent_index) ||
+          !reader.ReadUint(offset_size, &extent_offset) ||
+          !reader.ReadUint(length_size, &extent_length)) {
+        return false;
+      }
+      location->extents.emplace_back(extent_offset, extent_length);
+    }
+
+    if (id == item_id) {
+      // The construction method is held in the low 4 bits.
+      location->construction_method = construction_method & 0xF;
+      location->base_offset = base_offset;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Reads the data of an item, concatenating its extents.
+bool ReadItemData(ByteSource *source, const absl::string_view prefix,
+                  const absl::string_view idat_payload,
+                  const ItemLocation &location, std::string *scratch,
+                  absl::string_view *data) {
+  if (location.extents.empty()) {
+    return false;
+  }
+
+  // A single extent is returned as is, without concatenation.
+  bool single_extent = location.extents.size() == 1;
+  std::string extent_scratch;
+  for (const auto &extent : location.extents) {
+    // An extent length of 0 refers to the whole referenced data, which is
+    // not expected for xmp items.
+    if (extent.second == 0 ||
+        extent.first > UINT64_MAX - location.base_offset) {
+      return false;
+    }
+
+    uint64_t offset = location.base_offset + extent.first;
+    absl::string_view extent_data;
+    if (location.construction_method == kIdatOffsetConstructionMethod) {
+      if (offset > idat_payload.length() ||
+          extent.second > idat_payload.length() - offset) {
+        return false;
+      }
+      extent_data = idat_payload.substr(offset, extent.second);
+    } else if (location.construction_method == kFileOffsetConstructionMethod) {
+      if (!ReadAtWithPrefix(source, prefix, offset, extent.second,
+                            single_extent ? scratch : &extent_scratch,
+                            &extent_data)
+               .ok()) {
+        return false;
+      }
+    } else {
+      return false;
+    }
+
+    if (single_extent) {
+      *data = extent_data;
+      return true;
+    }
+    scratch->append(extent_data.data(), extent_data.length());
+  }
+
+  *data = *scratch;
+  return true;
+}
+
+// Finds the xmp with libheif, which parses the whole container.
+std::unique_ptr<xmlDoc, LibXmlDeleter> GetXmpWithLibheif(
+    const absl::string_view image) {
   heif_error error;
 
   std::unique_ptr<heif_context, LibHeifDeleter> context(heif_context_alloc());
@@ -83,14 +295,123 @@ std::unique_ptr<xmlDoc, LibXmlDeleter> HeicXmpIOHelper::GetXmp(
     return nullptr;
   }
 
-  return std::unique_ptr<xmlDoc, LibXmlDeleter>(
-      xmlReadMemory(xmp.data(), xmp_size, ".xml", nullptr, 0));
+  return ReadXmlFromMemory(absl::string_view(xmp.data(), xmp_size));
+}
+
+}  // namespace
+
+std::unique_ptr<xmlDoc, LibXmlDeleter> HeicXmpIOHelper::GetXmp(
+    const absl::string_view image) {
+  // The xmp item is found by walking the boxes down to it, and parsed in
+  // place. libheif is kept as a fallback for files the walk rejects.
+  MemoryByteSource source(image);
+  std::string scratch;
+  absl::string_view xmp;
+  if (ReadXmpPacket(&source, &scratch, &xmp).ok()) {
+    return ReadXmlFromMemory(xmp);
+  }
+
+  return GetXmpWithLibheif(image);
+}
+
+std::unique_ptr<xmlDoc, LibXmlDeleter> HeicXmpIOHelper::GetXmp(
+    ByteSource *source) {
+  std::string scratch;
+  absl::string_view xmp;
+  if (!ReadXmpPacket(source, &scratch, &xmp).ok()) {
+    return nullptr;
+  }
+
+  return ReadXmlFromMemory(xmp);
+}
+
+absl::Status HeicXmpIOHelper::ReadXmpPacket(ByteSource *source,
+                                            std::string *scratch,
+                                            absl::string_view *xmp) {
+  uint64_t size = source->Size();
+  std::string prefix_scratch;
+  absl::string_view prefix;
+  RETURN_IF_ERROR(
+      source->ReadPrefix(kPrefixReadSize, &prefix_scratch, &prefix));
+
+  // Walk the top level box headers to find the meta box.
+  std::string box_scratch;
+  absl::string_view meta;
+  BoxHeader header;
+  uint64_t offset = 0;
+  while (meta.empty()) {
+    if (offset >= size) {
+      return kXmpNotFoundError;
+    }
+
+    absl::string_view header_data;
+    RETURN_IF_ERROR(ReadAtWithPrefix(
+        source, prefix, offset,
+        std::min<uint64_t>(size - offset, kLargeBoxHeaderSize), &box_scratch,
+        &header_data));
+    RETURN_IF_ERROR(ParseBoxHeader(header_data, size - offset, &header));
+
+    if (header.type == kMetaBoxType) {
+      RETURN_IF_ERROR(ReadAtWithPrefix(source, prefix, offset, header.size,
+                                       &box_scratch, &meta));
+    }
+
+    offset += header.size;
+  }
+
+  if (meta.length() < header.header_size + kFullBoxHeaderSize) {
+    return kXmpNotFoundError;
+  }
+  absl::string_view meta_payload =
+      meta.substr(header.header_size + kFullBoxHeaderSize);
+
+  absl::string_view iinf;
+  BoxHeader iinf_header;
+  uint32_t item_id = 0;
+  if (!FindChildBox(meta_payload, kItemInfoBoxType, &iinf, &iinf_header) ||
+      !FindXmpItemId(iinf.substr(iinf_header.header_size), &item_id)) {
+    return kXmpNotFoundError;
+  }
+
+  absl::string_view iloc;
+  BoxHeader iloc_header;
+  ItemLocation location;
+  if (!FindChildBox(meta_payload, kItemLocationBoxType, &iloc, &iloc_header) ||
+      !FindItemLocation(iloc.substr(iloc_header.header_size), item_id,
+                        &location)) {
+    return kXmpNotFoundError;
+  }
+
+  absl::string_view idat;
+  BoxHeader idat_header;
+  absl::string_view idat_payload;
+  if (FindChildBox(meta_payload, kItemDataBoxType, &idat, &idat_header)) {
+    idat_payload = idat.substr(idat_header.header_size);
+  }
+
+  if (!ReadItemData(source, prefix, idat_payload, location, scratch, xmp)) {
+    return kXmpNotFoundError;
+  }
+
+  // The packet outlives the local buffers only if copied out of them.
+  if (IsViewOf(*xmp, prefix_scratch) || IsViewOf(*xmp, box_scratch)) {
+    scratch->assign(xmp->data(), xmp->length());
+    *xmp = *scratch;
+  }
+  return absl::OkStatus();
 }
 
 absl::Status HeicXmpIOHelper::SetXmp(const xmlDoc &xml_doc,
                                      const std::string &image,
                                      std::string *updated_image) {
-  return absl::UnimplementedError("");
+  return absl::UnimplementedError("Writing heic xmp is not supported");
+}
+
+absl::Status HeicXmpIOHelper::GetXmpEdit(const xmlDoc &xml_doc,
+                                         const absl::string_view image,
+                                         const XmpWriteOptions &options,
+                                         ImageEdit *edit) {
+  return absl::UnimplementedError("Editing heic xmp is not supported");
 }
 
 MimeType HeicXmpIOHelper::GetMimeType() { return MimeType::kImageHeic; }
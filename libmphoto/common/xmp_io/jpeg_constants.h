@@ -0,0 +1,46 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBMPHOTO_COMMON_XMP_IO_JPEG_CONSTANTS_H_
+#define LIBMPHOTO_COMMON_XMP_IO_JPEG_CONSTANTS_H_
+
+#include <cstddef>
+
+namespace libmphoto {
+
+constexpr char kJpegMarkerPrefix = '\xFF';
+constexpr char kJpegStartOfImageMarker = '\xD8';
+constexpr char kJpegEndOfImageMarker = '\xD9';
+constexpr char kJpegStartOfScanMarker = '\xDA';
+constexpr char kJpegApp1Marker = '\xE1';
+
+// Signature starting the payload of an APP1 segment holding standard xmp,
+// including its null terminator.
+constexpr char kJpegXmpSignature[] = "http://ns.adobe.com/xap/1.0/";
+constexpr size_t kJpegXmpSignatureSize = sizeof(kJpegXmpSignature);
+
+// Size of the start of image marker preceding the first segment.
+constexpr size_t kJpegStartOfImageSize = 2;
+
+// Size of a segment's marker and big endian length fields.
+constexpr size_t kJpegSegmentHeaderSize = 4;
+
+// Largest value of a segment's length field, which counts itself.
+constexpr size_t kJpegMaxSegmentLength = 0xFFFF;
+
+}  // namespace libmphoto
+
+#endif  // LIBMPHOTO_COMMON_XMP_IO_JPEG_CONSTANTS_H_
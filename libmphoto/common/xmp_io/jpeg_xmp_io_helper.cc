@@ -14,47 +14,316 @@
 
 #include "libmphoto/common/xmp_io/jpeg_xmp_io_helper.h"
 
-#include <sstream>
+#include <algorithm>
 
+#include "absl/base/internal/endian.h"
+#include "libmphoto/common/macros.h"
+#include "libmphoto/common/xml/xml_parser.h"
+#include "libmphoto/common/xmp_io/jpeg_constants.h"
+#include "libmphoto/common/xmp_io/jpeg_xmp_locator.h"
+#include "libxml/tree.h"
+#include "libxml/xmlsave.h"
 #include "xmpmeta/xmp_parser.h"
-#include "xmpmeta/xmp_writer.h"
 #include "xmpmeta/xmp_data.h"
 
 namespace libmphoto {
 
+namespace {
+
+// Whitespace padding added to the xmp packet of a new segment, as the xmp
+// specification recommends, so later updates can be written in place.
+constexpr size_t kXmpPaddingSize = 2048;
+
+// Padding is broken into lines of this many bytes.
+constexpr size_t kXmpPaddingLineSize = 100;
+
+// Trailer ending an xmp packet, around the value of its end attribute.
+constexpr char kXpacketTrailerStart[] = "<?xpacket end=";
+constexpr char kXpacketTrailerEnd[] = "?>";
+
+// End attribute value of a packet which can be written in place.
+constexpr char kXpacketWritable = 'w';
+
+// Returns the length of the header segments of a jpeg, up to and including the
+// start of scan segment. Xmp metadata can only be found within these segments.
+// Returns the image length if the header can't be delimited.
+size_t GetHeaderLength(const absl::string_view image) {
+  size_t position = kJpegStartOfImageSize;
+
+  while (position + kJpegSegmentHeaderSize <= image.length() &&
+         image[position] == kJpegMarkerPrefix) {
+    // Markers can be preceded by any number of fill bytes.
+    if (image[position + 1] == kJpegMarkerPrefix) {
+      position++;
+      continue;
+    }
+
+    size_t segment_end =
+        position + 2 + absl::big_endian::Load16(image.data() + position + 2);
+
+    if (image[position + 1] == kJpegStartOfScanMarker) {
+      return std::min(segment_end, image.length());
+    }
+
+    position = segment_end;
+  }
+
+  return image.length();
+}
+
+// Appends the serialized xmp of xml_doc to xmp, in the layout xmpmeta writes:
+// a line break, then each indented node up to and including the root element
+// on its own line. The xml declaration and any trailing nodes, such as an
+// xpacket trailer, are not written.
+absl::Status AppendSerializedXmp(const xmlDoc &xml_doc, std::string *xmp) {
+  std::unique_ptr<xmlBuffer, LibXmlDeleter> buffer(xmlBufferCreate());
+  if (!buffer) {
+    return absl::InternalError("Failed to serialize xmp metadata");
+  }
+
+  xmlSaveCtxt *save_context = xmlSaveToBuffer(
+      buffer.get(), "UTF-8", XML_SAVE_FORMAT | XML_SAVE_NO_DECL);
+  if (!save_context) {
+    return absl::InternalError("Failed to serialize xmp metadata");
+  }
+
+  xmlNode *root = xmlDocGetRootElement(&xml_doc);
+  for (xmlNode *node = xml_doc.children; node && root; node = node->next) {
+    xmlSaveTree(save_context, node);
+    xmlSaveFlush(save_context);
+    xmlBufferCCat(buffer.get(), "\n");
+    if (node == root) {
+      break;
+    }
+  }
+  xmlSaveClose(save_context);
+
+  if (!root) {
+    return absl::InternalError("Failed to serialize xmp metadata");
+  }
+
+  xmp->push_back('\n');
+  xmp->append(reinterpret_cast<const char *>(xmlBufferContent(buffer.get())),
+              xmlBufferLength(buffer.get()));
+  return absl::OkStatus();
+}
+
+// Returns true if xml_doc starts with an xpacket header, in which case its
+// packet is ended with a trailer.
+bool HasXpacketHeader(const xmlDoc &xml_doc) {
+  const xmlNode *node = xml_doc.children;
+  return node && node->type == XML_PI_NODE && node->name &&
+         xmlStrEqual(node->name, BAD_CAST "xpacket");
+}
+
+// Returns the end attribute value of the xpacket trailer ending packet, or
+// kXpacketWritable if it has none.
+char GetXpacketEnd(const absl::string_view packet) {
+  size_t trailer = packet.rfind(kXpacketTrailerStart);
+  if (trailer == absl::string_view::npos) {
+    return kXpacketWritable;
+  }
+
+  absl::string_view value =
+      packet.substr(trailer + sizeof(kXpacketTrailerStart) - 1);
+  if (value.length() < 3 || (value[0] != '"' && value[0] != '\'') ||
+      value[2] != value[0]) {
+    return kXpacketWritable;
+  }
+  return value[1];
+}
+
+// Pads the xmp packet starting at packet_start of xmp with whitespace, ending
+// it with an xpacket trailer whose end attribute is end if xml_doc has an
+// xpacket header, so the packet is packet_length bytes. Fails with an out of
+// range error if the packet is already too long.
+absl::Status PadXmpPacket(const xmlDoc &xml_doc, size_t packet_start,
+                          size_t packet_length, char end, std::string *xmp) {
+  std::string trailer;
+  if (HasXpacketHeader(xml_doc)) {
+    trailer = std::string(kXpacketTrailerStart) + '"' + end + '"' +
+              kXpacketTrailerEnd;
+  }
+  size_t trailer_length = trailer.length();
+  size_t content_length = xmp->length() - packet_start + trailer_length;
+  if (content_length > packet_length) {
+    return absl::OutOfRangeError("Xmp metadata does not fit in the packet");
+  }
+
+  size_t padding_length = packet_length - content_length;
+  xmp->reserve(xmp->length() + padding_length + trailer_length);
+  for (size_t i = 1; i <= padding_length; i++) {
+    xmp->push_back(i % kXmpPaddingLineSize == 0 ? '\n' : ' ');
+  }
+  xmp->append(trailer);
+  return absl::OkStatus();
+}
+
+}  // namespace
+
 std::unique_ptr<xmlDoc, LibXmlDeleter> JpegXmpIOHelper::GetXmp(
-    const std::string &image) {
+    const absl::string_view image) {
+  // The xmp is located in place first, and parsed without copying any of the
+  // image. xmpmeta is kept as a fallback for files the locator rejects, but
+  // not for xmp which exceeds the parse limits, as xmpmeta does not apply
+  // them.
+  std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc;
+  absl::string_view xmp;
+  if (LocateJpegXmp(image, &xmp).ok()) {
+    absl::Status status = ReadXmlFromMemory(xmp, &xml_doc);
+    if (status.ok()) {
+      return xml_doc;
+    }
+    if (status.code() == absl::StatusCode::kResourceExhausted) {
+      return nullptr;
+    }
+  }
+
   xmpmeta::XmpData xmp_data;
 
-  if (!xmpmeta::ReadXmpFromMemory(image, true, &xmp_data)) {
+  // Only the header is copied for xmpmeta, not the entropy coded image data.
+  size_t header_length = GetHeaderLength(image);
+  if (!CheckXmlLength(header_length).ok() ||
+      !xmpmeta::ReadXmpFromMemory(std::string(image.substr(0, header_length)),
+                                  true, &xmp_data)) {
     return nullptr;
   }
 
   // Here we take responsibility of freeing the xmlDoc.
-  auto xml_doc =
-      std::unique_ptr<xmlDoc, LibXmlDeleter>(xmp_data.StandardSection());
+  xml_doc.reset(xmp_data.StandardSection());
   *xmp_data.MutableStandardSection() = nullptr;
   return xml_doc;
 }
 
+std::unique_ptr<xmlDoc, LibXmlDeleter> JpegXmpIOHelper::GetXmp(
+    ByteSource *source) {
+  std::string scratch;
+  absl::string_view xmp;
+  if (!ReadXmpPacket(source, &scratch, &xmp).ok()) {
+    return nullptr;
+  }
+
+  return ReadXmlFromMemory(xmp);
+}
+
+absl::Status JpegXmpIOHelper::ReadXmpPacket(ByteSource *source,
+                                            std::string *scratch,
+                                            absl::string_view *xmp) {
+  // The segments are walked within the prefix, and past it only as far as
+  // their headers and any xmp segment need to be read.
+  uint64_t size = source->Size();
+  std::string prefix_scratch;
+  absl::string_view prefix;
+  RETURN_IF_ERROR(
+      source->ReadPrefix(kPrefixReadSize, &prefix_scratch, &prefix));
+
+  std::string window_scratch;
+  absl::string_view window = prefix;
+  uint64_t window_offset = 0;
+  uint64_t position = 0;
+  while (true) {
+    size_t required_length;
+    absl::Status status = WalkJpegSegments(
+        window, window_offset, window_offset + window.length() == size,
+        &position, &required_length, xmp);
+    if (status.ok()) {
+      // The packet outlives the local buffers only if copied out of them.
+      if (IsViewOf(*xmp, prefix_scratch) || IsViewOf(*xmp, window_scratch)) {
+        scratch->assign(xmp->data(), xmp->length());
+        *xmp = *scratch;
+      }
+      return absl::OkStatus();
+    }
+    if (!absl::IsOutOfRange(status)) {
+      return status;
+    }
+
+    if (position > size) {
+      return absl::InvalidArgumentError("Invalid jpeg segment length");
+    }
+    window_offset = position;
+    RETURN_IF_ERROR(ReadAtWithPrefix(
+        source, prefix, window_offset,
+        std::min<uint64_t>(required_length, size - window_offset),
+        &window_scratch, &window));
+  }
+}
+
 absl::Status JpegXmpIOHelper::SetXmp(const xmlDoc &xml_doc,
                                      const std::string &image,
                                      std::string *updated_image) {
-  xmpmeta::XmpData xmp_data;
+  ImageEdit edit;
+  RETURN_IF_ERROR(GetXmpEdit(xml_doc, image, XmpWriteOptions(), &edit));
 
-  *xmp_data.MutableStandardSection() = const_cast<xmlDoc *>(&xml_doc);
+  // Built at its final size, copying each byte of the image once.
+  updated_image->clear();
+  updated_image->reserve(image.length() - edit.length +
+                         edit.replacement.length());
+  updated_image->append(image, 0, edit.offset);
+  updated_image->append(edit.replacement);
+  updated_image->append(image, edit.offset + edit.length, std::string::npos);
+  return absl::OkStatus();
+}
 
-  std::istringstream istream(image);
-  std::ostringstream ostream;
+absl::Status JpegXmpIOHelper::GetXmpEdit(const xmlDoc &xml_doc,
+                                         const absl::string_view image,
+                                         const XmpWriteOptions &options,
+                                         ImageEdit *edit) {
+  // The existing xmp segment is replaced in place, otherwise the new segment
+  // is inserted directly after the start of image marker.
+  absl::string_view xmp;
+  absl::Status status = LocateJpegXmp(image, &xmp);
+  if (status.ok()) {
+    if (options.in_place) {
+      // Only the packet is rewritten if the xmp fits within it.
+      edit->replacement.clear();
+      RETURN_IF_ERROR(AppendSerializedXmp(xml_doc, &edit->replacement));
+      if (PadXmpPacket(xml_doc, 0, xmp.length(), GetXpacketEnd(xmp),
+                       &edit->replacement)
+              .ok()) {
+        edit->offset = xmp.data() - image.data();
+        edit->length = xmp.length();
+        edit->in_place = true;
+        return absl::OkStatus();
+      }
+    }
 
-  if (!xmpmeta::AddXmpMetaToJpegStream(&istream, xmp_data, &ostream)) {
-    return absl::InternalError("Failed to write xmp metadata to jpeg stream");
+    size_t packet_start = kJpegSegmentHeaderSize + kJpegXmpSignatureSize;
+    edit->offset = xmp.data() - image.data() - packet_start;
+    edit->length = packet_start + xmp.length();
+  } else if (absl::IsNotFound(status)) {
+    edit->offset = kJpegStartOfImageSize;
+    edit->length = 0;
+  } else {
+    return status;
   }
 
-  // Take back ownership of the xmlDoc passed in to xmpmeta.
-  *xmp_data.MutableStandardSection() = nullptr;
+  std::string *segment = &edit->replacement;
+  segment->assign(kJpegSegmentHeaderSize, '\0');
+  segment->append(kJpegXmpSignature, kJpegXmpSignatureSize);
+  RETURN_IF_ERROR(AppendSerializedXmp(xml_doc, segment));
 
-  *updated_image = ostream.str();
+  // New packets are padded so later updates can be written in place, as far
+  // as the segment length allows.
+  if (options.in_place && segment->length() - 2 <= kJpegMaxSegmentLength) {
+    size_t packet_start = kJpegSegmentHeaderSize + kJpegXmpSignatureSize;
+    size_t packet_length = std::min(
+        segment->length() - packet_start + kXmpPaddingSize,
+        kJpegMaxSegmentLength + 2 - packet_start);
+    // The trailer may not fit, in which case the packet is left unpadded.
+    PadXmpPacket(xml_doc, packet_start, packet_length, kXpacketWritable,
+                 segment)
+        .IgnoreError();
+  }
+
+  size_t length = segment->length() - 2;
+  if (length > kJpegMaxSegmentLength) {
+    return absl::InvalidArgumentError("Xmp metadata is too large for a jpeg");
+  }
+  (*segment)[0] = kJpegMarkerPrefix;
+  (*segment)[1] = kJpegApp1Marker;
+  absl::big_endian::Store16(&(*segment)[2], static_cast<uint16_t>(length));
+  edit->in_place = false;
   return absl::OkStatus();
 }
 
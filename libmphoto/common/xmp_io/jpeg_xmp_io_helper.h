@@ -23,23 +23,41 @@
 #include "absl/status/status.h"
 #include "absl/strings/string_view.h"
 #include "libxml/tree.h"
+#include "libmphoto/common/byte_source.h"
 #include "libmphoto/common/xmp_io/xmp_io_helper.h"
 #include "libmphoto/common/xml/libxml_deleter.h"
 
 namespace libmphoto {
 
 // This class provides enables reading/writing xmp metadata for jpeg images.
-class JpegXmpIOHelper : public IXmpIOHelper {
+class JpegXmpIOHelper final : public IXmpIOHelper {
  public:
   // Finds and parses out the xmp metadata returning the xml doc. Returns
   // nullptr if not not found.
   virtual std::unique_ptr<xmlDoc, LibXmlDeleter> GetXmp(
-      const std::string &image);
+      const absl::string_view image);
+
+  // Finds and parses out the xmp metadata from a byte source, reading only
+  // the ranges needed to locate it. Returns nullptr if not found.
+  virtual std::unique_ptr<xmlDoc, LibXmlDeleter> GetXmp(ByteSource *source);
+
+  // Sets xmp to the raw xmp packet of a byte source, without parsing it. The
+  // packet is a view into bytes returned by the source where possible, and
+  // otherwise into scratch.
+  virtual absl::Status ReadXmpPacket(ByteSource *source, std::string *scratch,
+                                     absl::string_view *xmp);
 
   // Replaces the xmp metadata with the provided metadata.
   virtual absl::Status SetXmp(const xmlDoc &xml_doc, const std::string &image,
                               std::string *updated_image);
 
+  // Sets edit to the edit of image which replaces the xmp metadata with the
+  // provided metadata.
+  virtual absl::Status GetXmpEdit(const xmlDoc &xml_doc,
+                                  const absl::string_view image,
+                                  const XmpWriteOptions &options,
+                                  ImageEdit *edit);
+
   // Gets the mime type this xmp helper is implemented for.
   virtual MimeType GetMimeType();
 };
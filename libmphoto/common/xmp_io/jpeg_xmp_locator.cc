@@ -0,0 +1,212 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "libmphoto/common/xmp_io/jpeg_xmp_locator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "absl/base/internal/endian.h"
+#include "libmphoto/common/xmp_io/jpeg_constants.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace libmphoto {
+
+namespace {
+
+#if !defined(__SSE2__) && defined(__ARM_NEON)
+// Returns whether any byte of bytes is non zero. The across vector maximum is
+// only available on AArch64, so 32 bit ARM folds the halves pairwise.
+bool AnyByteSet(uint8x16_t bytes) {
+#if defined(__aarch64__)
+  return vmaxvq_u8(bytes) != 0;
+#else
+  uint8x8_t folded = vpmax_u8(vget_low_u8(bytes), vget_high_u8(bytes));
+  return vget_lane_u64(vreinterpret_u64_u8(folded), 0) != 0;
+#endif
+}
+#endif
+
+// Returns whether marker stands alone, without a length or payload.
+bool IsStandaloneMarker(char marker) {
+  // TEM, RST0-RST7, SOI and EOI.
+  return marker == '\x01' || (marker >= '\xD0' && marker <= '\xD9');
+}
+
+}  // namespace
+
+size_t ScanForByte(const absl::string_view data, size_t position, char byte,
+                   bool equal) {
+  const char *bytes = data.data();
+  size_t length = data.length();
+
+#if defined(__SSE2__)
+  const __m128i target = _mm_set1_epi8(byte);
+  for (; position + 16 <= length; position += 16) {
+    __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + position));
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, target));
+    if (!equal) {
+      mask ^= 0xFFFF;
+    }
+    if (mask) {
+      return position + __builtin_ctz(mask);
+    }
+  }
+#elif defined(__ARM_NEON)
+  const uint8x16_t target = vdupq_n_u8(static_cast<uint8_t>(byte));
+  for (; position + 16 <= length; position += 16) {
+    uint8x16_t matches = vceqq_u8(
+        vld1q_u8(reinterpret_cast<const uint8_t *>(bytes + position)), target);
+    if (!equal) {
+      matches = vmvnq_u8(matches);
+    }
+    if (AnyByteSet(matches)) {
+      break;
+    }
+  }
+#else
+  if (equal && position < length) {
+    const void *found = memchr(bytes + position, byte, length - position);
+    return found ? static_cast<const char *>(found) - bytes : length;
+  }
+#endif
+
+  for (; position < length; position++) {
+    if ((bytes[position] == byte) == equal) {
+      return position;
+    }
+  }
+  return length;
+}
+
+absl::Status LocateJpegXmp(const absl::string_view image,
+                           absl::string_view *xmp) {
+  uint64_t position = 0;
+  size_t required_length;
+  return WalkJpegSegments(image, 0, true, &position, &required_length, xmp);
+}
+
+absl::Status WalkJpegSegments(const absl::string_view data,
+                              uint64_t data_offset, bool complete,
+                              uint64_t *position, size_t *required_length,
+                              absl::string_view *xmp) {
+  size_t walk_position = *position - data_offset;
+  if (*position == 0) {
+    if (!complete && data.length() < kJpegStartOfImageSize) {
+      *required_length = kJpegStartOfImageSize + kJpegSegmentHeaderSize;
+      return absl::OutOfRangeError("Jpeg data ends before the first segment");
+    }
+    if (data.length() < kJpegStartOfImageSize ||
+        data[0] != kJpegMarkerPrefix || data[1] != kJpegStartOfImageMarker) {
+      return absl::InvalidArgumentError("Missing jpeg start of image marker");
+    }
+    walk_position = kJpegStartOfImageSize;
+  }
+
+  while (walk_position < data.length()) {
+    // Well formed files have a marker here, otherwise resynchronize on the
+    // next marker prefix.
+    size_t prefix_position =
+        ScanForByte(data, walk_position, kJpegMarkerPrefix, true);
+    // Markers can be preceded by any number of fill bytes.
+    size_t marker_position =
+        ScanForByte(data, prefix_position, kJpegMarkerPrefix, false);
+    if (marker_position >= data.length()) {
+      // A marker may follow the last fill byte.
+      walk_position =
+          prefix_position < data.length() ? data.length() - 1 : data.length();
+      break;
+    }
+
+    char marker = data[marker_position];
+    walk_position = marker_position + 1;
+    if (marker == '\x00' || IsStandaloneMarker(marker)) {
+      // A stuffed zero or a standalone marker has no payload.
+      if (marker == kJpegEndOfImageMarker) {
+        return absl::NotFoundError("No xmp found in jpeg");
+      }
+      continue;
+    }
+
+    if (marker == kJpegStartOfScanMarker) {
+      return absl::NotFoundError("No xmp found in jpeg");
+    }
+
+    size_t header_position = marker_position - 1;
+    if (data.length() - header_position < kJpegSegmentHeaderSize) {
+      if (complete) {
+        return absl::InvalidArgumentError("Truncated jpeg segment header");
+      }
+      *position = data_offset + header_position;
+      *required_length = kJpegSegmentHeaderSize;
+      return absl::OutOfRangeError("Jpeg data ends within a segment header");
+    }
+
+    uint16_t length = absl::big_endian::Load16(data.data() + walk_position);
+    if (length < 2) {
+      return absl::InvalidArgumentError("Invalid jpeg segment length");
+    }
+    size_t payload_position = header_position + kJpegSegmentHeaderSize;
+    size_t payload_length = length - 2u;
+
+    // The signature, or as much of it as data holds.
+    absl::string_view signature = data.substr(
+        payload_position, std::min(payload_length, kJpegXmpSignatureSize));
+    bool may_hold_xmp =
+        marker == kJpegApp1Marker && payload_length >= kJpegXmpSignatureSize &&
+        absl::string_view(kJpegXmpSignature, signature.length()) == signature;
+
+    if (length > data.length() - walk_position) {
+      if (complete) {
+        return absl::InvalidArgumentError("Invalid jpeg segment length");
+      }
+      if (may_hold_xmp) {
+        // The signature is read first, so that only an xmp segment is read
+        // whole.
+        *position = data_offset + header_position;
+        *required_length = signature.length() < kJpegXmpSignatureSize
+                               ? kJpegSegmentHeaderSize + kJpegXmpSignatureSize
+                               : 2 + length;
+        return absl::OutOfRangeError("Jpeg data ends within a segment");
+      }
+      walk_position += length;
+      break;
+    }
+
+    if (may_hold_xmp) {
+      *xmp = data.substr(payload_position + kJpegXmpSignatureSize,
+                         payload_length - kJpegXmpSignatureSize);
+      *position = data_offset + walk_position + length;
+      return absl::OkStatus();
+    }
+
+    walk_position += length;
+  }
+
+  if (complete) {
+    return absl::NotFoundError("No xmp found in jpeg");
+  }
+  *position = data_offset + walk_position;
+  *required_length = kJpegSegmentHeaderSize;
+  return absl::OutOfRangeError("Jpeg data ends before the start of scan");
+}
+
+}  // namespace libmphoto
@@ -0,0 +1,58 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBMPHOTO_COMMON_XMP_IO_JPEG_XMP_LOCATOR_H_
+#define LIBMPHOTO_COMMON_XMP_IO_JPEG_XMP_LOCATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+
+namespace libmphoto {
+
+// Finds the standard xmp packet of a jpeg, setting xmp to a view of it within
+// image. Segment headers are hopped using their lengths, stopping at the start
+// of scan, so the time taken does not depend on the entropy coded data. Fill
+// bytes and stray bytes between segments are scanned past with SIMD where
+// available. Returns a not found error if there is no xmp, or an invalid
+// argument error if the segments are malformed.
+absl::Status LocateJpegXmp(const absl::string_view image,
+                           absl::string_view *xmp);
+
+// Walks the segments of a jpeg as LocateJpegXmp does, over data, which holds
+// the bytes of the jpeg from data_offset. The walk starts at position, an
+// offset within the jpeg which is either 0, for the start of image marker, or
+// between segments. If complete is false, the jpeg continues past data, and
+// when a segment header, or a segment which may hold the xmp, runs past its
+// end, an out of range error is returned with position set to where the walk
+// resumes and required_length to the number of bytes needed from there. Other
+// segments running past the end are skipped without being read.
+absl::Status WalkJpegSegments(const absl::string_view data,
+                              uint64_t data_offset, bool complete,
+                              uint64_t *position, size_t *required_length,
+                              absl::string_view *xmp);
+
+// Returns the position of the first byte of data at or after position which
+// is (if equal is true) or is not (if equal is false) byte, or data.length()
+// if there is none.
+size_t ScanForByte(const absl::string_view data, size_t position, char byte,
+                   bool equal);
+
+}  // namespace libmphoto
+
+#endif  // LIBMPHOTO_COMMON_XMP_IO_JPEG_XMP_LOCATOR_H_
@@ -25,30 +25,48 @@
 
 namespace libmphoto {
 
-std::unique_ptr<IXmpIOHelper> GetXmpIOHelper(const std::string &image) {
+namespace {
+
+// The fields identifying the metadata format, indexing kFormatXPaths.
+enum FormatField { kMotionPhotoField = 0, kMicrovideoField, kFormatFieldCount };
+
+constexpr const char *kFormatXPaths[kFormatFieldCount] = {kMotionPhotoXPath,
+                                                          kMicrovideoXPath};
+
+}  // namespace
+
+IXmpIOHelper *GetXmpIOHelper(const absl::string_view image) {
+  static JpegXmpIOHelper *jpeg_xmp_io_helper = new JpegXmpIOHelper();
+  static HeicXmpIOHelper *heic_xmp_io_helper = new HeicXmpIOHelper();
+
   MimeType mime_type = GetStreamMimeType(image);
 
   if (mime_type == MimeType::kImageJpeg) {
-    return absl::make_unique<JpegXmpIOHelper>();
+    return jpeg_xmp_io_helper;
   }
 
   if (mime_type == MimeType::kImageHeic) {
-    return absl::make_unique<HeicXmpIOHelper>();
+    return heic_xmp_io_helper;
   }
 
   return nullptr;
 }
 
-MPhotoFormat GetMPhotoFormat(const xmlXPathContext &xpath_context) {
-  std::string value;
+MPhotoFormat GetMPhotoFormat(const xmlDoc &xml_doc) {
+  XmlFieldLookup lookup;
+  if (!FindXmlAttributes(kFormatXPaths, kFormatFieldCount, kNamespaces,
+                         xml_doc, &lookup)
+           .ok()) {
+    return MPhotoFormat::kNone;
+  }
 
-  if (GetXmlAttributeValue(kMotionPhotoXPath, xpath_context, &value).ok()) {
+  if (lookup.found & (1u << kMotionPhotoField)) {
     return MPhotoFormat::kMotionPhoto;
-  } else if (GetXmlAttributeValue(kMicrovideoXPath, xpath_context, &value)
-                 .ok()) {
+  } else if (lookup.found & (1u << kMicrovideoField)) {
     return MPhotoFormat::kMicrovideo;
   }
 
   return MPhotoFormat::kNone;
 }
+
 }  // namespace libmphoto
@@ -17,17 +17,29 @@
 #ifndef LIBMPHOTO_COMMON_XMP_IO_XMP_IO_HELPER_H_
 #define LIBMPHOTO_COMMON_XMP_IO_XMP_IO_HELPER_H_
 
+#include <cstddef>
 #include <memory>
 #include <string>
 
 #include "absl/status/status.h"
 #include "absl/strings/string_view.h"
 #include "libxml/tree.h"
+#include "libmphoto/common/byte_source.h"
+#include "libmphoto/common/image_edit.h"
 #include "libmphoto/common/xml/libxml_deleter.h"
 #include "libmphoto/common/mime_type.h"
 
 namespace libmphoto {
 
+// This struct holds the options controlling how xmp metadata is written.
+struct XmpWriteOptions {
+  // If true, xmp which fits within the existing xmp packet is written over
+  // it, taking up the whitespace padding which ends the packet, so only the
+  // packet bytes change and the image length is unchanged. Xmp which doesn't
+  // fit is written to a new packet, padded so later updates fit in place.
+  bool in_place = false;
+};
+
 // This interface provides a basic contract for reading/writing xmp metadata
 // to image streams. It's to be implemented for a specific format (ie. jpeg or
 // heic).
@@ -36,23 +48,45 @@ class IXmpIOHelper {
   // Finds and parses out the xmp metadata returning the xml doc. Returns
   // nullptr if not not found.
   virtual std::unique_ptr<xmlDoc, LibXmlDeleter> GetXmp(
-      const std::string &image) = 0;
+      const absl::string_view image) = 0;
+
+  // Finds and parses out the xmp metadata from a byte source, reading only
+  // the ranges needed to locate it. Returns nullptr if not found.
+  virtual std::unique_ptr<xmlDoc, LibXmlDeleter> GetXmp(ByteSource *source) = 0;
+
+  // Sets xmp to the raw xmp packet of a byte source, without parsing it. The
+  // packet is a view into bytes returned by the source where possible, and
+  // otherwise into scratch.
+  virtual absl::Status ReadXmpPacket(ByteSource *source, std::string *scratch,
+                                     absl::string_view *xmp) = 0;
 
   // Replaces the xmp metadata with the provided metadata.
   virtual absl::Status SetXmp(const xmlDoc &xml_doc, const std::string &image,
                               std::string *updated_image) = 0;
 
+  // Sets edit to the edit of image which replaces the xmp metadata with the
+  // provided metadata.
+  virtual absl::Status GetXmpEdit(const xmlDoc &xml_doc,
+                                  const absl::string_view image,
+                                  const XmpWriteOptions &options,
+                                  ImageEdit *edit) = 0;
+
   // Gets the mime type this xmp helper is implemented for.
   virtual MimeType GetMimeType() = 0;
 };
 
-// Returns the appropriate xmp helper for a given image stream.
-std::unique_ptr<IXmpIOHelper> GetXmpIOHelper(const std::string &image);
+// Returns the appropriate xmp helper for a given image stream, or nullptr if
+// the stream is neither a jpeg nor a heic. Helpers are stateless, so a shared
+// instance is returned rather than a new one, and must not be deleted. Calls
+// through the returned interface remain virtual, a single indirect call per
+// file which is negligible next to locating and parsing the xmp, and which
+// keeps one interface for the demuxer, remuxer and tests.
+IXmpIOHelper *GetXmpIOHelper(const absl::string_view image);
 
 enum class MPhotoFormat { kNone = 0, kMotionPhoto, kMicrovideo };
 
 // Returns the the MPhotoFormat for a given xmp metadata.
-MPhotoFormat GetMPhotoFormat(const xmlXPathContext &xpath_context);
+MPhotoFormat GetMPhotoFormat(const xmlDoc &xml_doc);
 
 }  // namespace libmphoto
 
@@ -14,18 +14,21 @@
 
 #include "libmphoto/demuxer/demuxer.h"
 
-#include <map>
+#include <algorithm>
 #include <tuple>
 #include <utility>
 
 #include "absl/strings/numbers.h"
-#include "absl/strings/ascii.h"
+#include "libmphoto/common/box_parser.h"
+#include "libmphoto/common/fd_io.h"
 #include "libmphoto/common/macros.h"
 #include "libmphoto/common/xmp_field_paths.h"
 #include "libmphoto/common/xml/libxml_deleter.h"
+#include "libmphoto/common/xml/xml_parser.h"
 #include "libmphoto/common/xml/xml_utils.h"
 #include "libmphoto/common/xmp_io/xmp_io_helper.h"
 #include "libmphoto/common/stream_parser.h"
+#include "libmphoto/demuxer/xmp_image_info_reader.h"
 
 namespace libmphoto {
 
@@ -40,104 +43,106 @@ const absl::Status kOutPtrIsNullError =
 const absl::Status kIncorrectTypeError =
     absl::InvalidArgumentError("Incorrect xml attribute type");
 
-const std::map<std::string, MimeType> kStringToMimeType = {
-    {"image/jpeg", MimeType::kImageJpeg},
-    {"image/jpg", MimeType::kImageJpeg},
-    {"image/heic", MimeType::kImageHeic},
-    {"video/mp4", MimeType::kVideoMp4}};
-
-MimeType GetMimeType(const std::string &input) {
-  std::string lower_case_input = absl::AsciiStrToLower(input);
-
-  if (kStringToMimeType.find(lower_case_input) != kStringToMimeType.end()) {
-    return kStringToMimeType.at(lower_case_input);
-  }
-
-  return MimeType::kUnknownMimeType;
+constexpr uint32_t kMpvdBoxType = FourCC("mpvd");
+
+// Largest chunk read from a byte source at once when writing a stream out.
+constexpr size_t kWriteChunkSize = 1 << 20;
+
+// The fields read from a document, indexing kImageInfoXPaths.
+enum ImageInfoField {
+  kMotionPhotoField = 0,
+  kMotionPhotoVersionField,
+  kMotionPhotoPresentationTimestampUsField,
+  kImageMimeTypeField,
+  kVideoMimeTypeField,
+  kVideoLengthField,
+  kStillPaddingField,
+  kMicrovideoField,
+  kMicrovideoVersionField,
+  kMicrovideoPresentationTimestampUsField,
+  kMicrovideoOffsetField,
+  kImageInfoFieldCount
+};
+
+constexpr const char *kImageInfoXPaths[kImageInfoFieldCount] = {
+    kMotionPhotoXPath,
+    kMotionPhotoVersionXPath,
+    kMotionPhotoPresentationTimestampUsXPath,
+    kImageMimeTypeXPath,
+    kVideoMimeTypeXPath,
+    kVideoLengthXPath,
+    kStillPaddingXPath,
+    kMicrovideoXPath,
+    kMicrovideoVersionXPath,
+    kMicrovideoPresentationTimestampUsXPath,
+    kMicrovideoOffsetXPath};
+
+bool HasField(const XmlFieldLookup &lookup, ImageInfoField field) {
+  return lookup.found & (1u << field);
 }
 
-absl::Status GetImageInfoFromMotionPhoto(const xmlXPathContext &xpath_context,
-                                         ImageInfo *image_info) {
-  std::string value;
-
+absl::Status GetMimeTypeField(const XmlFieldLookup &lookup,
+                              ImageInfoField field, MimeType *result) {
   RETURN_IF_ERROR(
-      GetXmlAttributeValue(kMotionPhotoXPath, xpath_context, &value));
-  if (!absl::SimpleAtoi(value, &image_info->motion_photo)) {
-    return kIncorrectTypeError;
-  }
+      CheckXmlFieldsFound(lookup, 1u << field, kImageInfoXPaths));
+  *result = GetMimeType(GetXmlAttributeValue(*lookup.attributes[field]));
+  return absl::OkStatus();
+}
 
+template <typename T>
+absl::Status GetIntegerField(const XmlFieldLookup &lookup,
+                             ImageInfoField field, T *result) {
   RETURN_IF_ERROR(
-      GetXmlAttributeValue(kMotionPhotoVersionXPath, xpath_context, &value));
-  if (!absl::SimpleAtoi(value, &image_info->motion_photo_version)) {
-    return kIncorrectTypeError;
-  }
-
-  RETURN_IF_ERROR(GetXmlAttributeValue(kMotionPhotoPresentationTimestampUsXPath,
-                                       xpath_context, &value));
-  if (!absl::SimpleAtoi(value,
-                        &image_info->motion_photo_presentation_timestamp_us)) {
+      CheckXmlFieldsFound(lookup, 1u << field, kImageInfoXPaths));
+  if (!absl::SimpleAtoi(GetXmlAttributeValue(*lookup.attributes[field]),
+                        result)) {
     return kIncorrectTypeError;
   }
+  return absl::OkStatus();
+}
 
+absl::Status GetImageInfoFromMotionPhoto(const XmlFieldLookup &lookup,
+                                         ImageInfo *image_info) {
   RETURN_IF_ERROR(
-      GetXmlAttributeValue(kImageMimeTypeXPath, xpath_context, &value));
-  image_info->still_mime_type = GetMimeType(value);
-
+      GetIntegerField(lookup, kMotionPhotoField, &image_info->motion_photo));
+  RETURN_IF_ERROR(GetIntegerField(lookup, kMotionPhotoVersionField,
+                                  &image_info->motion_photo_version));
   RETURN_IF_ERROR(
-      GetXmlAttributeValue(kVideoMimeTypeXPath, xpath_context, &value));
-  image_info->video_mime_type = GetMimeType(value);
-
+      GetIntegerField(lookup, kMotionPhotoPresentationTimestampUsField,
+                      &image_info->motion_photo_presentation_timestamp_us));
+  RETURN_IF_ERROR(GetMimeTypeField(lookup, kImageMimeTypeField,
+                                   &image_info->still_mime_type));
+  RETURN_IF_ERROR(GetMimeTypeField(lookup, kVideoMimeTypeField,
+                                   &image_info->video_mime_type));
   RETURN_IF_ERROR(
-      GetXmlAttributeValue(kVideoLengthXPath, xpath_context, &value));
-  if (!absl::SimpleAtoi(value, &image_info->video_length)) {
-    return kIncorrectTypeError;
-  }
+      GetIntegerField(lookup, kVideoLengthField, &image_info->video_length));
 
-  // Still padding is optional, attempt to parse to see if it is present,
-  // otherwise padding is 0.
-  if (GetXmlAttributeValue(kStillPaddingXPath, xpath_context, &value).ok()) {
-    if (!absl::SimpleAtoi(value, &image_info->still_padding)) {
-      return kIncorrectTypeError;
-    }
-  } else {
-    image_info->still_padding = 0;
+  // Still padding is optional, if it is not present padding is 0.
+  image_info->still_padding = 0;
+  if (HasField(lookup, kStillPaddingField)) {
+    RETURN_IF_ERROR(GetIntegerField(lookup, kStillPaddingField,
+                                    &image_info->still_padding));
   }
 
   return absl::OkStatus();
 }
 
-absl::Status GetImageInfoFromMicrovideo(const xmlXPathContext &xpath_context,
+absl::Status GetImageInfoFromMicrovideo(const XmlFieldLookup &lookup,
                                         ImageInfo *image_info) {
-  std::string value;
-
   RETURN_IF_ERROR(
-      GetXmlAttributeValue(kMicrovideoXPath, xpath_context, &value));
-  if (!absl::SimpleAtoi(value, &image_info->motion_photo)) {
-    return kIncorrectTypeError;
-  }
-
+      GetIntegerField(lookup, kMicrovideoField, &image_info->motion_photo));
+  RETURN_IF_ERROR(GetIntegerField(lookup, kMicrovideoVersionField,
+                                  &image_info->motion_photo_version));
   RETURN_IF_ERROR(
-      GetXmlAttributeValue(kMicrovideoVersionXPath, xpath_context, &value));
-  if (!absl::SimpleAtoi(value, &image_info->motion_photo_version)) {
-    return kIncorrectTypeError;
-  }
-
-  RETURN_IF_ERROR(GetXmlAttributeValue(kMicrovideoPresentationTimestampUsXPath,
-                                       xpath_context, &value));
-  if (!absl::SimpleAtoi(value,
-                        &image_info->motion_photo_presentation_timestamp_us)) {
-    return kIncorrectTypeError;
-  }
+      GetIntegerField(lookup, kMicrovideoPresentationTimestampUsField,
+                      &image_info->motion_photo_presentation_timestamp_us));
 
   // Image/Video Mime Type are as specified in Microvideo spec.
   image_info->still_mime_type = MimeType::kImageJpeg;
   image_info->video_mime_type = MimeType::kVideoMp4;
 
-  RETURN_IF_ERROR(
-      GetXmlAttributeValue(kMicrovideoOffsetXPath, xpath_context, &value));
-  if (!absl::SimpleAtoi(value, &image_info->video_length)) {
-    return kIncorrectTypeError;
-  }
+  RETURN_IF_ERROR(GetIntegerField(lookup, kMicrovideoOffsetField,
+                                  &image_info->video_length));
 
   // Microvideos do not have padding after the still.
   image_info->still_padding = 0;
@@ -145,44 +150,74 @@ absl::Status GetImageInfoFromMicrovideo(const xmlXPathContext &xpath_context,
   return absl::OkStatus();
 }
 
+// Reads the fields of both formats in a single walk of the document.
 absl::Status GetImageInfo(const xmlDoc &xml_doc, ImageInfo *image_info) {
-  auto xpath_context =
-      GetXPathContext(kNamespaces, const_cast<xmlDoc *>(&xml_doc));
-  if (!xpath_context) {
-    return kFailedXPathCreationError;
+  XmlFieldLookup lookup;
+  RETURN_IF_ERROR(FindXmlAttributes(kImageInfoXPaths, kImageInfoFieldCount,
+                                    kNamespaces, xml_doc, &lookup));
+
+  // Motion photo metadata takes precedence, as in GetMPhotoFormat.
+  if (HasField(lookup, kMotionPhotoField)) {
+    return GetImageInfoFromMotionPhoto(lookup, image_info);
+  } else if (HasField(lookup, kMicrovideoField)) {
+    return GetImageInfoFromMicrovideo(lookup, image_info);
   }
 
-  MPhotoFormat format = GetMPhotoFormat(*xpath_context);
+  return kInvalidMotionPhotoError;
+}
+
+absl::Status GetImageInfo(const absl::string_view xmp,
+                          const ParseLimits &limits, ImageInfo *image_info) {
+  // Packets are read in a single pass where possible. Those the reader does
+  // not handle, or whose fields are missing or malformed, are parsed into a
+  // document, which also produces the error to report.
+  absl::Status status = ReadImageInfoFromXmp(xmp, limits, image_info);
+  if (status.ok() || status.code() == absl::StatusCode::kResourceExhausted) {
+    return status;
+  }
 
-  if (format == MPhotoFormat::kMotionPhoto) {
-    return GetImageInfoFromMotionPhoto(*xpath_context, image_info);
-  } else if (format == MPhotoFormat::kMicrovideo) {
-    return GetImageInfoFromMicrovideo(*xpath_context, image_info);
+  std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc;
+  status = ReadXmlFromMemory(xmp, &xml_doc);
+  if (status.code() == absl::StatusCode::kResourceExhausted) {
+    return status;
+  }
+  if (!xml_doc) {
+    return absl::InvalidArgumentError("Failed to find and parse xmp data");
   }
 
-  return kInvalidMotionPhotoError;
+  *image_info = ImageInfo();
+  return GetImageInfo(*xml_doc, image_info);
 }
 
+// Validates the metadata against the motion photo length and the still
+// header, the checks which do not require reading the video.
 absl::Status ValidateImageInfo(const ImageInfo &image_info,
-                               const absl::string_view still,
-                               const absl::string_view video,
-                               const std::string &motion_photo) {
+                               const absl::string_view still_header,
+                               uint64_t motion_photo_length) {
   if (image_info.motion_photo != 1) {
     return absl::InvalidArgumentError(absl::StrFormat(
         "Motion Photo field set to %d, must be 1", image_info.motion_photo));
   }
 
-  if (image_info.video_length <= 0 ||
-      image_info.video_length * 1ul > motion_photo.length()) {
-    return absl::InvalidArgumentError("Video length is invalid: " +
-                                      image_info.video_length);
+  if (image_info.video_length == 0 ||
+      image_info.video_length > motion_photo_length) {
+    return absl::InvalidArgumentError(absl::StrFormat(
+        "Video length is invalid: %u", image_info.video_length));
+  }
+
+  // Checked against the bytes left after the video, as the sum of the video
+  // length and still padding may overflow.
+  if (image_info.still_padding >
+      motion_photo_length - image_info.video_length) {
+    return absl::InvalidArgumentError(absl::StrFormat(
+        "Still padding is invalid: %u", image_info.still_padding));
   }
 
   if (image_info.still_mime_type == MimeType::kUnknownMimeType) {
     return absl::InvalidArgumentError("Invalid image mime type");
   }
 
-  if (image_info.still_mime_type != GetStreamMimeType(still)) {
+  if (image_info.still_mime_type != GetStreamMimeType(still_header)) {
     return absl::InvalidArgumentError(
         "Metadata specified still mime type does not match actual still mime "
         "type");
@@ -192,7 +227,13 @@ absl::Status ValidateImageInfo(const ImageInfo &image_info,
     return absl::InvalidArgumentError("Invalid video mime type");
   }
 
-  if (image_info.video_mime_type != GetStreamMimeType(video)) {
+  return absl::OkStatus();
+}
+
+// Validates the metadata specified video mime type against the video header.
+absl::Status ValidateVideoHeader(const ImageInfo &image_info,
+                                 const absl::string_view video_header) {
+  if (image_info.video_mime_type != GetStreamMimeType(video_header)) {
     return absl::InvalidArgumentError(
         "Metadata specified video mime type does not match actual video mime "
         "type");
@@ -201,30 +242,357 @@ absl::Status ValidateImageInfo(const ImageInfo &image_info,
   return absl::OkStatus();
 }
 
+// This struct holds the position of an mpvd box within a motion photo.
+struct MpvdBox {
+  uint64_t offset;
+  uint64_t header_size;
+  uint64_t size;
+};
+
+// Finds the top level mpvd box, reading only the headers of the boxes before
+// it.
+absl::Status FindMpvdBox(ByteSource *source, MpvdBox *mpvd_box) {
+  uint64_t size = source->Size();
+  std::string scratch;
+  uint64_t offset = 0;
+  while (offset < size) {
+    absl::string_view header_data;
+    BoxHeader header;
+    RETURN_IF_ERROR(source->ReadAt(
+        offset, std::min<uint64_t>(size - offset, kLargeBoxHeaderSize),
+        &scratch, &header_data));
+    RETURN_IF_ERROR(ParseBoxHeader(header_data, size - offset, &header));
+
+    if (header.type == kMpvdBoxType) {
+      mpvd_box->offset = offset;
+      mpvd_box->header_size = header.header_size;
+      mpvd_box->size = header.size;
+      return absl::OkStatus();
+    }
+
+    offset += header.size;
+  }
+
+  return absl::NotFoundError("No mpvd box found");
+}
+
+// Sets image_info to what an mpvd box records of a heic motion photo, for
+// when its xmp is missing. The presentation timestamp is unknown.
+void GetImageInfo(const MpvdBox &mpvd_box, ImageInfo *image_info) {
+  *image_info = ImageInfo();
+  image_info->motion_photo = 1;
+  image_info->motion_photo_version = 1;
+  image_info->motion_photo_presentation_timestamp_us = -1;
+  image_info->still_mime_type = MimeType::kImageHeic;
+  image_info->video_mime_type = MimeType::kVideoMp4;
+  image_info->video_length = mpvd_box.size - mpvd_box.header_size;
+  image_info->still_padding = mpvd_box.header_size;
+}
+
+// Checks the video and padding the xmp describes are the payload and header
+// of the mpvd box, which must end the motion photo.
+absl::Status ValidateMpvdBox(const MpvdBox &mpvd_box,
+                             const ImageInfo &image_info,
+                             uint64_t motion_photo_length) {
+  if (mpvd_box.offset + mpvd_box.size != motion_photo_length ||
+      mpvd_box.size - mpvd_box.header_size != image_info.video_length ||
+      mpvd_box.header_size != image_info.still_padding) {
+    return absl::DataLossError(absl::StrFormat(
+        "Xmp video length %u and padding %u do not match the mpvd box of %u "
+        "bytes at offset %u",
+        image_info.video_length, image_info.still_padding, mpvd_box.size,
+        mpvd_box.offset));
+  }
+
+  return absl::OkStatus();
+}
+
+// This class provides a byte source over the leading bytes of a file of a
+// known size. Reads past the prefix fail, and the furthest offset any read
+// needed is recorded so the caller can tell how many leading bytes parsing
+// required.
+class PrefixByteSource : public ByteSource {
+ public:
+  PrefixByteSource(const absl::string_view prefix, uint64_t size)
+      : prefix_(prefix), size_(size), required_length_(0) {}
+
+  virtual uint64_t Size() { return size_; }
+
+  virtual absl::Status ReadAt(uint64_t offset, size_t length,
+                              std::string *scratch,
+                              absl::string_view *result) {
+    if (offset > size_ || length > size_ - offset) {
+      return absl::OutOfRangeError("Read past the end of the file");
+    }
+
+    required_length_ = std::max(required_length_, offset + length);
+    if (offset + length > prefix_.length()) {
+      return absl::OutOfRangeError("Read past the end of the prefix");
+    }
+
+    *result = prefix_.substr(offset, length);
+    return absl::OkStatus();
+  }
+
+  // No prefix is prefetched, so that every range is read through ReadAt and
+  // recorded. Reads within the prefix are views, so this costs no copies.
+  virtual absl::Status ReadPrefix(size_t max_length, std::string *scratch,
+                                  absl::string_view *result) {
+    *result = absl::string_view();
+    return absl::OkStatus();
+  }
+
+  uint64_t required_length() const { return required_length_; }
+
+ private:
+  absl::string_view prefix_;
+  uint64_t size_;
+  uint64_t required_length_;
+};
+
 }  // namespace
 
 Demuxer::Demuxer() = default;
 
+Demuxer::Demuxer(const DemuxerOptions &options) : options_(options) {}
+
 absl::Status Demuxer::Init(const absl::string_view motion_photo) {
-  motion_photo_ = std::string(motion_photo);
-  image_info_ = std::make_unique<ImageInfo>();
+  Reset();
+  motion_photo_buffer_.assign(motion_photo.data(), motion_photo.length());
+  return InitFromMemory(motion_photo_buffer_);
+}
 
-  std::unique_ptr<IXmpIOHelper> xmp_io_helper = GetXmpIOHelper(motion_photo_);
+absl::Status Demuxer::InitWithOwnership(std::string &&motion_photo) {
+  Reset();
+  motion_photo_buffer_ = std::move(motion_photo);
+  return InitFromMemory(motion_photo_buffer_);
+}
 
-  if (!xmp_io_helper) {
+absl::Status Demuxer::InitWithoutCopy(const absl::string_view motion_photo) {
+  Reset();
+  return InitFromMemory(motion_photo);
+}
+
+absl::Status Demuxer::InitFromFile(const std::string &path) {
+  Reset();
+  RETURN_IF_ERROR(MappedFile::Open(path, &mapped_file_));
+  return InitFromMemory(mapped_file_->data());
+}
+
+absl::Status Demuxer::InitFromSource(std::unique_ptr<ByteSource> source) {
+  Reset();
+  if (!source) {
+    return absl::InvalidArgumentError("Byte source is null");
+  }
+
+  owned_source_ = std::move(source);
+  source_ = owned_source_.get();
+  return InitInternal();
+}
+
+void Demuxer::Reset() {
+  motion_photo_buffer_.clear();
+  mapped_file_.reset();
+  motion_photo_ = absl::string_view();
+  memory_source_ = MemoryByteSource(absl::string_view());
+  owned_source_.reset();
+  source_ = nullptr;
+  still_scratch_.clear();
+  video_scratch_.clear();
+  xmp_scratch_.clear();
+  xmp_io_helper_ = nullptr;
+  parsed_ = false;
+  parse_status_ = absl::OkStatus();
+}
+
+absl::Status Demuxer::InitFromMemory(const absl::string_view motion_photo) {
+  motion_photo_ = motion_photo;
+  memory_source_ = MemoryByteSource(motion_photo_);
+  source_ = &memory_source_;
+  return InitInternal();
+}
+
+absl::Status Demuxer::InitInternal() {
+  // The leading bytes are read once, and serve the mime type sniff, the xmp
+  // and the header checks. A lazy init only reads enough to sniff the type,
+  // and the rest is read by the first parse.
+  RETURN_IF_ERROR(prefix_source_.Init(
+      source_, options_.lazy_init ? kMimeTypeSniffSize : kPrefixReadSize));
+  source_ = &prefix_source_;
+
+  xmp_io_helper_ =
+      GetXmpIOHelper(prefix_source_.prefix().substr(0, kMimeTypeSniffSize));
+
+  if (!xmp_io_helper_) {
     return absl::InvalidArgumentError("Failed to parse file as jpeg or heic");
   }
 
-  std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc =
-      xmp_io_helper->GetXmp(motion_photo_);
+  if (options_.lazy_init) {
+    return absl::OkStatus();
+  }
+
+  return EnsureParsed();
+}
 
-  if (!xml_doc) {
+absl::Status Demuxer::EnsureParsed() {
+  if (!xmp_io_helper_) {
+    return kDemuxerNotInitializedError;
+  }
+
+  if (!parsed_) {
+    parse_status_ = prefix_source_.ExtendPrefix(kPrefixReadSize);
+    if (parse_status_.ok()) {
+      parse_status_ = Parse();
+    }
+    parsed_ = true;
+  }
+
+  return parse_status_;
+}
+
+absl::Status Demuxer::CheckParsed() const {
+  if (!xmp_io_helper_) {
+    return kDemuxerNotInitializedError;
+  }
+
+  if (!parsed_) {
+    return absl::FailedPreconditionError(
+        "Xmp not yet parsed after a lazy init");
+  }
+
+  return parse_status_;
+}
+
+absl::Status Demuxer::CheckParsedInMemory() const {
+  RETURN_IF_ERROR(CheckParsed());
+
+  if (!motion_photo_.data()) {
+    return absl::FailedPreconditionError("Motion photo is not in memory");
+  }
+
+  return absl::OkStatus();
+}
+
+absl::Status Demuxer::Parse() {
+  absl::Status status = ParseXmp();
+
+  // Heic motion photos hold the video in an mpvd box, which is found from
+  // the box headers alone and checked against the xmp, or used in its place
+  // when allowed.
+  MpvdBox mpvd_box{};
+  bool found_mpvd_box =
+      xmp_io_helper_->GetMimeType() == MimeType::kImageHeic &&
+      FindMpvdBox(source_, &mpvd_box).ok();
+  if (!status.ok() && found_mpvd_box && options_.allow_missing_xmp &&
+      status.code() != absl::StatusCode::kResourceExhausted) {
+    GetImageInfo(mpvd_box, &image_info_);
+    status = absl::OkStatus();
+  }
+  RETURN_IF_ERROR(status);
+
+  absl::string_view header =
+      prefix_source_.prefix().substr(0, kMimeTypeSniffSize);
+  RETURN_IF_ERROR(ValidateImageInfo(image_info_, header, source_->Size()));
+  if (found_mpvd_box) {
+    RETURN_IF_ERROR(ValidateMpvdBox(mpvd_box, image_info_, source_->Size()));
+  }
+
+  std::string video_header_scratch;
+  absl::string_view video_header;
+  RETURN_IF_ERROR(
+      ReadVideo(kMimeTypeSniffSize, &video_header_scratch, &video_header));
+  RETURN_IF_ERROR(ValidateVideoHeader(image_info_, video_header));
+
+  return absl::OkStatus();
+}
+
+absl::Status Demuxer::ParseXmp() {
+  ScopedXmlParserReuse xml_parser_reuse(options_.reuse_xml_parser);
+  ScopedXmlParseLimits parse_limits(options_.parse_limits);
+  image_info_ = ImageInfo();
+
+  // The fields are read from the xmp packet in a single pass where possible.
+  // Otherwise, bytes in memory are handed to the helper whole, and a byte
+  // source is read only in the ranges the helper needs, to parse the xmp into
+  // a document.
+  absl::string_view xmp;
+  absl::Status status =
+      xmp_io_helper_->ReadXmpPacket(source_, &xmp_scratch_, &xmp);
+  if (status.ok()) {
+    status = ReadImageInfoFromXmp(xmp, options_.parse_limits, &image_info_);
+  }
+  if (status.code() == absl::StatusCode::kResourceExhausted) {
+    return status;
+  }
+
+  if (!status.ok()) {
+    image_info_ = ImageInfo();
+    std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc =
+        motion_photo_.data() ? xmp_io_helper_->GetXmp(motion_photo_)
+                             : xmp_io_helper_->GetXmp(source_);
+
+    if (!xml_doc) {
+      RETURN_IF_ERROR(parse_limits.status());
+      return absl::InvalidArgumentError("Failed to find and parse xmp data");
+    }
+
+    RETURN_IF_ERROR(GetImageInfo(*xml_doc, &image_info_));
+  }
+
+  return absl::OkStatus();
+}
+
+absl::Status Demuxer::Probe(const absl::string_view prefix, uint64_t file_size,
+                            MotionPhotoLayout *layout) {
+  if (!layout) {
+    return kOutPtrIsNullError;
+  }
+
+  if (prefix.length() > file_size) {
+    return absl::InvalidArgumentError("Prefix is longer than the file");
+  }
+
+  *layout = MotionPhotoLayout();
+  layout->required_prefix_length =
+      std::min<uint64_t>(file_size, kMimeTypeHeaderSize);
+  if (prefix.length() < layout->required_prefix_length) {
+    return absl::OutOfRangeError("Prefix is too short to identify the file");
+  }
+
+  absl::string_view header = prefix.substr(0, kMimeTypeSniffSize);
+  IXmpIOHelper *xmp_io_helper = GetXmpIOHelper(header);
+
+  if (!xmp_io_helper) {
+    return absl::InvalidArgumentError("Failed to parse file as jpeg or heic");
+  }
+
+  PrefixByteSource prefix_source(prefix, file_size);
+  std::string xmp_scratch;
+  absl::string_view xmp;
+  absl::Status status =
+      xmp_io_helper->ReadXmpPacket(&prefix_source, &xmp_scratch, &xmp);
+  layout->required_prefix_length =
+      std::max<uint64_t>(header.length(), prefix_source.required_length());
+
+  if (!status.ok()) {
+    if (prefix_source.required_length() > prefix.length()) {
+      return absl::OutOfRangeError("Prefix is too short to find the xmp data");
+    }
     return absl::InvalidArgumentError("Failed to find and parse xmp data");
   }
 
-  RETURN_IF_ERROR(GetImageInfo(*xml_doc, image_info_.get()));
-  RETURN_IF_ERROR(ValidateImageInfo(*image_info_, GetStillStringView(),
-                                    GetVideoStringView(), motion_photo_));
+  ImageInfo *image_info = &layout->image_info;
+  ParseLimits limits;
+  ScopedXmlParseLimits parse_limits(limits);
+  RETURN_IF_ERROR(GetImageInfo(xmp, limits, image_info));
+  RETURN_IF_ERROR(ValidateImageInfo(*image_info, header, file_size));
+
+  layout->video_length = image_info->video_length;
+  layout->video_offset = file_size - layout->video_length;
+  layout->padding_length = image_info->still_padding;
+  layout->padding_offset = layout->video_offset - layout->padding_length;
+  layout->still_offset = 0;
+  layout->still_length = layout->padding_offset;
 
   return absl::OkStatus();
 }
@@ -234,11 +602,9 @@ absl::Status Demuxer::GetInfo(ImageInfo *image_info) {
     return kOutPtrIsNullError;
   }
 
-  if (!image_info_) {
-    return kDemuxerNotInitializedError;
-  }
+  RETURN_IF_ERROR(EnsureParsed());
 
-  *image_info = *image_info_;
+  *image_info = image_info_;
   return absl::OkStatus();
 }
 
@@ -247,11 +613,13 @@ absl::Status Demuxer::GetStill(std::string *still) {
     return kOutPtrIsNullError;
   }
 
-  if (!image_info_) {
-    return kDemuxerNotInitializedError;
-  }
+  RETURN_IF_ERROR(EnsureParsed());
 
-  *still = std::string(GetStillStringView());
+  absl::string_view still_view;
+  RETURN_IF_ERROR(ReadStill(UINT64_MAX, still, &still_view));
+  if (still_view.data() != still->data()) {
+    still->assign(still_view.data(), still_view.length());
+  }
   return absl::OkStatus();
 }
 
@@ -260,32 +628,167 @@ absl::Status Demuxer::GetVideo(std::string *video) {
     return kOutPtrIsNullError;
   }
 
-  if (!image_info_) {
-    return kDemuxerNotInitializedError;
+  RETURN_IF_ERROR(EnsureParsed());
+
+  absl::string_view video_view;
+  RETURN_IF_ERROR(ReadVideo(UINT64_MAX, video, &video_view));
+  if (video_view.data() != video->data()) {
+    video->assign(video_view.data(), video_view.length());
+  }
+  return absl::OkStatus();
+}
+
+absl::Status Demuxer::GetStillView(absl::string_view *still) {
+  if (!still) {
+    return kOutPtrIsNullError;
+  }
+
+  RETURN_IF_ERROR(EnsureParsed());
+
+  return ReadStill(UINT64_MAX, &still_scratch_, still);
+}
+
+absl::Status Demuxer::GetVideoView(absl::string_view *video) {
+  if (!video) {
+    return kOutPtrIsNullError;
   }
 
-  *video = std::string(GetVideoStringView());
+  RETURN_IF_ERROR(EnsureParsed());
+
+  return ReadVideo(UINT64_MAX, &video_scratch_, video);
+}
+
+absl::Status Demuxer::GetInfo(ImageInfo *image_info) const {
+  if (!image_info) {
+    return kOutPtrIsNullError;
+  }
+
+  RETURN_IF_ERROR(CheckParsed());
+
+  *image_info = image_info_;
+  return absl::OkStatus();
+}
+
+// The lengths are validated against the motion photo length when parsed, so
+// the views are in range.
+absl::Status Demuxer::GetStillView(absl::string_view *still) const {
+  if (!still) {
+    return kOutPtrIsNullError;
+  }
+
+  RETURN_IF_ERROR(CheckParsedInMemory());
+
+  *still = motion_photo_.substr(0, motion_photo_.length() -
+                                       image_info_.video_length -
+                                       image_info_.still_padding);
+  return absl::OkStatus();
+}
+
+absl::Status Demuxer::GetVideoView(absl::string_view *video) const {
+  if (!video) {
+    return kOutPtrIsNullError;
+  }
+
+  RETURN_IF_ERROR(CheckParsedInMemory());
+
+  *video =
+      motion_photo_.substr(motion_photo_.length() - image_info_.video_length);
   return absl::OkStatus();
 }
 
-absl::string_view Demuxer::GetStillStringView() {
-  if (!image_info_) {
-    return "";
+absl::Status Demuxer::GetStillTo(int fd) {
+  RETURN_IF_ERROR(EnsureParsed());
+
+  return WriteRange(0, GetStillLength(), fd);
+}
+
+absl::Status Demuxer::GetVideoTo(int fd) {
+  RETURN_IF_ERROR(EnsureParsed());
+
+  return WriteRange(GetVideoOffset(), image_info_.video_length, fd);
+}
+
+absl::Status Demuxer::GetStillTo(const ByteSink &sink) {
+  if (!sink) {
+    return kOutPtrIsNullError;
+  }
+
+  RETURN_IF_ERROR(EnsureParsed());
+
+  return WriteRange(0, GetStillLength(), sink);
+}
+
+absl::Status Demuxer::GetVideoTo(const ByteSink &sink) {
+  if (!sink) {
+    return kOutPtrIsNullError;
+  }
+
+  RETURN_IF_ERROR(EnsureParsed());
+
+  return WriteRange(GetVideoOffset(), image_info_.video_length, sink);
+}
+
+// The lengths are validated against the motion photo length on init, so the
+// subtractions do not underflow.
+uint64_t Demuxer::GetStillLength() {
+  return source_->Size() - image_info_.video_length -
+         image_info_.still_padding;
+}
+
+uint64_t Demuxer::GetVideoOffset() {
+  return source_->Size() - image_info_.video_length;
+}
+
+absl::Status Demuxer::ReadStill(uint64_t max_length, std::string *scratch,
+                                absl::string_view *still) {
+  return source_->ReadAt(0, std::min(GetStillLength(), max_length), scratch,
+                         still);
+}
+
+absl::Status Demuxer::ReadVideo(uint64_t max_length, std::string *scratch,
+                                absl::string_view *video) {
+  return source_->ReadAt(
+      GetVideoOffset(),
+      std::min<uint64_t>(image_info_.video_length, max_length), scratch,
+      video);
+}
+
+absl::Status Demuxer::WriteRange(uint64_t offset, uint64_t length, int fd) {
+  if (offset > source_->Size() || length > source_->Size() - offset) {
+    return kInvalidMotionPhotoError;
+  }
+
+  int source_fd = mapped_file_ ? mapped_file_->fd() : source_->fd();
+  if (source_fd >= 0) {
+    return CopyFdRange(source_fd, offset, length, fd);
   }
 
-  return absl::string_view(motion_photo_.data(),
-                           motion_photo_.length() - image_info_->video_length -
-                               image_info_->still_padding);
+  return WriteRange(offset, length, [fd](const absl::string_view bytes) {
+    return WriteToFd(fd, bytes);
+  });
 }
 
-absl::string_view Demuxer::GetVideoStringView() {
-  if (!image_info_) {
-    return "";
+absl::Status Demuxer::WriteRange(uint64_t offset, uint64_t length,
+                                 const ByteSink &sink) {
+  if (motion_photo_.data()) {
+    if (offset > motion_photo_.length() ||
+        length > motion_photo_.length() - offset) {
+      return kInvalidMotionPhotoError;
+    }
+    return sink(motion_photo_.substr(offset, length));
   }
 
-  return absl::string_view(
-      motion_photo_.data() + motion_photo_.length() - image_info_->video_length,
-      image_info_->video_length);
+  std::string scratch;
+  while (length > 0) {
+    absl::string_view chunk;
+    RETURN_IF_ERROR(source_->ReadAt(
+        offset, std::min<uint64_t>(length, kWriteChunkSize), &scratch, &chunk));
+    RETURN_IF_ERROR(sink(chunk));
+    offset += chunk.length();
+    length -= chunk.length();
+  }
+
+  return absl::OkStatus();
 }
 
 }  // namespace libmphoto
@@ -17,25 +17,93 @@
 #ifndef LIBMPHOTO_DEMUXER_DEMUXER_H_
 #define LIBMPHOTO_DEMUXER_DEMUXER_H_
 
+#include <cstdint>
 #include <memory>
 #include <string>
 
 #include "absl/status/status.h"
 #include "absl/strings/string_view.h"
+#include "libmphoto/common/byte_source.h"
+#include "libmphoto/common/mapped_file.h"
+#include "libmphoto/common/parse_limits.h"
 #include "libmphoto/demuxer/image_info.h"
+#include "libmphoto/demuxer/motion_photo_layout.h"
 
 namespace libmphoto {
 
+class IXmpIOHelper;
+
+// This struct holds the options controlling how a demuxer is initialized.
+struct DemuxerOptions {
+  // If true, Init only identifies the still container type, and the xmp is
+  // parsed and validated on first use. Init then succeeds for motion photos
+  // with invalid metadata, and the error is returned from the first accessor.
+  bool lazy_init = false;
+
+  // If true, xmp documents parsed on a thread reuse its parser context, see
+  // ScopedXmlParserReuse. The context is only trimmed when parsing finishes,
+  // so this suits threads which demux many files in turn.
+  bool reuse_xml_parser = false;
+
+  // The limits on the xmp parsed. Init fails with a resource exhausted error
+  // for xmp which exceeds them.
+  ParseLimits parse_limits;
+
+  // If true, a heic motion photo whose xmp is missing or damaged is demuxed
+  // using its mpvd box alone. Its image info then has an unset presentation
+  // timestamp.
+  bool allow_missing_xmp = false;
+};
+
 // This class provides functionality for information and encoded media stream
 // extraction from a motion photo. Init must first be called before any other
-// class functions can be called.
+// class functions can be called. Instances are thread compatible, and the
+// const accessors may be called concurrently on a demuxer shared across
+// threads, see libmphoto::Initialize.
 class Demuxer {
  public:
   Demuxer();
+  explicit Demuxer(const DemuxerOptions &options);
 
   // Initializes the demuxer with a string of bytes representing a motion photo.
   absl::Status Init(const absl::string_view motion_photo);
 
+  // Initializes the demuxer, taking ownership of the motion photo bytes so
+  // they are neither copied nor borrowed.
+  absl::Status InitWithOwnership(std::string &&motion_photo);
+
+  // Initializes the demuxer with a string of bytes representing a motion photo
+  // without copying them. The bytes are borrowed, and must outlive the demuxer
+  // or the next call to Init.
+  absl::Status InitWithoutCopy(const absl::string_view motion_photo);
+
+  // Initializes the demuxer with the motion photo file at path. The file is
+  // memory mapped rather than read, so only the pages which are accessed are
+  // read from disk. The file is unmapped when the demuxer is destroyed or
+  // reinitialized.
+  absl::Status InitFromFile(const std::string &path);
+
+  // Initializes the demuxer with a byte source over a motion photo. Only the
+  // ranges needed to locate the xmp and validate the streams are read during
+  // initialization, the still and video are read when requested.
+  absl::Status InitFromSource(std::unique_ptr<ByteSource> source);
+
+  // Returns the demuxer to its uninitialized state, releasing the motion
+  // photo. Buffers keep their capacity, so a demuxer reused across many files
+  // does not reallocate once warmed up. Init implies Reset.
+  void Reset();
+
+  // Sets layout to the metadata and stream byte ranges of a motion photo of
+  // file_size bytes, given only prefix, its leading bytes. If prefix is too
+  // short to hold the xmp, returns an out of range error with
+  // required_prefix_length set to the prefix length needed to progress, which
+  // may take more than one attempt for heic. On success it is set to the
+  // number of leading bytes the metadata was found in. The video mime type is
+  // not checked against the video as it lies outside the prefix. The xmp is
+  // held to the default ParseLimits.
+  static absl::Status Probe(const absl::string_view prefix, uint64_t file_size,
+                            MotionPhotoLayout *layout);
+
   // Sets image_info to the ImageInfo for the motion photo.
   absl::Status GetInfo(ImageInfo *image_info);
 
@@ -45,12 +113,102 @@ class Demuxer {
   // Sets video to the bytes of the video portion of the motion photo.
   absl::Status GetVideo(std::string *video);
 
+  // Sets still to a view of the still image portion of the motion photo. The
+  // view is valid for as long as the bytes the demuxer was initialized with.
+  // When initialized from a byte source, the still is read into the demuxer,
+  // and the view is valid until the demuxer is reinitialized.
+  absl::Status GetStillView(absl::string_view *still);
+
+  // Sets video to a view of the video portion of the motion photo. The view is
+  // valid for as long as the bytes the demuxer was initialized with. When
+  // initialized from a byte source, the video is read into the demuxer, and
+  // the view is valid until the demuxer is reinitialized.
+  absl::Status GetVideoView(absl::string_view *video);
+
+  // Const forms of GetInfo, GetStillView and GetVideoView, which read nothing
+  // and change no state, so a const Demuxer may be shared by many threads
+  // once Init has returned. They require the xmp to have been parsed, which a
+  // lazy init defers to the first non-const accessor, and return a failed
+  // precondition error otherwise. Views also require the motion photo to be
+  // in memory rather than behind a byte source.
+  absl::Status GetInfo(ImageInfo *image_info) const;
+  absl::Status GetStillView(absl::string_view *still) const;
+  absl::Status GetVideoView(absl::string_view *video) const;
+
+  // Writes the still image portion of the motion photo to the current
+  // position of fd. When initialized from a file, the bytes are copied within
+  // the kernel without passing through user space.
+  absl::Status GetStillTo(int fd);
+
+  // Writes the video portion of the motion photo to the current position of
+  // fd. When initialized from a file, the bytes are copied within the kernel
+  // without passing through user space.
+  absl::Status GetVideoTo(int fd);
+
+  // Passes the still image portion of the motion photo to sink. Bytes in
+  // memory are passed in a single chunk, otherwise they are read from the
+  // byte source in bounded chunks.
+  absl::Status GetStillTo(const ByteSink &sink);
+
+  // Passes the video portion of the motion photo to sink. Bytes in memory are
+  // passed in a single chunk, otherwise they are read from the byte source in
+  // bounded chunks.
+  absl::Status GetVideoTo(const ByteSink &sink);
+
  private:
-  std::string motion_photo_;
-  std::unique_ptr<ImageInfo> image_info_;
+  // Holds the motion photo bytes when they are copied or adopted by Init.
+  std::string motion_photo_buffer_;
+  // Holds the motion photo mapping when initialized from a file.
+  std::unique_ptr<MappedFile> mapped_file_;
+  // The motion photo bytes when they are in memory, otherwise empty.
+  absl::string_view motion_photo_;
+  // Reads the motion photo bytes when they are in memory.
+  MemoryByteSource memory_source_{absl::string_view()};
+  // Holds the byte source passed to InitFromSource.
+  std::unique_ptr<ByteSource> owned_source_;
+  // Caches the leading bytes of the motion photo, read once by Init.
+  PrefixCachingByteSource prefix_source_;
+  // The source all ranges of the motion photo are read from.
+  ByteSource *source_ = nullptr;
+  // Hold the still and video when read for views from a byte source.
+  std::string still_scratch_;
+  std::string video_scratch_;
+  // Holds the xmp packet when it is not a view into the motion photo.
+  std::string xmp_scratch_;
+  DemuxerOptions options_;
+  // The helper for the still container type, set once the type is identified.
+  IXmpIOHelper *xmp_io_helper_ = nullptr;
+  // Whether the xmp has been parsed and validated, and the result of doing so.
+  bool parsed_ = false;
+  absl::Status parse_status_;
+  ImageInfo image_info_;
+
+  absl::Status InitFromMemory(const absl::string_view motion_photo);
+  absl::Status InitInternal();
+
+  // Parses and validates the xmp on the first call, returning the cached
+  // result on later calls.
+  absl::Status EnsureParsed();
+  absl::Status Parse();
+  absl::Status ParseXmp();
+
+  // Returns the status the const accessors require, without parsing.
+  absl::Status CheckParsed() const;
+  absl::Status CheckParsedInMemory() const;
+
+  uint64_t GetStillLength();
+  uint64_t GetVideoOffset();
+
+  // Reads up to max_length bytes from the start of the still or video.
+  absl::Status ReadStill(uint64_t max_length, std::string *scratch,
+                         absl::string_view *still);
+  absl::Status ReadVideo(uint64_t max_length, std::string *scratch,
+                         absl::string_view *video);
 
-  absl::string_view GetStillStringView();
-  absl::string_view GetVideoStringView();
+  // Writes a range of the motion photo to a file descriptor or a sink.
+  absl::Status WriteRange(uint64_t offset, uint64_t length, int fd);
+  absl::Status WriteRange(uint64_t offset, uint64_t length,
+                          const ByteSink &sink);
 };
 
 }  // namespace libmphoto
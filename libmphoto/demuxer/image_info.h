@@ -46,10 +46,10 @@ struct ImageInfo {
   MimeType video_mime_type;
 
   // Byte length of the video container.
-  int video_length;
+  uint64_t video_length;
 
   // Byte length of padding after the still container.
-  int still_padding;
+  uint64_t still_padding;
 
   std::string toString() {
     return absl::StrFormat(
@@ -58,8 +58,8 @@ struct ImageInfo {
         "Motion Photo Presentation Timestamp Us: %lld\n"
         "Still Mime Type: %s\n"
         "Video Mime Type: %s\n"
-        "Video Length: %d\n"
-        "Still Padding: %d",
+        "Video Length: %u\n"
+        "Still Padding: %u",
         motion_photo, motion_photo_version,
         motion_photo_presentation_timestamp_us,
         kMimeTypeToString.at(still_mime_type),
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBMPHOTO_DEMUXER_MOTION_PHOTO_LAYOUT_H_
+#define LIBMPHOTO_DEMUXER_MOTION_PHOTO_LAYOUT_H_
+
+#include <cstdint>
+
+#include "libmphoto/demuxer/image_info.h"
+
+namespace libmphoto {
+
+// This struct holds the metadata information from a motion photo along with
+// the byte ranges of its still, padding and video within the file.
+struct MotionPhotoLayout {
+  ImageInfo image_info;
+
+  // Byte range of the still image container.
+  uint64_t still_offset;
+  uint64_t still_length;
+
+  // Byte range of the padding between the still and the video.
+  uint64_t padding_offset;
+  uint64_t padding_length;
+
+  // Byte range of the video container.
+  uint64_t video_offset;
+  uint64_t video_length;
+
+  // The number of leading bytes of the file needed to find the metadata. When
+  // probing fails as the provided prefix is too short, this is how long it
+  // must be for the next attempt to progress.
+  uint64_t required_prefix_length;
+};
+
+}  // namespace libmphoto
+
+#endif  // LIBMPHOTO_DEMUXER_MOTION_PHOTO_LAYOUT_H_
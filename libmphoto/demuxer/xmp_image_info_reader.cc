@@ -0,0 +1,297 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "libmphoto/demuxer/xmp_image_info_reader.h"
+
+#include <algorithm>
+
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
+#include "libmphoto/common/macros.h"
+#include "libmphoto/common/xml/xml_pull_parser.h"
+#include "libmphoto/common/xmp_field_paths.h"
+
+namespace libmphoto {
+
+namespace {
+
+const absl::Status kMissingFieldError =
+    absl::NotFoundError("Missing motion photo xmp field");
+const absl::Status kIncorrectTypeError =
+    absl::InvalidArgumentError("Incorrect xml attribute type");
+
+struct MimeTypeName {
+  const char *name;
+  MimeType mime_type;
+};
+
+constexpr MimeTypeName kMimeTypeNames[] = {
+    {"image/jpeg", MimeType::kImageJpeg},
+    {"image/jpg", MimeType::kImageJpeg},
+    {"image/heic", MimeType::kImageHeic},
+    {"video/mp4", MimeType::kVideoMp4}};
+
+struct PathElement {
+  const char *uri;
+  const char *local_name;
+};
+
+// The elements from the root to a container item, as in the item xpaths:
+// /x:xmpmeta/rdf:RDF/rdf:Description/Container:Directory/rdf:Seq/rdf:li/
+// Container:Item.
+constexpr PathElement kItemPath[] = {
+    {kXmpMetaNamespaceUri, "xmpmeta"},  {kRdfNamespaceUri, "RDF"},
+    {kRdfNamespaceUri, "Description"},  {kContainerNamespaceUri, "Directory"},
+    {kRdfNamespaceUri, "Seq"},          {kRdfNamespaceUri, "li"},
+    {kContainerNamespaceUri, "Item"}};
+
+constexpr int kDescriptionDepth = 3;
+constexpr int kSeqDepth = 5;
+constexpr int kListItemDepth = 6;
+constexpr int kItemDepth = 7;
+
+// The fields of a container item.
+struct ItemFields {
+  absl::string_view mime;
+  absl::string_view length;
+  absl::string_view padding;
+};
+
+// Views of the first value found for each field. A field which was not found
+// has a null view, as opposed to an empty one for an empty value.
+struct XmpFields {
+  absl::string_view motion_photo;
+  absl::string_view motion_photo_version;
+  absl::string_view motion_photo_presentation_timestamp_us;
+  absl::string_view microvideo;
+  absl::string_view microvideo_version;
+  absl::string_view microvideo_offset;
+  absl::string_view microvideo_presentation_timestamp_us;
+  // The items of the first and second list entries, the still and the video.
+  ItemFields items[2];
+};
+
+bool Matches(const XmlPullParser::Name &name, const char *uri,
+             const char *local_name) {
+  return name.uri == uri && name.local_name == local_name;
+}
+
+// Matches the xpaths, which select the first value in document order.
+void SetFirst(const absl::string_view value, absl::string_view *field) {
+  if (!field->data()) {
+    *field = value;
+  }
+}
+
+void ReadDescriptionFields(const XmlPullParser &parser, XmpFields *fields) {
+  for (size_t i = 0; i < parser.attribute_count(); i++) {
+    const XmlPullParser::Attribute &attribute = parser.attribute(i);
+    if (attribute.name.uri != kCameraNamespaceUri) {
+      continue;
+    }
+
+    const absl::string_view local_name = attribute.name.local_name;
+    if (local_name == "MotionPhoto") {
+      SetFirst(attribute.value, &fields->motion_photo);
+    } else if (local_name == "MotionPhotoVersion") {
+      SetFirst(attribute.value, &fields->motion_photo_version);
+    } else if (local_name == "MotionPhotoPresentationTimestampUs") {
+      SetFirst(attribute.value,
+               &fields->motion_photo_presentation_timestamp_us);
+    } else if (local_name == "MicroVideo") {
+      SetFirst(attribute.value, &fields->microvideo);
+    } else if (local_name == "MicroVideoVersion") {
+      SetFirst(attribute.value, &fields->microvideo_version);
+    } else if (local_name == "MicroVideoOffset") {
+      SetFirst(attribute.value, &fields->microvideo_offset);
+    } else if (local_name == "MicroVideoPresentationTimestampUs") {
+      SetFirst(attribute.value, &fields->microvideo_presentation_timestamp_us);
+    }
+  }
+}
+
+void ReadItemFields(const XmlPullParser &parser, ItemFields *fields) {
+  for (size_t i = 0; i < parser.attribute_count(); i++) {
+    const XmlPullParser::Attribute &attribute = parser.attribute(i);
+    if (attribute.name.uri != kItemNamespaceUri) {
+      continue;
+    }
+
+    const absl::string_view local_name = attribute.name.local_name;
+    if (local_name == "Mime") {
+      SetFirst(attribute.value, &fields->mime);
+    } else if (local_name == "Length") {
+      SetFirst(attribute.value, &fields->length);
+    } else if (local_name == "Padding") {
+      SetFirst(attribute.value, &fields->padding);
+    }
+  }
+}
+
+absl::Status ReadFields(const absl::string_view xmp, const ParseLimits &limits,
+                        XmpFields *fields) {
+  if (xmp.length() > limits.max_xmp_bytes) {
+    return absl::ResourceExhaustedError(
+        absl::StrFormat("Xmp of %u bytes exceeds the limit of %u bytes",
+                        xmp.length(), limits.max_xmp_bytes));
+  }
+
+  XmlPullParser parser(xmp);
+  XmlPullParser::Event event;
+  // The number of leading open elements which match the item path.
+  int matched_depth = 0;
+  // The position of the current list entry among those of its list.
+  int list_index = 0;
+
+  do {
+    RETURN_IF_ERROR(parser.Next(&event));
+    int depth = parser.depth();
+
+    if (event == XmlPullParser::Event::kStartElement) {
+      if (depth > limits.max_depth) {
+        return absl::ResourceExhaustedError(absl::StrFormat(
+            "Xmp nesting exceeds a depth of %d", limits.max_depth));
+      }
+      if (parser.attribute_count() >
+          static_cast<size_t>(limits.max_attributes)) {
+        return absl::ResourceExhaustedError(
+            absl::StrFormat("Xmp element has more than %d attributes",
+                            limits.max_attributes));
+      }
+    }
+
+    if (event == XmlPullParser::Event::kEndElement) {
+      matched_depth = std::min(matched_depth, depth - 1);
+    } else if (event == XmlPullParser::Event::kStartElement &&
+               matched_depth == depth - 1 && depth <= kItemDepth &&
+               Matches(parser.name(), kItemPath[depth - 1].uri,
+                       kItemPath[depth - 1].local_name)) {
+      matched_depth = depth;
+      if (depth == kDescriptionDepth) {
+        ReadDescriptionFields(parser, fields);
+      } else if (depth == kSeqDepth) {
+        list_index = 0;
+      } else if (depth == kListItemDepth) {
+        list_index++;
+      } else if (depth == kItemDepth && list_index <= 2) {
+        ReadItemFields(parser, &fields->items[list_index - 1]);
+      }
+    }
+  } while (event != XmlPullParser::Event::kEndDocument);
+
+  return absl::OkStatus();
+}
+
+bool HasField(const absl::string_view value) { return value.data(); }
+
+// Parses a required field. An empty value is present, as with the xpath
+// lookups, and fails to parse.
+template <typename T>
+absl::Status ParseField(const absl::string_view value, T *result) {
+  if (!HasField(value)) {
+    return kMissingFieldError;
+  }
+
+  if (!absl::SimpleAtoi(value, result)) {
+    return kIncorrectTypeError;
+  }
+
+  return absl::OkStatus();
+}
+
+absl::Status ParseMotionPhotoFields(const XmpFields &fields,
+                                    ImageInfo *image_info) {
+  RETURN_IF_ERROR(ParseField(fields.motion_photo, &image_info->motion_photo));
+  RETURN_IF_ERROR(ParseField(fields.motion_photo_version,
+                             &image_info->motion_photo_version));
+  RETURN_IF_ERROR(
+      ParseField(fields.motion_photo_presentation_timestamp_us,
+                 &image_info->motion_photo_presentation_timestamp_us));
+
+  const ItemFields &still = fields.items[0];
+  const ItemFields &video = fields.items[1];
+  if (!HasField(still.mime) || !HasField(video.mime)) {
+    return kMissingFieldError;
+  }
+  image_info->still_mime_type = GetMimeType(still.mime);
+  image_info->video_mime_type = GetMimeType(video.mime);
+
+  RETURN_IF_ERROR(ParseField(video.length, &image_info->video_length));
+
+  // Still padding is optional, and 0 if not present.
+  image_info->still_padding = 0;
+  if (HasField(still.padding)) {
+    RETURN_IF_ERROR(ParseField(still.padding, &image_info->still_padding));
+  }
+
+  return absl::OkStatus();
+}
+
+absl::Status ParseMicrovideoFields(const XmpFields &fields,
+                                   ImageInfo *image_info) {
+  RETURN_IF_ERROR(ParseField(fields.microvideo, &image_info->motion_photo));
+  RETURN_IF_ERROR(ParseField(fields.microvideo_version,
+                             &image_info->motion_photo_version));
+  RETURN_IF_ERROR(
+      ParseField(fields.microvideo_presentation_timestamp_us,
+                 &image_info->motion_photo_presentation_timestamp_us));
+
+  // Image/Video Mime Type are as specified in Microvideo spec.
+  image_info->still_mime_type = MimeType::kImageJpeg;
+  image_info->video_mime_type = MimeType::kVideoMp4;
+
+  RETURN_IF_ERROR(
+      ParseField(fields.microvideo_offset, &image_info->video_length));
+
+  // Microvideos do not have padding after the still.
+  image_info->still_padding = 0;
+
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+MimeType GetMimeType(const absl::string_view mime_type) {
+  for (const MimeTypeName &name : kMimeTypeNames) {
+    if (absl::EqualsIgnoreCase(mime_type, name.name)) {
+      return name.mime_type;
+    }
+  }
+
+  return MimeType::kUnknownMimeType;
+}
+
+absl::Status ReadImageInfoFromXmp(const absl::string_view xmp,
+                                  const ParseLimits &limits,
+                                  ImageInfo *image_info) {
+  XmpFields fields;
+  RETURN_IF_ERROR(ReadFields(xmp, limits, &fields));
+
+  if (HasField(fields.motion_photo)) {
+    return ParseMotionPhotoFields(fields, image_info);
+  } else if (HasField(fields.microvideo)) {
+    return ParseMicrovideoFields(fields, image_info);
+  }
+
+  return absl::NotFoundError("No motion photo or microvideo xmp fields");
+}
+
+absl::Status ReadImageInfoFromXmp(const absl::string_view xmp,
+                                  ImageInfo *image_info) {
+  return ReadImageInfoFromXmp(xmp, ParseLimits(), image_info);
+}
+
+}  // namespace libmphoto
@@ -0,0 +1,48 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBMPHOTO_DEMUXER_XMP_IMAGE_INFO_READER_H_
+#define LIBMPHOTO_DEMUXER_XMP_IMAGE_INFO_READER_H_
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "libmphoto/common/mime_type.h"
+#include "libmphoto/common/xml/xml_parser.h"
+#include "libmphoto/demuxer/image_info.h"
+
+namespace libmphoto {
+
+// Returns the mime type named by a metadata mime type field, ignoring case.
+MimeType GetMimeType(const absl::string_view mime_type);
+
+// Sets image_info to the motion photo or microvideo fields of an xmp packet,
+// read in a single pass without building a document or allocating. The fields
+// are matched as the xpaths of xmp_field_paths.h would match them. Returns an
+// error if the fields are missing or malformed, or if the packet uses xml the
+// reader does not support, in which case the packet should be parsed into a
+// document to find the fields or the error. Xmp which exceeds limits is
+// rejected with a resource exhausted error, and should not be parsed further.
+absl::Status ReadImageInfoFromXmp(const absl::string_view xmp,
+                                  const ParseLimits &limits,
+                                  ImageInfo *image_info);
+
+// As above, with the default limits.
+absl::Status ReadImageInfoFromXmp(const absl::string_view xmp,
+                                  ImageInfo *image_info);
+
+}  // namespace libmphoto
+
+#endif  // LIBMPHOTO_DEMUXER_XMP_IMAGE_INFO_READER_H_
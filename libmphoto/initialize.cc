@@ -0,0 +1,40 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "libmphoto/initialize.h"
+
+#include <mutex>
+
+#include "libheif/heif.h"
+#include "libxml/parser.h"
+
+namespace libmphoto {
+
+void Initialize() {
+  static std::once_flag once;
+  std::call_once(once, [] {
+    xmlInitParser();
+
+    // Earlier libheif versions register their plugins during static
+    // initialization and need no setup.
+#ifdef LIBHEIF_HAVE_VERSION
+#if LIBHEIF_HAVE_VERSION(1, 13, 0)
+    heif_init(nullptr);
+#endif
+#endif
+  });
+}
+
+}  // namespace libmphoto
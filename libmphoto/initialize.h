@@ -0,0 +1,34 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBMPHOTO_INITIALIZE_H_
+#define LIBMPHOTO_INITIALIZE_H_
+
+namespace libmphoto {
+
+// Performs the one time global setup of the libraries libmphoto parses with.
+// It should be called before demuxers or remuxers are used from more than
+// one thread, as libxml otherwise initializes itself on first use. Calling it
+// again, from any thread, has no effect.
+//
+// Demuxer and Remuxer instances are thread compatible: distinct instances may
+// be used concurrently, and a demuxer may be shared as a const Demuxer once
+// Init has returned, see Demuxer::GetStillView.
+void Initialize();
+
+}  // namespace libmphoto
+
+#endif  // LIBMPHOTO_INITIALIZE_H_
@@ -14,11 +14,17 @@
 
 #include "libmphoto/remuxer/remuxer.h"
 
-#include <sstream>
+#include <unistd.h>
 
-#include "absl/base/internal/endian.h"
+#include <algorithm>
+#include <utility>
+
+#include "libmphoto/common/box_parser.h"
+#include "libmphoto/common/fd_io.h"
 #include "libmphoto/common/xmp_field_paths.h"
+#include "libmphoto/common/xml/xml_parser.h"
 #include "libmphoto/common/xml/xml_utils.h"
+#include "libmphoto/common/xmp_io/xmp_io_helper.h"
 #include "libmphoto/common/macros.h"
 #include "libmphoto/common/stream_parser.h"
 
@@ -26,6 +32,12 @@ namespace libmphoto {
 
 namespace {
 
+const absl::Status kInvalidVideoError =
+    absl::InvalidArgumentError("Video cannot be parsed as an mp4");
+
+// Largest chunk read from a video source at once.
+constexpr size_t kVideoChunkSize = 1 << 20;
+
 constexpr char kDefaultXmp[] =
     "<x:xmpmeta\n"
     "  xmlns:x=\"adobe:ns:meta/\"\n"
@@ -37,6 +49,51 @@ constexpr char kDefaultXmp[] =
 
 constexpr char kXmpRootXPath[] = "/x:xmpmeta/rdf:RDF[1]";
 
+constexpr char kPrimaryItemXPath[] =
+    "/x:xmpmeta/rdf:RDF/rdf:Description/Container:Directory/rdf:Seq/rdf:li[1]/"
+    "Container:Item";
+
+// Most digits of a padding length written in the xmp.
+constexpr size_t kMaxPaddingDigits = 20;
+
+// Written in place of the video length while the video is streamed, so it
+// can be found in the serialized xmp. It is as wide as the longest length,
+// which is then written over it zero padded.
+constexpr char kVideoLengthPlaceholder[] = "MPHOTOVIDEOLENGTH___";
+constexpr size_t kVideoLengthWidth = sizeof(kVideoLengthPlaceholder) - 1;
+static_assert(kVideoLengthWidth == 20, "Placeholder must fit any length");
+
+// The motion photo fields written, indexing kMotionPhotoXPaths.
+enum MotionPhotoField {
+  kMotionPhotoField = 0,
+  kMotionPhotoVersionField,
+  kMotionPhotoPresentationTimestampUsField,
+  kImageMimeTypeField,
+  kVideoMimeTypeField,
+  kVideoLengthField,
+  kStillPaddingField,
+  kMotionPhotoFieldCount
+};
+
+constexpr const char *kMotionPhotoXPaths[kMotionPhotoFieldCount] = {
+    kMotionPhotoXPath,   kMotionPhotoVersionXPath,
+    kMotionPhotoPresentationTimestampUsXPath,
+    kImageMimeTypeXPath, kVideoMimeTypeXPath,
+    kVideoLengthXPath,   kStillPaddingXPath};
+
+// The microvideo fields written, indexing kMicrovideoXPaths.
+enum MicrovideoField {
+  kMicrovideoField = 0,
+  kMicrovideoVersionField,
+  kMicrovideoPresentationTimestampUsField,
+  kMicrovideoOffsetField,
+  kMicrovideoFieldCount
+};
+
+constexpr const char *kMicrovideoXPaths[kMicrovideoFieldCount] = {
+    kMicrovideoXPath, kMicrovideoVersionXPath,
+    kMicrovideoPresentationTimestampUsXPath, kMicrovideoOffsetXPath};
+
 constexpr char kDefaultXmpMotionPhotoItem[] =
     "<rdf:RDF\n"
     "  xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\">\n"
@@ -67,7 +124,7 @@ constexpr char kDefaultXmpMotionPhotoItem[] =
     "    </rdf:Description>\n"
     "</rdf:RDF>\n";
 
-absl::Status MergeXmpItemIntoXmlDoc(const std::string &xmp_item,
+absl::Status MergeXmpItemIntoXmlDoc(const absl::string_view xmp_item,
                                     xmlDoc *xml_doc) {
   auto xpath_context = GetXPathContext(kNamespaces, xml_doc);
   if (!xpath_context) {
@@ -77,8 +134,8 @@ absl::Status MergeXmpItemIntoXmlDoc(const std::string &xmp_item,
   xmlNode *xmp_root;
   RETURN_IF_ERROR(GetXmlNode(kXmpRootXPath, *xpath_context, &xmp_root));
 
-  std::unique_ptr<xmlDoc, LibXmlDeleter> new_xmp_item_doc(
-      xmlReadMemory(xmp_item.data(), xmp_item.length(), ".xml", nullptr, 0));
+  std::unique_ptr<xmlDoc, LibXmlDeleter> new_xmp_item_doc =
+      ReadXmlFromMemory(xmp_item);
 
   // Copy is owned by xml_doc.
   xmlNode *new_xmp_item_node =
@@ -96,8 +153,8 @@ absl::Status MergeXmpItemIntoXmlDoc(const std::string &xmp_item,
 }
 
 std::unique_ptr<xmlDoc, LibXmlDeleter> GetDefaultXmp() {
-  std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc(
-      xmlReadMemory(kDefaultXmp, strlen(kDefaultXmp), ".xml", nullptr, 0));
+  std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc =
+      ReadXmlFromMemory(kDefaultXmp);
 
   if (!MergeXmpItemIntoXmlDoc(kDefaultXmpMotionPhotoItem, xml_doc.get()).ok()) {
     return nullptr;
@@ -106,29 +163,44 @@ std::unique_ptr<xmlDoc, LibXmlDeleter> GetDefaultXmp() {
   return xml_doc;
 }
 
-constexpr char kMpvdBoxName[] = "mpvd";
-
-absl::Status GetHeicStillPadding(const int video_length,
-                                 std::string *still_padding) {
-  std::stringstream ss;
-  uint32_t large_signal = 1;
-  char large_signal_big_endian[4];
+// Adds a zero Item:Padding attribute to the primary item, setting attribute
+// to it.
+absl::Status AddStillPaddingAttribute(xmlDoc *xml_doc, xmlAttr **attribute) {
+  auto xpath_context = GetXPathContext(kNamespaces, xml_doc);
+  if (!xpath_context) {
+    return kFailedXPathCreationError;
+  }
 
-  absl::big_endian::Store32(large_signal_big_endian, large_signal);
-  ss.write(large_signal_big_endian, sizeof(large_signal_big_endian));
+  xmlNode *primary_item;
+  RETURN_IF_ERROR(
+      GetXmlNode(kPrimaryItemXPath, *xpath_context, &primary_item));
 
-  ss.write(kMpvdBoxName, sizeof(kMpvdBoxName));
+  xmlNs *item_namespace = xmlSearchNsByHref(
+      xml_doc, primary_item,
+      reinterpret_cast<const xmlChar *>(kItemNamespaceUri));
+  if (!item_namespace) {
+    return absl::InvalidArgumentError("Primary item namespace not declared");
+  }
 
-  char mpvd_box_length_big_endian[8];
-  uint64_t mpvd_box_length = sizeof(large_signal_big_endian) +
-                             sizeof(kMpvdBoxName) +
-                             sizeof(mpvd_box_length_big_endian) + video_length;
+  *attribute = xmlSetNsProp(primary_item, item_namespace,
+                            reinterpret_cast<const xmlChar *>("Padding"),
+                            reinterpret_cast<const xmlChar *>("0"));
+  if (!*attribute) {
+    return absl::InternalError("Failed to add still padding");
+  }
 
-  absl::big_endian::Store64(mpvd_box_length_big_endian, mpvd_box_length);
+  return absl::OkStatus();
+}
 
-  ss.write(mpvd_box_length_big_endian, sizeof(mpvd_box_length_big_endian));
+constexpr uint32_t kMpvdBoxType = FourCC("mpvd");
 
-  *still_padding = ss.str();
+// The mpvd box holding the video of a heic motion photo follows the still,
+// with a large size so the video may exceed 4GB.
+absl::Status GetHeicStillPadding(const uint64_t video_length,
+                                 std::string *still_padding) {
+  if (!WriteLargeBoxHeader(kMpvdBoxType, video_length, still_padding).ok()) {
+    return absl::InvalidArgumentError("Video is too long for an mpvd box");
+  }
   return absl::OkStatus();
 }
 
@@ -136,9 +208,17 @@ absl::Status GetHeicStillPadding(const int video_length,
 
 Remuxer::Remuxer() = default;
 
+Remuxer::Remuxer(const RemuxerOptions &options) : options_(options) {}
+
 absl::Status Remuxer::SetStill(const absl::string_view still,
                                int presentation_timestamp_us) {
-  still_ = std::string(still);
+  still_buffer_.assign(still.data(), still.length());
+  return SetStillWithoutCopy(still_buffer_, presentation_timestamp_us);
+}
+
+absl::Status Remuxer::SetStillWithoutCopy(const absl::string_view still,
+                                          int presentation_timestamp_us) {
+  still_ = still;
   presentation_timestamp_us_ = presentation_timestamp_us;
   xmp_io_helper_ = GetXmpIOHelper(still_);
 
@@ -152,86 +232,384 @@ absl::Status Remuxer::SetStill(const absl::string_view still,
 
 absl::Status Remuxer::SetVideo(const absl::string_view video) {
   if (GetStreamMimeType(video) != MimeType::kVideoMp4) {
-    return absl::InvalidArgumentError("Video cannot be parsed as an mp4");
+    return kInvalidVideoError;
+  }
+  video_buffer_.assign(video.data(), video.length());
+  video_ = video_buffer_;
+  video_source_.reset();
+
+  return absl::OkStatus();
+}
+
+absl::Status Remuxer::SetVideoWithoutCopy(const absl::string_view video) {
+  if (GetStreamMimeType(video) != MimeType::kVideoMp4) {
+    return kInvalidVideoError;
+  }
+  video_ = video;
+  video_source_.reset();
+
+  return absl::OkStatus();
+}
+
+absl::Status Remuxer::SetVideoFromFile(const std::string &path) {
+  std::unique_ptr<FileByteSource> file_source;
+  RETURN_IF_ERROR(FileByteSource::Open(path, &file_source));
+  return SetVideoFromSource(std::move(file_source));
+}
+
+absl::Status Remuxer::SetVideoFromFd(int fd) {
+  std::unique_ptr<FileByteSource> file_source;
+  RETURN_IF_ERROR(FileByteSource::FromFd(fd, &file_source));
+  return SetVideoFromSource(std::move(file_source));
+}
+
+absl::Status Remuxer::SetVideoFromSource(std::unique_ptr<ByteSource> source) {
+  if (!source) {
+    return absl::InvalidArgumentError("Video source is null");
   }
-  video_ = std::string(video);
+
+  std::string header_scratch;
+  absl::string_view header;
+  RETURN_IF_ERROR(source->ReadAt(
+      0, std::min<uint64_t>(source->Size(), kMimeTypeSniffSize),
+      &header_scratch, &header));
+  if (GetStreamMimeType(header) != MimeType::kVideoMp4) {
+    return kInvalidVideoError;
+  }
+
+  video_buffer_.clear();
+  video_ = absl::string_view();
+  video_source_ = std::move(source);
 
   return absl::OkStatus();
 }
 
 absl::Status Remuxer::Finalize(std::string *motion_photo) {
-  if (still_.empty() || video_.empty()) {
+  std::vector<absl::string_view> segments;
+  RETURN_IF_ERROR(FinalizeStill(0, 0, &segments));
+  if (!video_source_) {
+    segments.push_back(video_);
+  }
+
+  uint64_t length = video_source_ ? video_source_->Size() : 0;
+  for (absl::string_view segment : segments) {
+    length += segment.length();
+  }
+
+  motion_photo->clear();
+  motion_photo->reserve(length);
+  for (absl::string_view segment : segments) {
+    motion_photo->append(segment.data(), segment.length());
+  }
+
+  if (video_source_) {
+    return GetVideoSourceTo([motion_photo](const absl::string_view bytes) {
+      motion_photo->append(bytes.data(), bytes.length());
+      return absl::OkStatus();
+    });
+  }
+  return absl::OkStatus();
+}
+
+absl::Status Remuxer::Finalize(std::vector<absl::string_view> *segments) {
+  if (video_source_) {
+    return absl::FailedPreconditionError(
+        "Video read from a file or source can't be returned as a segment");
+  }
+
+  RETURN_IF_ERROR(FinalizeStill(0, 0, segments));
+  segments->push_back(video_);
+  return absl::OkStatus();
+}
+
+absl::Status Remuxer::FinalizeToFd(int fd) {
+  // A cloned video must start on a block boundary of the output, like its
+  // start in the source file.
+  bool clone_video =
+      options_.clone_video && video_source_ && video_source_->fd() >= 0;
+  off_t output_offset = clone_video ? lseek(fd, 0, SEEK_CUR) : -1;
+  uint64_t video_alignment = output_offset >= 0 ? GetFdBlockSize(fd) : 0;
+
+  std::vector<absl::string_view> segments;
+  RETURN_IF_ERROR(FinalizeStill(output_offset >= 0 ? output_offset : 0,
+                                video_alignment, &segments));
+  if (!video_source_) {
+    segments.push_back(video_);
+    return WriteSegmentsToFd(fd, segments);
+  }
+
+  RETURN_IF_ERROR(WriteSegmentsToFd(fd, segments));
+  if (clone_video) {
+    return CloneFdRange(video_source_->fd(), 0, video_source_->Size(), fd);
+  }
+  if (video_source_->fd() >= 0) {
+    return CopyFdRange(video_source_->fd(), 0, video_source_->Size(), fd);
+  }
+  return GetVideoSourceTo(
+      [fd](const absl::string_view bytes) { return WriteToFd(fd, bytes); });
+}
+
+absl::Status Remuxer::FinalizeStill(uint64_t output_offset,
+                                    uint64_t video_alignment,
+                                    std::vector<absl::string_view> *segments) {
+  if (still_.empty() || (!streaming_ && GetVideoLength() == 0)) {
     return absl::FailedPreconditionError("Still or video not set");
   }
 
   RETURN_IF_ERROR(GenerateStillPadding());
 
-  // Get the current xmp to edit.
-  std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc =
-      xmp_io_helper_->GetXmp(still_);
+  // Declared first so the documents below are freed before it closes.
+  ScopedXmlParserReuse xml_parser_reuse(options_.reuse_xml_parser);
+
+  // Get the current xmp to edit. Only the xmp of the still is untrusted, so
+  // only it is held to the parse limits.
+  std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc;
+  {
+    ScopedXmlParseLimits parse_limits(options_.parse_limits);
+    xml_doc = xmp_io_helper_->GetXmp(still_);
+    RETURN_IF_ERROR(parse_limits.status());
+  }
+
   if (!xml_doc) {
     xml_doc = GetDefaultXmp();
+    if (!xml_doc) {
+      return absl::InternalError("Failed to create default xmp");
+    }
   }
 
-  auto xpath_context = GetXPathContext(kNamespaces, xml_doc.get());
-  if (!xpath_context) {
-    return kFailedXPathCreationError;
-  }
+  XmpWriteOptions xmp_write_options;
+  xmp_write_options.in_place = options_.write_xmp_in_place;
 
   // If the still has Microvideo metadata edit it, otherwise edit Motion Photo
   // metadata.
-  MPhotoFormat format = GetMPhotoFormat(*xpath_context);
+  MPhotoFormat format = GetMPhotoFormat(*xml_doc);
 
   if (format == MPhotoFormat::kMicrovideo) {
-    RETURN_IF_ERROR(UpdateXmpMicrovideo(xpath_context.get()));
+    RETURN_IF_ERROR(UpdateXmpMicrovideo(xml_doc.get()));
   } else {
     if (format == MPhotoFormat::kNone) {
       RETURN_IF_ERROR(
           MergeXmpItemIntoXmlDoc(kDefaultXmpMotionPhotoItem, xml_doc.get()));
     }
-    RETURN_IF_ERROR(UpdateXmpMotionPhoto(xpath_context.get()));
+    bool align_video = video_alignment > 0 &&
+                       xmp_io_helper_->GetMimeType() == MimeType::kImageJpeg;
+    RETURN_IF_ERROR(UpdateXmpMotionPhoto(xml_doc.get(), align_video));
+    if (align_video) {
+      RETURN_IF_ERROR(xmp_io_helper_->GetXmpEdit(*xml_doc, still_,
+                                                 xmp_write_options,
+                                                 &still_edit_));
+      RETURN_IF_ERROR(AlignVideo(xml_doc.get(),
+                                 output_offset + still_.length() -
+                                     still_edit_.length +
+                                     still_edit_.replacement.length(),
+                                 video_alignment, still_edit_.in_place));
+    }
   }
 
-  std::string updated_still;
-  RETURN_IF_ERROR(xmp_io_helper_->SetXmp(*xml_doc, still_, &updated_still));
+  RETURN_IF_ERROR(xmp_io_helper_->GetXmpEdit(*xml_doc, still_,
+                                             xmp_write_options, &still_edit_));
 
-  *motion_photo = updated_still + still_padding_ + video_;
+  absl::string_view still = still_;
+  segments->clear();
+  segments->push_back(still.substr(0, still_edit_.offset));
+  segments->push_back(still_edit_.replacement);
+  segments->push_back(still.substr(still_edit_.offset + still_edit_.length));
+  segments->push_back(still_padding_);
   return absl::OkStatus();
 }
 
-absl::Status Remuxer::UpdateXmpMotionPhoto(xmlXPathContext *xpath_context) {
-  RETURN_IF_ERROR(SetXmlAttributeValue(kMotionPhotoXPath, "1", xpath_context));
-  RETURN_IF_ERROR(
-      SetXmlAttributeValue(kMotionPhotoVersionXPath, "1", xpath_context));
-  RETURN_IF_ERROR(SetXmlAttributeValue(
-      kMotionPhotoPresentationTimestampUsXPath,
-      std::to_string(presentation_timestamp_us_), xpath_context));
-  RETURN_IF_ERROR(SetXmlAttributeValue(
-      kImageMimeTypeXPath, kMimeTypeToString.at(xmp_io_helper_->GetMimeType()),
-      xpath_context));
-  RETURN_IF_ERROR(SetXmlAttributeValue(
-      kVideoMimeTypeXPath, kMimeTypeToString.at(MimeType::kVideoMp4),
-      xpath_context));
-  RETURN_IF_ERROR(SetXmlAttributeValue(
-      kVideoLengthXPath, std::to_string(video_.length()), xpath_context));
-  if (still_padding_.length() > 0) {
-    RETURN_IF_ERROR(SetXmlAttributeValue(
-        kStillPaddingXPath, std::to_string(still_padding_.length()),
-        xpath_context));
+absl::Status Remuxer::Begin(const absl::string_view still,
+                            int presentation_timestamp_us, int fd) {
+  Reset();
+  off_t output_offset = lseek(fd, 0, SEEK_CUR);
+  if (output_offset < 0) {
+    return absl::InvalidArgumentError("Streaming requires a seekable fd");
+  }
+  RETURN_IF_ERROR(SetStillWithoutCopy(still, presentation_timestamp_us));
+  // Heic xmp can't be edited, so there is no placeholder to write over.
+  if (xmp_io_helper_->GetMimeType() != MimeType::kImageJpeg) {
+    Reset();
+    return absl::UnimplementedError("Streaming is only supported for jpeg");
+  }
+
+  streaming_ = true;
+  std::vector<absl::string_view> segments;
+  absl::Status status = FinalizeStill(0, 0, &segments);
+  if (!status.ok()) {
+    Reset();
+    return status;
   }
 
+  // The placeholder is zeroed so the motion photo is well formed, if
+  // incomplete, until End writes the length.
+  std::string *xmp_segment = &still_edit_.replacement;
+  size_t placeholder = xmp_segment->find(kVideoLengthPlaceholder);
+  if (placeholder == std::string::npos ||
+      xmp_segment->find(kVideoLengthPlaceholder, placeholder + 1) !=
+          std::string::npos) {
+    Reset();
+    return absl::InternalError("Failed to find video length placeholder");
+  }
+  xmp_segment->replace(placeholder, kVideoLengthWidth, kVideoLengthWidth, '0');
+  stream_length_offset_ = output_offset + still_edit_.offset + placeholder;
+
+  status = WriteSegmentsToFd(fd, segments);
+  still_ = absl::string_view();
+  if (!status.ok()) {
+    Reset();
+    return status;
+  }
+
+  stream_fd_ = fd;
   return absl::OkStatus();
 }
 
-absl::Status Remuxer::UpdateXmpMicrovideo(xmlXPathContext *xpath_context) {
-  RETURN_IF_ERROR(SetXmlAttributeValue(kMicrovideoXPath, "1", xpath_context));
-  RETURN_IF_ERROR(
-      SetXmlAttributeValue(kMicrovideoVersionXPath, "1", xpath_context));
-  RETURN_IF_ERROR(SetXmlAttributeValue(
-      kMicrovideoPresentationTimestampUsXPath,
-      std::to_string(presentation_timestamp_us_), xpath_context));
-  RETURN_IF_ERROR(SetXmlAttributeValue(
-      kMicrovideoOffsetXPath, std::to_string(video_.length()), xpath_context));
+absl::Status Remuxer::AppendVideo(const absl::string_view chunk) {
+  if (!streaming_) {
+    return absl::FailedPreconditionError("Begin not called");
+  }
+
+  size_t header_remaining =
+      kMimeTypeSniffSize -
+      std::min(streamed_video_header_.length(), kMimeTypeSniffSize);
+  streamed_video_header_.append(chunk.data(),
+                                std::min(chunk.length(), header_remaining));
+  RETURN_IF_ERROR(WriteToFd(stream_fd_, chunk));
+  streamed_video_length_ += chunk.length();
+  return absl::OkStatus();
+}
+
+absl::Status Remuxer::End() {
+  if (!streaming_) {
+    return absl::FailedPreconditionError("Begin not called");
+  }
+
+  absl::Status status = absl::OkStatus();
+  if (GetStreamMimeType(streamed_video_header_) != MimeType::kVideoMp4) {
+    status = kInvalidVideoError;
+  }
+
+  if (status.ok()) {
+    std::string length = std::to_string(streamed_video_length_);
+    length.insert(0, kVideoLengthWidth - length.length(), '0');
+    status = WriteToFdAt(stream_fd_, length, stream_length_offset_);
+  }
+
+  Reset();
+  return status;
+}
+
+void Remuxer::Reset() {
+  still_buffer_.clear();
+  video_buffer_.clear();
+  still_ = absl::string_view();
+  video_ = absl::string_view();
+  video_source_.reset();
+  still_padding_.clear();
+  still_edit_.replacement.clear();
+  presentation_timestamp_us_ = 0;
+  xmp_io_helper_ = nullptr;
+  streaming_ = false;
+  stream_fd_ = -1;
+  stream_length_offset_ = UINT64_MAX;
+  streamed_video_length_ = 0;
+  streamed_video_header_.clear();
+}
+
+absl::Status Remuxer::UpdateXmpMotionPhoto(xmlDoc *xml_doc,
+                                           bool write_padding) {
+  XmlFieldLookup lookup;
+  RETURN_IF_ERROR(FindXmlAttributes(kMotionPhotoXPaths, kMotionPhotoFieldCount,
+                                    kNamespaces, *xml_doc, &lookup));
+  if (write_padding && !lookup.attributes[kStillPaddingField]) {
+    RETURN_IF_ERROR(AddStillPaddingAttribute(
+        xml_doc, &lookup.attributes[kStillPaddingField]));
+  }
+
+  // Still padding is only written when there is padding.
+  uint32_t required = (1u << kMotionPhotoFieldCount) - 1;
+  if (still_padding_.empty()) {
+    required &= ~(1u << kStillPaddingField);
+  }
+  RETURN_IF_ERROR(CheckXmlFieldsFound(lookup, required, kMotionPhotoXPaths));
+
+  SetXmlAttributeValue("1", lookup.attributes[kMotionPhotoField]);
+  SetXmlAttributeValue("1", lookup.attributes[kMotionPhotoVersionField]);
+  SetXmlAttributeValue(
+      std::to_string(presentation_timestamp_us_),
+      lookup.attributes[kMotionPhotoPresentationTimestampUsField]);
+  SetXmlAttributeValue(kMimeTypeToString.at(xmp_io_helper_->GetMimeType()),
+                       lookup.attributes[kImageMimeTypeField]);
+  SetXmlAttributeValue(kMimeTypeToString.at(MimeType::kVideoMp4),
+                       lookup.attributes[kVideoMimeTypeField]);
+  SetXmlAttributeValue(GetVideoLengthValue(),
+                       lookup.attributes[kVideoLengthField]);
+  if (write_padding || still_padding_.length() > 0) {
+    SetXmlAttributeValue(std::to_string(still_padding_.length()),
+                         lookup.attributes[kStillPaddingField]);
+  }
+
+  return absl::OkStatus();
+}
+
+absl::Status Remuxer::AlignVideo(xmlDoc *xml_doc, uint64_t still_end,
+                                 uint64_t video_alignment, bool fixed_length) {
+  // The still ends at still_end with a one digit padding written, and each
+  // further digit of the padding moves its end by a byte, unless its xmp is
+  // written in place. The padding is chosen so it aligns the video once its
+  // own digits are written, which may not be possible when the digit count
+  // rolls over, in which case the video is left unaligned.
+  uint64_t still_end_without_padding = still_end - (fixed_length ? 0 : 1);
+  for (size_t digits = 1; digits <= kMaxPaddingDigits; digits++) {
+    uint64_t end = still_end_without_padding + (fixed_length ? 0 : digits);
+    uint64_t padding = (video_alignment - end % video_alignment) %
+                       video_alignment;
+    if (fixed_length || std::to_string(padding).length() == digits) {
+      still_padding_.assign(padding, '\0');
+      return UpdateXmpMotionPhoto(xml_doc, true);
+    }
+  }
+
+  return absl::OkStatus();
+}
+
+absl::Status Remuxer::UpdateXmpMicrovideo(xmlDoc *xml_doc) {
+  XmlFieldLookup lookup;
+  RETURN_IF_ERROR(FindXmlAttributes(kMicrovideoXPaths, kMicrovideoFieldCount,
+                                    kNamespaces, *xml_doc, &lookup));
+  RETURN_IF_ERROR(CheckXmlFieldsFound(
+      lookup, (1u << kMicrovideoFieldCount) - 1, kMicrovideoXPaths));
+
+  SetXmlAttributeValue("1", lookup.attributes[kMicrovideoField]);
+  SetXmlAttributeValue("1", lookup.attributes[kMicrovideoVersionField]);
+  SetXmlAttributeValue(
+      std::to_string(presentation_timestamp_us_),
+      lookup.attributes[kMicrovideoPresentationTimestampUsField]);
+  SetXmlAttributeValue(GetVideoLengthValue(),
+                       lookup.attributes[kMicrovideoOffsetField]);
+
+  return absl::OkStatus();
+}
+
+uint64_t Remuxer::GetVideoLength() const {
+  return video_source_ ? video_source_->Size() : video_.length();
+}
+
+std::string Remuxer::GetVideoLengthValue() const {
+  return streaming_ ? kVideoLengthPlaceholder
+                    : std::to_string(GetVideoLength());
+}
+
+absl::Status Remuxer::GetVideoSourceTo(const ByteSink &sink) {
+  std::string scratch;
+  uint64_t size = video_source_->Size();
+  for (uint64_t offset = 0; offset < size; offset += kVideoChunkSize) {
+    absl::string_view chunk;
+    RETURN_IF_ERROR(video_source_->ReadAt(
+        offset, std::min<uint64_t>(size - offset, kVideoChunkSize), &scratch,
+        &chunk));
+    RETURN_IF_ERROR(sink(chunk));
+  }
 
   return absl::OkStatus();
 }
@@ -239,12 +617,12 @@ absl::Status Remuxer::UpdateXmpMicrovideo(xmlXPathContext *xpath_context) {
 absl::Status Remuxer::GenerateStillPadding() {
   if (xmp_io_helper_->GetMimeType() == MimeType::kImageJpeg) {
     // Jpeg Motion Photos/Microvideos do not have any paddig around still.
-    still_padding_ = "";
+    still_padding_.clear();
     return absl::OkStatus();
   }
 
   if (xmp_io_helper_->GetMimeType() == MimeType::kImageHeic) {
-    return GetHeicStillPadding(video_.length(), &still_padding_);
+    return GetHeicStillPadding(GetVideoLength(), &still_padding_);
   }
 
   return absl::InternalError("Invalid motion photo mime type");
@@ -17,21 +17,58 @@
 #ifndef LIBMPHOTO_REMUXER_REMUXER_H_
 #define LIBMPHOTO_REMUXER_REMUXER_H_
 
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "absl/status/status.h"
 #include "absl/strings/string_view.h"
-#include "libmphoto/common/xmp_io/xmp_io_helper.h"
+#include "libmphoto/common/byte_source.h"
+#include "libmphoto/common/image_edit.h"
+#include "libmphoto/common/parse_limits.h"
+
+// Declared as libxml does, so clients need not depend on libxml.
+typedef struct _xmlDoc xmlDoc;
 
 namespace libmphoto {
 
+class IXmpIOHelper;
+
+// This struct holds the options controlling how a remuxer produces motion
+// photos.
+struct RemuxerOptions {
+  // If true, xmp documents parsed on a thread reuse its parser context, see
+  // ScopedXmlParserReuse. The context is only trimmed when Finalize returns,
+  // so this suits threads which remux many files in turn.
+  bool reuse_xml_parser = false;
+
+  // The limits on the xmp of the still. Finalize fails with a resource
+  // exhausted error for xmp which exceeds them.
+  ParseLimits parse_limits;
+
+  // If true, FinalizeToFd shares the extents of a video read from a file with
+  // the output where the filesystem supports reflinks, see CloneFdRange,
+  // rather than copying them. Jpeg motion photos are padded after the still
+  // so the video starts on a block boundary of the output, as required to
+  // share its extents.
+  bool clone_video = false;
+
+  // If true, the xmp of a jpeg still is written over its existing xmp packet
+  // where it fits, see XmpWriteOptions::in_place, so the still's segments
+  // keep their offsets. Otherwise the xmp is written compactly in a new
+  // segment.
+  bool write_xmp_in_place = false;
+};
+
 // This class provides functionality for combining encoded media
 // streams to produce motion photos. SetStill and SetVideo must be called before
-// Finalize.
+// Finalize. Alternatively Begin, AppendVideo and End produce a motion photo
+// while its video is still being encoded.
 class Remuxer {
  public:
   Remuxer();
+  explicit Remuxer(const RemuxerOptions &options);
 
   // Sets the still portion of the motion photo, taking the timestamp
   // (in us) of the still's position in the video. If not provided, the default
@@ -39,21 +76,124 @@ class Remuxer {
   absl::Status SetStill(const absl::string_view still,
                         int presentation_timestamp_us = 0);
 
+  // Sets the still portion of the motion photo without copying it. The bytes
+  // are borrowed, and must outlive the remuxer or the next call to SetStill
+  // or Reset.
+  absl::Status SetStillWithoutCopy(const absl::string_view still,
+                                   int presentation_timestamp_us = 0);
+
   // Sets the video portion of the motion photo.
   absl::Status SetVideo(const absl::string_view video);
 
-  // Produces a motion photo based on provided media streams.
+  // Sets the video portion of the motion photo without copying it. The bytes
+  // are borrowed, and must outlive the remuxer or the next call to SetVideo
+  // or Reset.
+  absl::Status SetVideoWithoutCopy(const absl::string_view video);
+
+  // Sets the video portion of the motion photo to the file at path. Only the
+  // leading bytes are read to check the video type; the rest are copied when
+  // the motion photo is produced, within the kernel by FinalizeToFd.
+  absl::Status SetVideoFromFile(const std::string &path);
+
+  // Sets the video portion of the motion photo to the open file fd, as with
+  // SetVideoFromFile. The file descriptor is borrowed, and must outlive the
+  // remuxer or the next call to SetVideo or Reset.
+  absl::Status SetVideoFromFd(int fd);
+
+  // Sets the video portion of the motion photo to the bytes of source, as
+  // with SetVideoFromFile.
+  absl::Status SetVideoFromSource(std::unique_ptr<ByteSource> source);
+
+  // Produces a motion photo based on provided media streams. The motion photo
+  // is allocated once, at its final size.
   absl::Status Finalize(std::string *motion_photo);
 
+  // Produces a motion photo as an ordered list of segments, which concatenated
+  // are the motion photo. Only the rewritten xmp segment and the padding are
+  // new bytes; the other segments are views of the still and video. Segments
+  // are valid until the remuxer is next modified. Fails with a failed
+  // precondition error if the video is read from a file or source.
+  absl::Status Finalize(std::vector<absl::string_view> *segments);
+
+  // Produces a motion photo, writing its segments to the current position of
+  // fd with writev. A video read from a file is copied after them with
+  // copy_file_range, or cloned if RemuxerOptions::clone_video is set, so the
+  // memory used does not depend on the video length.
+  absl::Status FinalizeToFd(int fd);
+
+  // Starts producing a motion photo with the given still at the current
+  // position of fd, whose video is passed in chunks to AppendVideo. The still
+  // is written immediately, with fixed width placeholders for the fields
+  // holding the video length, so the still bytes are not needed after Begin
+  // returns. fd must be seekable, as End writes the video length over the
+  // placeholders, and must stay open until End returns. Only jpeg stills are
+  // supported, as heic xmp can't be edited.
+  absl::Status Begin(const absl::string_view still,
+                     int presentation_timestamp_us, int fd);
+
+  // Appends a chunk of the video, writing it straight to the fd passed to
+  // Begin.
+  absl::Status AppendVideo(const absl::string_view chunk);
+
+  // Completes the motion photo started by Begin, writing the video length
+  // over the placeholders. Fails with an invalid argument error if the video
+  // can't be parsed as an mp4, in which case the motion photo is incomplete.
+  absl::Status End();
+
+  // Clears the still and video so the remuxer can be reused for another
+  // motion photo. Buffers keep their capacity, so a remuxer reused across
+  // many files does not reallocate them once warmed up.
+  void Reset();
+
  private:
-  std::string still_;
+  RemuxerOptions options_;
+  // Hold the still and video when they are copied by SetStill and SetVideo.
+  std::string still_buffer_;
+  std::string video_buffer_;
+  // The still and video, which are either borrowed or view the buffers.
+  absl::string_view still_;
+  absl::string_view video_;
+  // The video when it is read from a file or source rather than memory.
+  std::unique_ptr<ByteSource> video_source_;
   std::string still_padding_;
-  std::string video_;
-  int presentation_timestamp_us_;
-  std::unique_ptr<IXmpIOHelper> xmp_io_helper_;
+  // The state of a motion photo started by Begin and not yet ended, with the
+  // offset of the video length placeholder.
+  bool streaming_ = false;
+  int stream_fd_ = -1;
+  uint64_t stream_length_offset_ = UINT64_MAX;
+  uint64_t streamed_video_length_ = 0;
+  // Holds the leading bytes of a streamed video, to check its type.
+  std::string streamed_video_header_;
+  // Holds the edit of the still which updates its xmp during Finalize.
+  ImageEdit still_edit_;
+  int presentation_timestamp_us_ = 0;
+  // The shared helper for the still container type.
+  IXmpIOHelper *xmp_io_helper_ = nullptr;
 
-  absl::Status UpdateXmpMotionPhoto(xmlXPathContext *xpath_context);
-  absl::Status UpdateXmpMicrovideo(xmlXPathContext *xpath_context);
+  // Updates the xmp of the still and generates the padding, setting segments
+  // to the segments of the motion photo which precede the video. If
+  // video_alignment is nonzero, a jpeg still is padded where possible so the
+  // video starts at a multiple of it, given the motion photo is written from
+  // output_offset.
+  absl::Status FinalizeStill(uint64_t output_offset, uint64_t video_alignment,
+                             std::vector<absl::string_view> *segments);
+  uint64_t GetVideoLength() const;
+  // Returns the video length written to the xmp, which is a placeholder
+  // while streaming.
+  std::string GetVideoLengthValue() const;
+  // Passes the video read from video_source_ to sink in bounded chunks.
+  absl::Status GetVideoSourceTo(const ByteSink &sink);
+  // Updates the motion photo fields. The still padding is written when there
+  // is padding or write_padding is set, in which case the field is added to
+  // the primary item if missing.
+  absl::Status UpdateXmpMotionPhoto(xmlDoc *xml_doc, bool write_padding);
+  // Pads a jpeg still so the video starts at a multiple of video_alignment,
+  // given the still before padding ends at still_end. fixed_length is set
+  // when the xmp is written in place, so the padding digits don't move the
+  // end of the still.
+  absl::Status AlignVideo(xmlDoc *xml_doc, uint64_t still_end,
+                          uint64_t video_alignment, bool fixed_length);
+  absl::Status UpdateXmpMicrovideo(xmlDoc *xml_doc);
   absl::Status GenerateStillPadding();
 };
 
@@ -27,15 +27,9 @@ int main(int argc, char *argv[]) {
     return -1;
   }
 
-  // Read entire file into memory.
-  std::ifstream file(argv[1], std::ifstream::in | std::ifstream::binary);
-  std::ostringstream ostream;
-  ostream << file.rdbuf();
-  std::string file_bytes(ostream.str());
-
-  // Initialize demuxer.
+  // Initialize demuxer, mapping the file rather than reading it into memory.
   libmphoto::Demuxer demuxer;
-  TERMINATE_IF_ERROR(demuxer.Init(file_bytes))
+  TERMINATE_IF_ERROR(demuxer.InitFromFile(argv[1]))
 
   // Get image info.
   libmphoto::ImageInfo image_info;
@@ -0,0 +1,93 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "absl/status/statusor.h"
+#include "libmphoto/batch/batch_demuxer.h"
+#include "tests/common/io_helper.h"
+
+namespace libmphoto {
+
+namespace {
+
+constexpr char kJpegMotionPhotoPath[] =
+    "sample_data/jpeg_motion_photo/motion_photo.jpeg";
+
+// Returns inputs alternating between the jpeg motion photo in memory, the same
+// file by path, and a file which does not exist.
+std::vector<BatchDemuxInput> GetInputs(const std::string &motion_photo,
+                                       int repeat) {
+  std::vector<BatchDemuxInput> inputs;
+  for (int i = 0; i < repeat; i++) {
+    inputs.push_back(BatchDemuxInput::FromBytes(motion_photo));
+    inputs.push_back(BatchDemuxInput::FromPath(kJpegMotionPhotoPath));
+    inputs.push_back(BatchDemuxInput::FromPath("sample_data/does_not_exist"));
+  }
+  return inputs;
+}
+
+}  // namespace
+
+TEST(BatchDemuxer, CanDemuxInInputOrder) {
+  std::string motion_photo = GetBytesFromFile(kJpegMotionPhotoPath);
+  std::string correct_video_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/video.mp4");
+
+  BatchDemuxerOptions options;
+  options.thread_count = 4;
+  options.extract_video = true;
+  BatchDemuxer batch_demuxer(options);
+
+  std::vector<absl::StatusOr<BatchDemuxResult>> results =
+      batch_demuxer.Demux(GetInputs(motion_photo, 20));
+  ASSERT_EQ(results.size(), 60u);
+
+  for (size_t i = 0; i < results.size(); i += 3) {
+    for (size_t j = i; j < i + 2; j++) {
+      ASSERT_TRUE(results[j].ok());
+      EXPECT_EQ(results[j]->image_info.video_length, 122562u);
+      EXPECT_TRUE(results[j]->still.empty());
+      EXPECT_EQ(results[j]->video, correct_video_bytes) << "Bytes differ";
+    }
+    EXPECT_EQ(results[i + 2].status().code(), absl::StatusCode::kNotFound);
+  }
+}
+
+TEST(BatchDemuxer, CanStreamResults) {
+  std::string motion_photo = GetBytesFromFile(kJpegMotionPhotoPath);
+  std::vector<BatchDemuxInput> inputs = GetInputs(motion_photo, 20);
+
+  BatchDemuxer batch_demuxer;
+  std::vector<int> callback_counts(inputs.size());
+  batch_demuxer.Demux(inputs, [&callback_counts](
+                                  size_t index,
+                                  absl::StatusOr<BatchDemuxResult> result) {
+    callback_counts[index]++;
+    EXPECT_EQ(result.ok(), index % 3 != 2);
+  });
+
+  for (int callback_count : callback_counts) {
+    EXPECT_EQ(callback_count, 1);
+  }
+}
+
+TEST(BatchDemuxer, CanDemuxAnEmptyBatch) {
+  BatchDemuxer batch_demuxer;
+  EXPECT_TRUE(batch_demuxer.Demux({}).empty());
+}
+
+}  // namespace libmphoto
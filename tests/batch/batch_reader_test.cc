@@ -0,0 +1,136 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "absl/status/statusor.h"
+#include "libmphoto/batch/batch_reader.h"
+#include "libmphoto/batch/io_uring.h"
+
+namespace libmphoto {
+
+namespace {
+
+const std::vector<std::string> kPaths = {
+    "sample_data/jpeg_motion_photo/motion_photo.jpeg",
+    "sample_data/heic_motion_photo/motion_photo.heic",
+    "sample_data/mp4/video.mp4",
+    "sample_data/does_not_exist.jpeg",
+};
+
+// Probes kPaths, repeated repeat times, returning the results by index.
+std::vector<absl::StatusOr<MotionPhotoLayout>> ProbeFiles(
+    const BatchReaderOptions &options, int repeat, bool *used_io_uring) {
+  std::vector<std::string> paths;
+  for (int i = 0; i < repeat; i++) {
+    paths.insert(paths.end(), kPaths.begin(), kPaths.end());
+  }
+
+  std::vector<absl::StatusOr<MotionPhotoLayout>> results(
+      paths.size(), absl::UnknownError("No callback"));
+  BatchReader batch_reader(options);
+  EXPECT_TRUE(batch_reader
+                  .ProbeFiles(paths,
+                              [&results](size_t index,
+                                         absl::StatusOr<MotionPhotoLayout>
+                                             layout) {
+                                EXPECT_FALSE(
+                                    absl::IsUnknown(layout.status()));
+                                results[index] = std::move(layout);
+                              })
+                  .ok());
+  *used_io_uring = batch_reader.used_io_uring();
+  return results;
+}
+
+// Checks results hold the expected outcome for each of kPaths.
+void ExpectResults(
+    const std::vector<absl::StatusOr<MotionPhotoLayout>> &results) {
+  for (size_t i = 0; i < results.size(); i += kPaths.size()) {
+    ASSERT_TRUE(results[i].ok());
+    EXPECT_EQ(results[i]->image_info.still_mime_type, MimeType::kImageJpeg);
+    EXPECT_EQ(results[i]->video_length, 122562u);
+
+    ASSERT_TRUE(results[i + 1].ok());
+    EXPECT_EQ(results[i + 1]->image_info.still_mime_type,
+              MimeType::kImageHeic);
+    EXPECT_EQ(results[i + 1]->padding_length, 16u);
+    EXPECT_EQ(results[i + 1]->video_length, 1544201u);
+
+    EXPECT_EQ(results[i + 2].status().code(),
+              absl::StatusCode::kInvalidArgument);
+    EXPECT_EQ(results[i + 3].status().code(), absl::StatusCode::kNotFound);
+  }
+}
+
+}  // namespace
+
+TEST(BatchReader, CanProbeFiles) {
+  bool used_io_uring;
+  ExpectResults(ProbeFiles(BatchReaderOptions(), 1, &used_io_uring));
+}
+
+TEST(BatchReader, CanProbeMoreFilesThanQueueDepth) {
+  BatchReaderOptions options;
+  options.queue_depth = 3;
+  options.fallback_threads = 3;
+  // Forces several reads per file as metadata lies past the first read.
+  options.initial_read_length = 64;
+
+  bool used_io_uring;
+  ExpectResults(ProbeFiles(options, 5, &used_io_uring));
+}
+
+TEST(BatchReader, CanProbeFilesWithPread) {
+  BatchReaderOptions options;
+  options.disable_io_uring = true;
+  options.initial_read_length = 64;
+
+  bool used_io_uring;
+  ExpectResults(ProbeFiles(options, 5, &used_io_uring));
+  EXPECT_FALSE(used_io_uring);
+}
+
+TEST(BatchReader, CanProbeFilesWhenIoUringFailsPartway) {
+  BatchReaderOptions options;
+  options.queue_depth = 3;
+  options.initial_read_length = 64;
+
+  // Fails after some reads complete, with others in flight and files left to
+  // start, all of which are then probed with pread.
+  IoUring::SetSubmitFailureForTesting(4);
+  bool used_io_uring;
+  std::vector<absl::StatusOr<MotionPhotoLayout>> results =
+      ProbeFiles(options, 5, &used_io_uring);
+  IoUring::SetSubmitFailureForTesting(-1);
+
+  ExpectResults(results);
+}
+
+TEST(BatchReader, CanFailWhenQueueDepthIsInvalid) {
+  BatchReaderOptions options;
+  options.queue_depth = 0;
+
+  BatchReader batch_reader(options);
+  EXPECT_EQ(batch_reader
+                .ProbeFiles({"sample_data/jpeg_motion_photo/motion_photo.jpeg"},
+                            [](size_t index,
+                               absl::StatusOr<MotionPhotoLayout> layout) {})
+                .code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+}  // namespace libmphoto
@@ -0,0 +1,72 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "libmphoto/batch/work_stealing_pool.h"
+
+namespace libmphoto {
+
+TEST(WorkStealingPool, CanRunEachIndexOnce) {
+  WorkStealingPool pool(4);
+  EXPECT_EQ(pool.thread_count(), 4);
+
+  std::vector<std::atomic<int>> runs(1000);
+  pool.ParallelFor(runs.size(), [&runs](int worker, size_t index) {
+    EXPECT_GE(worker, 0);
+    EXPECT_LT(worker, 4);
+    runs[index]++;
+  });
+
+  for (const std::atomic<int> &run_count : runs) {
+    EXPECT_EQ(run_count, 1);
+  }
+}
+
+TEST(WorkStealingPool, CanRunManyLoops) {
+  WorkStealingPool pool(3);
+
+  std::atomic<size_t> total(0);
+  for (size_t count = 0; count < 50; count++) {
+    pool.ParallelFor(count, [&total](int worker, size_t index) { total++; });
+  }
+
+  EXPECT_EQ(total, 50u * 49 / 2);
+}
+
+TEST(WorkStealingPool, CanStealFromABusyWorker) {
+  WorkStealingPool pool(2);
+
+  // The first worker's range starts with an index which blocks until every
+  // other index has run, which can only happen if they are stolen.
+  constexpr size_t kCount = 100;
+  std::atomic<size_t> done(0);
+  pool.ParallelFor(kCount, [&done](int worker, size_t index) {
+    if (index == 0) {
+      while (done < kCount - 1) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    } else {
+      done++;
+    }
+  });
+
+  EXPECT_EQ(done, kCount - 1);
+}
+
+}  // namespace libmphoto
@@ -14,6 +14,8 @@
 
 #include "tests/common/io_helper.h"
 
+#include <unistd.h>
+
 #include <fstream>
 #include <sstream>
 
@@ -27,4 +29,17 @@ std::string GetBytesFromFile(const std::string &file_name) {
   return std::string(ostream.str());
 }
 
+// Returns the bytes of an open file, read from its start.
+std::string GetBytesFromFd(int fd) {
+  std::string bytes;
+  char buffer[4096];
+  ssize_t count;
+  off_t offset = 0;
+  while ((count = pread(fd, buffer, sizeof(buffer), offset)) > 0) {
+    bytes.append(buffer, count);
+    offset += count;
+  }
+  return bytes;
+}
+
 }  // namespace libmphoto
@@ -24,6 +24,9 @@ namespace libmphoto {
 // Returns the bytes of a file read.
 std::string GetBytesFromFile(const std::string &file_name);
 
+// Returns the bytes of an open file, read from its start.
+std::string GetBytesFromFd(int fd);
+
 }  // namespace libmphoto
 
 #endif  // TESTS_COMMON_IO_HELPER_H_
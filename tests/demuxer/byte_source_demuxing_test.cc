@@ -0,0 +1,170 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gtest/gtest.h"
+#include "absl/memory/memory.h"
+#include "libmphoto/common/byte_source.h"
+#include "libmphoto/common/stream_parser.h"
+#include "libmphoto/demuxer/demuxer.h"
+#include "libmphoto/demuxer/image_info.h"
+#include "tests/common/io_helper.h"
+
+namespace libmphoto {
+
+namespace {
+
+// Returns a callback byte source over bytes, which counts the bytes read.
+std::unique_ptr<ByteSource> GetCountingByteSource(const std::string &bytes,
+                                                  uint64_t *bytes_read) {
+  *bytes_read = 0;
+  return absl::make_unique<CallbackByteSource>(
+      bytes.length(), [&bytes, bytes_read](uint64_t offset, size_t length,
+                                           std::string *result) {
+        *bytes_read += length;
+        *result = bytes.substr(offset, length);
+        return absl::OkStatus();
+      });
+}
+
+// Returns a callback byte source over bytes, which counts the reads made.
+std::unique_ptr<ByteSource> GetReadCountingByteSource(const std::string &bytes,
+                                                      int *read_count) {
+  *read_count = 0;
+  return absl::make_unique<CallbackByteSource>(
+      bytes.length(), [&bytes, read_count](uint64_t offset, size_t length,
+                                           std::string *result) {
+        (*read_count)++;
+        *result = bytes.substr(offset, length);
+        return absl::OkStatus();
+      });
+}
+
+}  // namespace
+
+TEST(ByteSourceDemuxing, CanDemuxAValidHeicMotionPhotoFromFile) {
+  std::string correct_still_bytes =
+      GetBytesFromFile("sample_data/heic_motion_photo/still.heic");
+
+  std::unique_ptr<FileByteSource> source;
+  EXPECT_TRUE(FileByteSource::Open(
+                  "sample_data/heic_motion_photo/motion_photo.heic", &source)
+                  .ok());
+
+  Demuxer demuxer;
+  EXPECT_TRUE(demuxer.InitFromSource(std::move(source)).ok());
+
+  ImageInfo image_info;
+  EXPECT_TRUE(demuxer.GetInfo(&image_info).ok());
+  EXPECT_EQ(image_info.still_mime_type, MimeType::kImageHeic);
+  EXPECT_EQ(image_info.video_length, 1544201u);
+  EXPECT_EQ(image_info.still_padding, 16u);
+
+  std::string demuxed_still_bytes;
+  EXPECT_TRUE(demuxer.GetStill(&demuxed_still_bytes).ok());
+  EXPECT_EQ(demuxed_still_bytes, correct_still_bytes) << "Bytes differ";
+}
+
+TEST(ByteSourceDemuxing, CanDemuxAValidJpegMotionPhotoFromFile) {
+  std::string correct_video_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/video.mp4");
+
+  std::unique_ptr<FileByteSource> source;
+  EXPECT_TRUE(FileByteSource::Open(
+                  "sample_data/jpeg_motion_photo/motion_photo.jpeg", &source)
+                  .ok());
+
+  Demuxer demuxer;
+  EXPECT_TRUE(demuxer.InitFromSource(std::move(source)).ok());
+
+  ImageInfo image_info;
+  EXPECT_TRUE(demuxer.GetInfo(&image_info).ok());
+  EXPECT_EQ(image_info.motion_photo_presentation_timestamp_us, 500000);
+  EXPECT_EQ(image_info.video_length, 122562u);
+
+  absl::string_view demuxed_video;
+  EXPECT_TRUE(demuxer.GetVideoView(&demuxed_video).ok());
+  EXPECT_EQ(demuxed_video, correct_video_bytes) << "Bytes differ";
+}
+
+TEST(ByteSourceDemuxing, CanReadOnlyHeaderRangesForInformation) {
+  std::string motion_photo_bytes =
+      GetBytesFromFile("sample_data/heic_motion_photo/motion_photo.heic");
+
+  uint64_t bytes_read;
+  Demuxer demuxer;
+  EXPECT_TRUE(
+      demuxer
+          .InitFromSource(GetCountingByteSource(motion_photo_bytes, &bytes_read))
+          .ok());
+
+  ImageInfo image_info;
+  EXPECT_TRUE(demuxer.GetInfo(&image_info).ok());
+  EXPECT_LT(bytes_read, motion_photo_bytes.length() / 10);
+}
+
+TEST(ByteSourceDemuxing, CanInitWithOneReadOfLeadingBytes) {
+  std::string motion_photo_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/motion_photo.jpeg");
+
+  // The leading bytes are read once for the type, xmp and header checks. The
+  // video of this motion photo is small enough that its header is read with
+  // them.
+  int read_count;
+  Demuxer demuxer;
+  EXPECT_TRUE(demuxer
+                  .InitFromSource(GetReadCountingByteSource(motion_photo_bytes,
+                                                            &read_count))
+                  .ok());
+  EXPECT_EQ(read_count, 1);
+}
+
+TEST(ByteSourceDemuxing, CanReadOnlyTypeHeaderOnLazyInit) {
+  std::string motion_photo_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/motion_photo.jpeg");
+
+  uint64_t bytes_read;
+  DemuxerOptions options;
+  options.lazy_init = true;
+  Demuxer demuxer(options);
+  EXPECT_TRUE(
+      demuxer
+          .InitFromSource(GetCountingByteSource(motion_photo_bytes, &bytes_read))
+          .ok());
+  EXPECT_EQ(bytes_read, kMimeTypeSniffSize);
+
+  ImageInfo image_info;
+  EXPECT_TRUE(demuxer.GetInfo(&image_info).ok());
+  EXPECT_EQ(image_info.video_length, 122562u);
+  EXPECT_GT(bytes_read, kMimeTypeSniffSize);
+}
+
+TEST(ByteSourceDemuxing, CanFailWhenSourceIsNull) {
+  Demuxer demuxer;
+  EXPECT_EQ(demuxer.InitFromSource(nullptr).code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+TEST(ByteSourceDemuxing, CanFailWhenSourceReadFails) {
+  Demuxer demuxer;
+  EXPECT_EQ(demuxer
+                .InitFromSource(absl::make_unique<CallbackByteSource>(
+                    1024,
+                    [](uint64_t offset, size_t length, std::string *bytes) {
+                      return absl::UnavailableError("Storage unavailable");
+                    }))
+                .code(),
+            absl::StatusCode::kUnavailable);
+}
+
+}  // namespace libmphoto
@@ -0,0 +1,113 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "gtest/gtest.h"
+#include "libmphoto/common/byte_source.h"
+#include "libmphoto/demuxer/demuxer.h"
+#include "libmphoto/initialize.h"
+#include "tests/common/io_helper.h"
+
+namespace libmphoto {
+
+namespace {
+
+constexpr int kThreadCount = 8;
+constexpr int kReadsPerThread = 100;
+
+}  // namespace
+
+TEST(ConcurrentDemuxing, CanShareAConstDemuxerAcrossThreads) {
+  Initialize();
+  std::string motion_photo_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/motion_photo.jpeg");
+  std::string correct_still_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/still.jpeg");
+  std::string correct_video_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/video.mp4");
+
+  Demuxer demuxer;
+  ASSERT_TRUE(demuxer.Init(motion_photo_bytes).ok());
+  const Demuxer &shared_demuxer = demuxer;
+
+  std::vector<int> mismatches(kThreadCount, 0);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreadCount; i++) {
+    threads.emplace_back([&shared_demuxer, &correct_still_bytes,
+                          &correct_video_bytes, &mismatches, i] {
+      for (int j = 0; j < kReadsPerThread; j++) {
+        ImageInfo image_info;
+        absl::string_view still;
+        absl::string_view video;
+        if (!shared_demuxer.GetInfo(&image_info).ok() ||
+            !shared_demuxer.GetStillView(&still).ok() ||
+            !shared_demuxer.GetVideoView(&video).ok() ||
+            still != correct_still_bytes || video != correct_video_bytes) {
+          mismatches[i]++;
+        }
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  for (int i = 0; i < kThreadCount; i++) {
+    EXPECT_EQ(mismatches[i], 0) << "Thread " << i;
+  }
+}
+
+TEST(ConcurrentDemuxing, ConstAccessorsRequireParsedXmp) {
+  std::string motion_photo_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/motion_photo.jpeg");
+
+  DemuxerOptions options;
+  options.lazy_init = true;
+  Demuxer demuxer(options);
+  ASSERT_TRUE(demuxer.Init(motion_photo_bytes).ok());
+
+  const Demuxer &shared_demuxer = demuxer;
+  absl::string_view still;
+  EXPECT_EQ(shared_demuxer.GetStillView(&still).code(),
+            absl::StatusCode::kFailedPrecondition);
+
+  ImageInfo image_info;
+  EXPECT_TRUE(demuxer.GetInfo(&image_info).ok());
+  EXPECT_TRUE(shared_demuxer.GetStillView(&still).ok());
+}
+
+TEST(ConcurrentDemuxing, ConstViewsRequireBytesInMemory) {
+  std::string motion_photo_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/motion_photo.jpeg");
+
+  Demuxer demuxer;
+  ASSERT_TRUE(demuxer
+                  .InitFromSource(
+                      absl::make_unique<MemoryByteSource>(motion_photo_bytes))
+                  .ok());
+
+  const Demuxer &shared_demuxer = demuxer;
+  ImageInfo image_info;
+  EXPECT_TRUE(shared_demuxer.GetInfo(&image_info).ok());
+  absl::string_view video;
+  EXPECT_EQ(shared_demuxer.GetVideoView(&video).code(),
+            absl::StatusCode::kFailedPrecondition);
+}
+
+}  // namespace libmphoto
@@ -101,8 +101,8 @@ TEST(InformationExtraction, CanParseValidHeicMotionPhoto) {
   EXPECT_EQ(image_info.motion_photo_presentation_timestamp_us, 0);
   EXPECT_EQ(image_info.still_mime_type, MimeType::kImageHeic);
   EXPECT_EQ(image_info.video_mime_type, MimeType::kVideoMp4);
-  EXPECT_EQ(image_info.video_length, 1544201);
-  EXPECT_EQ(image_info.still_padding, 16);
+  EXPECT_EQ(image_info.video_length, 1544201u);
+  EXPECT_EQ(image_info.still_padding, 16u);
 }
 
 TEST(InformationExtraction, CanParseValidJpegMotionPhoto) {
@@ -120,8 +120,106 @@ TEST(InformationExtraction, CanParseValidJpegMotionPhoto) {
   EXPECT_EQ(image_info.motion_photo_presentation_timestamp_us, 500000);
   EXPECT_EQ(image_info.still_mime_type, MimeType::kImageJpeg);
   EXPECT_EQ(image_info.video_mime_type, MimeType::kVideoMp4);
-  EXPECT_EQ(image_info.video_length, 122562);
-  EXPECT_EQ(image_info.still_padding, 0);
+  EXPECT_EQ(image_info.video_length, 122562u);
+  EXPECT_EQ(image_info.still_padding, 0u);
+}
+
+TEST(InformationExtraction, CanParseValidJpegMotionPhotoLazily) {
+  std::string photo_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/motion_photo.jpeg");
+
+  DemuxerOptions options;
+  options.lazy_init = true;
+  Demuxer demuxer(options);
+  ImageInfo image_info;
+
+  EXPECT_TRUE(demuxer.Init(photo_bytes).ok());
+  EXPECT_TRUE(demuxer.GetInfo(&image_info).ok());
+
+  EXPECT_EQ(image_info.motion_photo_presentation_timestamp_us, 500000);
+  EXPECT_EQ(image_info.still_mime_type, MimeType::kImageJpeg);
+  EXPECT_EQ(image_info.video_length, 122562u);
+}
+
+TEST(InformationExtraction, CanDeferInvalidLengthErrorWhenLazy) {
+  std::string invalid_video_length_xmp_metadata =
+      GetXmp("1", "1", "500000", "image/jpeg", "video/mp4", "2147483647");
+
+  std::string photo_bytes =
+      GetPhotoBytesFromXmp(invalid_video_length_xmp_metadata);
+
+  DemuxerOptions options;
+  options.lazy_init = true;
+  Demuxer demuxer(options);
+  EXPECT_TRUE(demuxer.Init(photo_bytes).ok());
+
+  // The error is cached and returned by every accessor.
+  ImageInfo image_info;
+  EXPECT_EQ(demuxer.GetInfo(&image_info).code(),
+            absl::StatusCode::kInvalidArgument);
+  std::string video;
+  EXPECT_EQ(demuxer.GetVideo(&video).code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+TEST(InformationExtraction, CanFailWhenXmpExceedsParseLimits) {
+  std::string photo_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/motion_photo.jpeg");
+
+  DemuxerOptions options;
+  options.parse_limits.max_xmp_bytes = 100;
+  EXPECT_EQ(Demuxer(options).Init(photo_bytes).code(),
+            absl::StatusCode::kResourceExhausted);
+
+  options = DemuxerOptions();
+  options.parse_limits.max_depth = 4;
+  EXPECT_EQ(Demuxer(options).Init(photo_bytes).code(),
+            absl::StatusCode::kResourceExhausted);
+
+  options = DemuxerOptions();
+  options.parse_limits.max_attributes = 2;
+  EXPECT_EQ(Demuxer(options).Init(photo_bytes).code(),
+            absl::StatusCode::kResourceExhausted);
+}
+
+TEST(InformationExtraction, CanFailWhenXmpDeclaresEntities) {
+  std::string xmp_metadata =
+      GetXmp("1", "1", "500000", "image/jpeg", "video/mp4", "122562");
+  std::string photo_bytes = GetPhotoBytesFromXmp(
+      "<!DOCTYPE x:xmpmeta [<!ENTITY e 'e'>]>" + xmp_metadata);
+
+  Demuxer demuxer;
+  EXPECT_EQ(demuxer.Init(photo_bytes).code(),
+            absl::StatusCode::kResourceExhausted);
+}
+
+TEST(InformationExtraction, CanFailWhenXmpDoesNotMatchMpvdBox) {
+  std::string photo_bytes =
+      GetBytesFromFile("sample_data/heic_motion_photo/motion_photo.heic");
+  constexpr char kPadding[] = "Item:Padding=\"16\"";
+  photo_bytes.replace(photo_bytes.find(kPadding), strlen(kPadding),
+                      "Item:Padding=\"15\"");
+
+  Demuxer demuxer;
+  EXPECT_EQ(demuxer.Init(photo_bytes).code(), absl::StatusCode::kDataLoss);
+}
+
+TEST(InformationExtraction, CanInitFromACString) {
+  const char *motion_photo = "not a motion photo";
+
+  Demuxer demuxer;
+  EXPECT_EQ(demuxer.Init(motion_photo).code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+TEST(InformationExtraction, CanFailLazilyWhenNotAnImage) {
+  std::string video_bytes = GetBytesFromFile("sample_data/mp4/video.mp4");
+
+  DemuxerOptions options;
+  options.lazy_init = true;
+  Demuxer demuxer(options);
+  EXPECT_EQ(demuxer.Init(video_bytes).code(),
+            absl::StatusCode::kInvalidArgument);
 }
 
 TEST(InformationExtraction, CanParseValidMicrovideo) {
@@ -139,8 +237,8 @@ TEST(InformationExtraction, CanParseValidMicrovideo) {
   EXPECT_EQ(image_info.motion_photo_presentation_timestamp_us, -1);
   EXPECT_EQ(image_info.still_mime_type, MimeType::kImageJpeg);
   EXPECT_EQ(image_info.video_mime_type, MimeType::kVideoMp4);
-  EXPECT_EQ(image_info.video_length, 4182318);
-  EXPECT_EQ(image_info.still_padding, 0);
+  EXPECT_EQ(image_info.video_length, 4182318u);
+  EXPECT_EQ(image_info.still_padding, 0u);
 }
 
 TEST(InformationExtraction, CanFailOnInvalidXmp) {
@@ -0,0 +1,161 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "absl/base/internal/endian.h"
+#include "absl/strings/str_cat.h"
+#include "libmphoto/demuxer/demuxer.h"
+#include "libmphoto/demuxer/image_info.h"
+#include "tests/common/io_helper.h"
+
+namespace libmphoto {
+
+namespace {
+
+constexpr char kXmpSignature[] = "http://ns.adobe.com/xap/1.0/";
+constexpr char kSampleVideoLength[] = "Item:Length=\"122562\"";
+constexpr char kSamplePrimaryMime[] = "Item:Mime=\"image/jpeg\"";
+constexpr uint64_t kSampleVideoLengthValue = 122562;
+
+// A video length which puts both the video length and its offset past 4 GiB.
+constexpr uint64_t kLargeVideoLength = (5ull << 30) + 3;
+
+// Replaces from with to in the xmp of still, updating the length of the xmp
+// segment to match.
+void ReplaceInXmp(const std::string &from, const std::string &to,
+                  std::string *still) {
+  still->replace(still->find(from), from.length(), to);
+
+  size_t segment_length_pos = still->find(kXmpSignature) - 2;
+  uint16_t segment_length =
+      absl::big_endian::Load16(&(*still)[segment_length_pos]) + to.length() -
+      from.length();
+  absl::big_endian::Store16(&(*still)[segment_length_pos], segment_length);
+}
+
+// Returns the still of the sample jpeg motion photo with its xmp rewritten
+// to specify video_length.
+std::string GetStillWithVideoLength(uint64_t video_length) {
+  std::string motion_photo =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/motion_photo.jpeg");
+  std::string still =
+      motion_photo.substr(0, motion_photo.length() - kSampleVideoLengthValue);
+
+  ReplaceInXmp(kSampleVideoLength,
+               absl::StrCat("Item:Length=\"", video_length, "\""), &still);
+  return still;
+}
+
+// Creates a sparse file holding still followed by a video of video_length
+// bytes, of which only the leading bytes of the sample video are written.
+// Returns an empty path if the file system cannot hold the file.
+std::string CreateSparseMotionPhoto(const std::string &still,
+                                    uint64_t video_length) {
+  const char *tmp_dir = getenv("TEST_TMPDIR");
+  std::string path =
+      absl::StrCat(tmp_dir ? tmp_dir : "/tmp", "/large_motion_photo_XXXXXX");
+  int fd = mkstemp(&path[0]);
+  if (fd < 0) {
+    return "";
+  }
+
+  std::string video_header =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/video.mp4").substr(0, 64);
+  bool written =
+      ftruncate(fd, still.length() + video_length) == 0 &&
+      pwrite(fd, still.data(), still.length(), 0) ==
+          static_cast<ssize_t>(still.length()) &&
+      pwrite(fd, video_header.data(), video_header.length(), still.length()) ==
+          static_cast<ssize_t>(video_header.length());
+  close(fd);
+
+  if (!written) {
+    unlink(path.c_str());
+    return "";
+  }
+  return path;
+}
+
+}  // namespace
+
+TEST(LargeFile, CanDemuxAMotionPhotoLargerThan4GiB) {
+  std::string still = GetStillWithVideoLength(kLargeVideoLength);
+  std::string path = CreateSparseMotionPhoto(still, kLargeVideoLength);
+  if (path.empty()) {
+    GTEST_SKIP() << "File system cannot hold a sparse file larger than 4 GiB";
+  }
+
+  Demuxer demuxer;
+  EXPECT_TRUE(demuxer.InitFromFile(path).ok());
+
+  ImageInfo image_info;
+  EXPECT_TRUE(demuxer.GetInfo(&image_info).ok());
+  EXPECT_EQ(image_info.video_length, kLargeVideoLength);
+  EXPECT_EQ(image_info.still_padding, 0u);
+
+  absl::string_view still_view;
+  EXPECT_TRUE(demuxer.GetStillView(&still_view).ok());
+  EXPECT_EQ(still_view, still);
+
+  absl::string_view video_view;
+  EXPECT_TRUE(demuxer.GetVideoView(&video_view).ok());
+  EXPECT_EQ(video_view.length(), kLargeVideoLength);
+  EXPECT_EQ(video_view.data(), still_view.data() + still.length());
+
+  unlink(path.c_str());
+}
+
+TEST(LargeFile, CanProbeAMotionPhotoLargerThan4GiB) {
+  std::string still = GetStillWithVideoLength(kLargeVideoLength);
+
+  MotionPhotoLayout layout;
+  EXPECT_TRUE(
+      Demuxer::Probe(still, still.length() + kLargeVideoLength, &layout).ok());
+  EXPECT_EQ(layout.still_length, still.length());
+  EXPECT_EQ(layout.video_offset, still.length());
+  EXPECT_EQ(layout.video_length, kLargeVideoLength);
+}
+
+TEST(LargeFile, CanFailWhenVideoLengthExceedsTheFile) {
+  std::string still = GetStillWithVideoLength(UINT64_MAX);
+
+  MotionPhotoLayout layout;
+  EXPECT_EQ(Demuxer::Probe(still, still.length() + 1024, &layout).code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+TEST(LargeFile, CanFailWhenVideoLengthAndPaddingWouldOverflow) {
+  std::string still = GetStillWithVideoLength(kSampleVideoLengthValue);
+
+  // Each fits within the file alone, but their sum wraps around to zero.
+  uint64_t still_padding = UINT64_MAX - kSampleVideoLengthValue + 1;
+  ReplaceInXmp(kSamplePrimaryMime,
+               absl::StrCat(kSamplePrimaryMime, " Item:Padding=\"",
+                            still_padding, "\""),
+               &still);
+
+  MotionPhotoLayout layout;
+  EXPECT_EQ(Demuxer::Probe(still, still.length() + kSampleVideoLengthValue,
+                           &layout)
+                .code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+}  // namespace libmphoto
@@ -0,0 +1,145 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gtest/gtest.h"
+#include "libmphoto/demuxer/demuxer.h"
+#include "libmphoto/demuxer/motion_photo_layout.h"
+#include "tests/common/io_helper.h"
+
+namespace libmphoto {
+
+namespace {
+
+// Probes bytes from a prefix of initial_length, growing the prefix to the
+// reported required length until probing no longer needs more bytes.
+absl::Status ProbeWithGrowingPrefix(const std::string &bytes,
+                                    uint64_t initial_length,
+                                    MotionPhotoLayout *layout) {
+  uint64_t prefix_length = initial_length;
+  absl::Status status;
+  while (true) {
+    status = Demuxer::Probe(absl::string_view(bytes).substr(0, prefix_length),
+                            bytes.length(), layout);
+    if (!absl::IsOutOfRange(status) ||
+        layout->required_prefix_length <= prefix_length) {
+      return status;
+    }
+    prefix_length = layout->required_prefix_length;
+  }
+}
+
+}  // namespace
+
+TEST(Probe, CanProbeAValidJpegMotionPhoto) {
+  std::string motion_photo_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/motion_photo.jpeg");
+  std::string still_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/still.jpeg");
+
+  MotionPhotoLayout layout;
+  EXPECT_TRUE(
+      Demuxer::Probe(motion_photo_bytes, motion_photo_bytes.length(), &layout)
+          .ok());
+  EXPECT_EQ(layout.image_info.still_mime_type, MimeType::kImageJpeg);
+  EXPECT_EQ(layout.image_info.motion_photo_presentation_timestamp_us, 500000);
+  EXPECT_EQ(layout.still_offset, 0u);
+  EXPECT_EQ(layout.still_length, still_bytes.length());
+  EXPECT_EQ(layout.padding_length, 0u);
+  EXPECT_EQ(layout.video_length, 122562u);
+  EXPECT_EQ(layout.video_offset + layout.video_length,
+            motion_photo_bytes.length());
+}
+
+TEST(Probe, CanProbeAValidHeicMotionPhoto) {
+  std::string motion_photo_bytes =
+      GetBytesFromFile("sample_data/heic_motion_photo/motion_photo.heic");
+
+  MotionPhotoLayout layout;
+  EXPECT_TRUE(
+      Demuxer::Probe(motion_photo_bytes, motion_photo_bytes.length(), &layout)
+          .ok());
+  EXPECT_EQ(layout.image_info.still_mime_type, MimeType::kImageHeic);
+  EXPECT_EQ(layout.padding_offset, layout.still_length);
+  EXPECT_EQ(layout.padding_length, 16u);
+  EXPECT_EQ(layout.video_offset, layout.padding_offset + 16);
+  EXPECT_EQ(layout.video_length, 1544201u);
+}
+
+TEST(Probe, ReportsRequiredPrefixLengthForJpeg) {
+  std::string motion_photo_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/motion_photo.jpeg");
+
+  MotionPhotoLayout layout;
+  absl::Status status = Demuxer::Probe(
+      absl::string_view(motion_photo_bytes).substr(0, 64),
+      motion_photo_bytes.length(), &layout);
+  EXPECT_TRUE(absl::IsOutOfRange(status));
+  EXPECT_GT(layout.required_prefix_length, 64u);
+  EXPECT_LT(layout.required_prefix_length, motion_photo_bytes.length());
+
+  EXPECT_TRUE(ProbeWithGrowingPrefix(motion_photo_bytes, 64, &layout).ok());
+  EXPECT_EQ(layout.video_length, 122562u);
+}
+
+TEST(Probe, ReportsRequiredPrefixLengthForHeic) {
+  std::string motion_photo_bytes =
+      GetBytesFromFile("sample_data/heic_motion_photo/motion_photo.heic");
+
+  MotionPhotoLayout layout;
+  EXPECT_TRUE(ProbeWithGrowingPrefix(motion_photo_bytes, 16, &layout).ok());
+  EXPECT_LT(layout.required_prefix_length, motion_photo_bytes.length());
+  EXPECT_EQ(layout.video_length, 1544201u);
+}
+
+TEST(Probe, ReportsRequiredPrefixLengthOnSuccess) {
+  std::string motion_photo_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/motion_photo.jpeg");
+
+  MotionPhotoLayout layout;
+  EXPECT_TRUE(
+      Demuxer::Probe(motion_photo_bytes, motion_photo_bytes.length(), &layout)
+          .ok());
+  uint64_t required_prefix_length = layout.required_prefix_length;
+  EXPECT_LT(required_prefix_length, layout.still_length);
+
+  // The reported prefix is exactly long enough to probe the file.
+  absl::string_view prefix = motion_photo_bytes;
+  EXPECT_TRUE(Demuxer::Probe(prefix.substr(0, required_prefix_length),
+                             motion_photo_bytes.length(), &layout)
+                  .ok());
+  EXPECT_EQ(layout.required_prefix_length, required_prefix_length);
+  EXPECT_TRUE(absl::IsOutOfRange(
+      Demuxer::Probe(prefix.substr(0, required_prefix_length - 1),
+                     motion_photo_bytes.length(), &layout)));
+}
+
+TEST(Probe, ReportsRequiredPrefixLengthForAnEmptyPrefix) {
+  MotionPhotoLayout layout;
+  EXPECT_TRUE(absl::IsOutOfRange(Demuxer::Probe("", 1024, &layout)));
+  EXPECT_EQ(layout.required_prefix_length, 16u);
+}
+
+TEST(Probe, CanFailOnANonMotionPhoto) {
+  std::string video_bytes = GetBytesFromFile("sample_data/mp4/video.mp4");
+
+  MotionPhotoLayout layout;
+  EXPECT_FALSE(
+      Demuxer::Probe(video_bytes, video_bytes.length(), &layout).ok());
+}
+
+TEST(Probe, CanFailWhenLayoutIsNull) {
+  EXPECT_FALSE(Demuxer::Probe("", 0, nullptr).ok());
+}
+
+}  // namespace libmphoto
@@ -12,6 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <cstdio>
+
 #include "gtest/gtest.h"
 #include "libmphoto/demuxer/demuxer.h"
 #include "tests/common/io_helper.h"
@@ -60,12 +62,48 @@ TEST(StillDemuxing, CanDemuxAValidMicrovideo) {
   EXPECT_EQ(demuxed_still_bytes, correct_still_bytes) << "Bytes differ";
 }
 
+TEST(StillDemuxing, CanDemuxAStillViewWithoutCopy) {
+  std::string motion_photo_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/motion_photo.jpeg");
+  std::string correct_still_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/still.jpeg");
+
+  Demuxer demuxer;
+  EXPECT_TRUE(demuxer.InitWithoutCopy(motion_photo_bytes).ok());
+
+  absl::string_view demuxed_still;
+  EXPECT_TRUE(demuxer.GetStillView(&demuxed_still).ok());
+  EXPECT_EQ(demuxed_still, correct_still_bytes) << "Bytes differ";
+  EXPECT_EQ(demuxed_still.data(), motion_photo_bytes.data())
+      << "View does not point into the borrowed bytes";
+}
+
+TEST(StillDemuxing, CanWriteStillFromFileToFd) {
+  std::string correct_still_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/still.jpeg");
+
+  Demuxer demuxer;
+  EXPECT_TRUE(
+      demuxer.InitFromFile("sample_data/jpeg_motion_photo/motion_photo.jpeg")
+          .ok());
+
+  FILE *still_file = tmpfile();
+  EXPECT_TRUE(demuxer.GetStillTo(fileno(still_file)).ok());
+  EXPECT_EQ(GetBytesFromFd(fileno(still_file)), correct_still_bytes)
+      << "Bytes differ";
+  fclose(still_file);
+}
+
 TEST(StillDemuxing, CanFailWhenDemuxerNotInitialzed) {
   Demuxer demuxer;
   std::string demuxed_still_bytes;
 
   EXPECT_EQ(demuxer.GetStill(&demuxed_still_bytes).code(),
             absl::StatusCode::kFailedPrecondition);
+
+  absl::string_view demuxed_still;
+  EXPECT_EQ(demuxer.GetStillView(&demuxed_still).code(),
+            absl::StatusCode::kFailedPrecondition);
 }
 
 }  // namespace libmphoto
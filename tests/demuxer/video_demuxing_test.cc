@@ -12,7 +12,13 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdio>
+
 #include "gtest/gtest.h"
+#include "libmphoto/common/byte_source.h"
 #include "libmphoto/demuxer/demuxer.h"
 #include "tests/common/io_helper.h"
 
@@ -32,6 +38,32 @@ TEST(VideoDemuxing, CanDemuxAValidHeicMotionPhoto) {
   EXPECT_EQ(demuxed_video_bytes, correct_video_bytes) << "Bytes differ";
 }
 
+TEST(VideoDemuxing, CanDemuxAHeicMotionPhotoWithDamagedXmp) {
+  std::string motion_photo_bytes =
+      GetBytesFromFile("sample_data/heic_motion_photo/motion_photo.heic");
+  std::string correct_video_bytes =
+      GetBytesFromFile("sample_data/heic_motion_photo/video.mp4");
+  motion_photo_bytes.replace(motion_photo_bytes.find("<x:xmpmeta"), 10,
+                             "<x:xmpmetX");
+
+  Demuxer demuxer;
+  EXPECT_FALSE(demuxer.Init(motion_photo_bytes).ok());
+
+  DemuxerOptions options;
+  options.allow_missing_xmp = true;
+  Demuxer container_demuxer(options);
+  EXPECT_TRUE(container_demuxer.Init(motion_photo_bytes).ok());
+
+  std::string demuxed_video_bytes;
+  EXPECT_TRUE(container_demuxer.GetVideo(&demuxed_video_bytes).ok());
+  EXPECT_EQ(demuxed_video_bytes, correct_video_bytes) << "Bytes differ";
+
+  ImageInfo image_info;
+  EXPECT_TRUE(container_demuxer.GetInfo(&image_info).ok());
+  EXPECT_EQ(image_info.still_padding, 16u);
+  EXPECT_EQ(image_info.motion_photo_presentation_timestamp_us, -1);
+}
+
 TEST(VideoDemuxing, CanDemuxAValidJpegMotionPhoto) {
   std::string motion_photo_bytes =
       GetBytesFromFile("sample_data/jpeg_motion_photo/motion_photo.jpeg");
@@ -60,12 +92,176 @@ TEST(VideoDemuxing, CanDemuxAValidMicrovideo) {
   EXPECT_EQ(demuxed_video_bytes, correct_video_bytes) << "Bytes differ";
 }
 
+TEST(VideoDemuxing, CanDemuxAVideoViewWithoutCopy) {
+  std::string motion_photo_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/motion_photo.jpeg");
+  std::string correct_video_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/video.mp4");
+
+  Demuxer demuxer;
+  EXPECT_TRUE(demuxer.InitWithoutCopy(motion_photo_bytes).ok());
+
+  absl::string_view demuxed_video;
+  EXPECT_TRUE(demuxer.GetVideoView(&demuxed_video).ok());
+  EXPECT_EQ(demuxed_video, correct_video_bytes) << "Bytes differ";
+  EXPECT_EQ(demuxed_video.data() + demuxed_video.length(),
+            motion_photo_bytes.data() + motion_photo_bytes.length())
+      << "View does not point into the borrowed bytes";
+}
+
+TEST(VideoDemuxing, CanDemuxAVideoViewFromAdoptedBytes) {
+  std::string correct_video_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/video.mp4");
+
+  Demuxer demuxer;
+  EXPECT_TRUE(
+      demuxer
+          .InitWithOwnership(GetBytesFromFile(
+              "sample_data/jpeg_motion_photo/motion_photo.jpeg"))
+          .ok());
+
+  absl::string_view demuxed_video;
+  EXPECT_TRUE(demuxer.GetVideoView(&demuxed_video).ok());
+  EXPECT_EQ(demuxed_video, correct_video_bytes) << "Bytes differ";
+}
+
+TEST(VideoDemuxing, CanDemuxAValidJpegMotionPhotoFromFile) {
+  std::string correct_video_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/video.mp4");
+
+  Demuxer demuxer;
+  EXPECT_TRUE(
+      demuxer.InitFromFile("sample_data/jpeg_motion_photo/motion_photo.jpeg")
+          .ok());
+
+  absl::string_view demuxed_video;
+  EXPECT_TRUE(demuxer.GetVideoView(&demuxed_video).ok());
+  EXPECT_EQ(demuxed_video, correct_video_bytes) << "Bytes differ";
+}
+
+TEST(VideoDemuxing, CanWriteVideoFromFileToFd) {
+  std::string correct_video_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/video.mp4");
+
+  Demuxer demuxer;
+  EXPECT_TRUE(
+      demuxer.InitFromFile("sample_data/jpeg_motion_photo/motion_photo.jpeg")
+          .ok());
+
+  FILE *video_file = tmpfile();
+  EXPECT_TRUE(demuxer.GetVideoTo(fileno(video_file)).ok());
+  EXPECT_EQ(GetBytesFromFd(fileno(video_file)), correct_video_bytes)
+      << "Bytes differ";
+  fclose(video_file);
+}
+
+TEST(VideoDemuxing, CanWriteVideoFromMemoryToFd) {
+  std::string motion_photo_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/motion_photo.jpeg");
+  std::string correct_video_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/video.mp4");
+
+  Demuxer demuxer;
+  EXPECT_TRUE(demuxer.InitWithoutCopy(motion_photo_bytes).ok());
+
+  FILE *video_file = tmpfile();
+  EXPECT_TRUE(demuxer.GetVideoTo(fileno(video_file)).ok());
+  EXPECT_EQ(GetBytesFromFd(fileno(video_file)), correct_video_bytes)
+      << "Bytes differ";
+  fclose(video_file);
+}
+
+TEST(VideoDemuxing, CanWriteVideoFromFileToAppendingFd) {
+  std::string correct_video_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/video.mp4");
+
+  Demuxer demuxer;
+  EXPECT_TRUE(
+      demuxer.InitFromFile("sample_data/jpeg_motion_photo/motion_photo.jpeg")
+          .ok());
+
+  FILE *video_file = tmpfile();
+  int video_fd = fileno(video_file);
+  ASSERT_EQ(fcntl(video_fd, F_SETFL, fcntl(video_fd, F_GETFL) | O_APPEND), 0);
+  EXPECT_TRUE(demuxer.GetVideoTo(video_fd).ok());
+  EXPECT_EQ(GetBytesFromFd(video_fd), correct_video_bytes) << "Bytes differ";
+  fclose(video_file);
+}
+
+TEST(VideoDemuxing, CanFailToWriteVideoToABadFd) {
+  Demuxer demuxer;
+  EXPECT_TRUE(
+      demuxer.InitFromFile("sample_data/jpeg_motion_photo/motion_photo.jpeg")
+          .ok());
+
+  EXPECT_FALSE(demuxer.GetVideoTo(-1).ok());
+}
+
+TEST(VideoDemuxing, CanWriteVideoToSink) {
+  std::string correct_video_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/video.mp4");
+
+  std::unique_ptr<FileByteSource> source;
+  EXPECT_TRUE(FileByteSource::Open(
+                  "sample_data/jpeg_motion_photo/motion_photo.jpeg", &source)
+                  .ok());
+
+  Demuxer demuxer;
+  EXPECT_TRUE(demuxer.InitFromSource(std::move(source)).ok());
+
+  std::string demuxed_video_bytes;
+  EXPECT_TRUE(demuxer
+                  .GetVideoTo([&demuxed_video_bytes](absl::string_view bytes) {
+                    demuxed_video_bytes.append(bytes.data(), bytes.length());
+                    return absl::OkStatus();
+                  })
+                  .ok());
+  EXPECT_EQ(demuxed_video_bytes, correct_video_bytes) << "Bytes differ";
+}
+
+TEST(VideoDemuxing, CanFailWhenFileDoesNotExist) {
+  Demuxer demuxer;
+  EXPECT_EQ(demuxer.InitFromFile("sample_data/does_not_exist.jpeg").code(),
+            absl::StatusCode::kNotFound);
+
+  std::string demuxed_video_bytes;
+  EXPECT_EQ(demuxer.GetVideo(&demuxed_video_bytes).code(),
+            absl::StatusCode::kFailedPrecondition);
+}
+
+TEST(VideoDemuxing, CanReuseDemuxerAfterReset) {
+  std::string motion_photo_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/motion_photo.jpeg");
+  std::string correct_video_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/video.mp4");
+
+  Demuxer demuxer;
+  std::string demuxed_video_bytes;
+  EXPECT_TRUE(demuxer.Init(motion_photo_bytes).ok());
+  EXPECT_TRUE(demuxer.GetVideo(&demuxed_video_bytes).ok());
+
+  demuxer.Reset();
+  EXPECT_EQ(demuxer.GetVideo(&demuxed_video_bytes).code(),
+            absl::StatusCode::kFailedPrecondition);
+
+  EXPECT_TRUE(demuxer.InitWithoutCopy(motion_photo_bytes).ok());
+  EXPECT_TRUE(demuxer.GetVideo(&demuxed_video_bytes).ok());
+  EXPECT_EQ(demuxed_video_bytes, correct_video_bytes) << "Bytes differ";
+}
+
 TEST(VideoDemuxing, CanFailWhenDemuxerNotInitialzed) {
   Demuxer demuxer;
   std::string demuxed_video_bytes;
 
   EXPECT_EQ(demuxer.GetVideo(&demuxed_video_bytes).code(),
             absl::StatusCode::kFailedPrecondition);
+
+  absl::string_view demuxed_video;
+  EXPECT_EQ(demuxer.GetVideoView(&demuxed_video).code(),
+            absl::StatusCode::kFailedPrecondition);
+
+  EXPECT_EQ(demuxer.GetVideoTo(STDOUT_FILENO).code(),
+            absl::StatusCode::kFailedPrecondition);
 }
 
 }  // namespace libmphoto
@@ -0,0 +1,213 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "absl/strings/str_cat.h"
+#include "libmphoto/common/xmp_io/xmp_io_helper.h"
+#include "libmphoto/demuxer/image_info.h"
+#include "libmphoto/demuxer/xmp_image_info_reader.h"
+#include "tests/common/io_helper.h"
+
+namespace libmphoto {
+
+namespace {
+
+constexpr char kMotionPhotoXmp[] =
+    "<?xpacket begin='' id='W5M0MpCehiHzreSzNTczkc9d'?>\n"
+    "<x:xmpmeta xmlns:x='adobe:ns:meta/'>\n"
+    " <rdf:RDF xmlns:rdf='http://www.w3.org/1999/02/22-rdf-syntax-ns#'>\n"
+    "  <!-- The directory lists the still first. -->\n"
+    "  <rdf:Description\n"
+    "      xmlns:Camera='http://ns.google.com/photos/1.0/camera/'\n"
+    "      xmlns:Container='http://ns.google.com/photos/1.0/container/'\n"
+    "      xmlns:Item='http://ns.google.com/photos/1.0/container/item/'\n"
+    "      Camera:MotionPhoto='1' Camera:MotionPhotoVersion='1'\n"
+    "      Camera:MotionPhotoPresentationTimestampUs='500000'>\n"
+    "   <Container:Directory>\n"
+    "    <rdf:Seq>\n"
+    "     <rdf:li rdf:parseType='Resource'>\n"
+    "      <Container:Item Item:Mime='image/jpeg' Item:Semantic='Primary'\n"
+    "          Item:Length='0' Item:Padding='16'/>\n"
+    "     </rdf:li>\n"
+    "     <rdf:li rdf:parseType='Resource'>\n"
+    "      <Container:Item Item:Mime='video/mp4' Item:Semantic='MotionPhoto'\n"
+    "          Item:Length='122562' Item:Padding='0'/>\n"
+    "     </rdf:li>\n"
+    "    </rdf:Seq>\n"
+    "   </Container:Directory>\n"
+    "  </rdf:Description>\n"
+    " </rdf:RDF>\n"
+    "</x:xmpmeta>\n"
+    "<?xpacket end='w'?>";
+
+// The same metadata with other prefixes, a default namespace and the fields
+// split across descriptions and list entries.
+constexpr char kRenamedMotionPhotoXmp[] =
+    "<meta:xmpmeta xmlns:meta='adobe:ns:meta/'>"
+    "<RDF xmlns='http://www.w3.org/1999/02/22-rdf-syntax-ns#'"
+    "    xmlns:c='http://ns.google.com/photos/1.0/camera/'>"
+    "<Description c:MotionPhoto='1'/>"
+    "<Description c:MotionPhotoVersion='1'"
+    "    c:MotionPhotoPresentationTimestampUs='-1'>"
+    "<d:Directory xmlns:d='http://ns.google.com/photos/1.0/container/'"
+    "    xmlns:i='http://ns.google.com/photos/1.0/container/item/'>"
+    "<Seq><Bag/><li><d:Item i:Mime='IMAGE/HEIC'/></li>"
+    "<li><d:Item i:Length='100'/><d:Item i:Mime='video/mp4'/></li></Seq>"
+    "</d:Directory></Description></RDF></meta:xmpmeta>";
+
+constexpr char kMicrovideoXmp[] =
+    "<x:xmpmeta xmlns:x=\"adobe:ns:meta/\">"
+    "<rdf:RDF xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\">"
+    "<rdf:Description"
+    " xmlns:GCamera=\"http://ns.google.com/photos/1.0/camera/\""
+    " GCamera:MicroVideo=\"1\" GCamera:MicroVideoVersion=\"1\""
+    " GCamera:MicroVideoOffset=\"4242\""
+    " GCamera:MicroVideoPresentationTimestampUs=\"200\"/>"
+    "</rdf:RDF></x:xmpmeta>";
+
+}  // namespace
+
+TEST(XmpImageInfoReader, CanReadMotionPhotoFields) {
+  ImageInfo image_info;
+  EXPECT_TRUE(ReadImageInfoFromXmp(kMotionPhotoXmp, &image_info).ok());
+  EXPECT_EQ(image_info.motion_photo, 1);
+  EXPECT_EQ(image_info.motion_photo_version, 1);
+  EXPECT_EQ(image_info.motion_photo_presentation_timestamp_us, 500000);
+  EXPECT_EQ(image_info.still_mime_type, MimeType::kImageJpeg);
+  EXPECT_EQ(image_info.video_mime_type, MimeType::kVideoMp4);
+  EXPECT_EQ(image_info.video_length, 122562u);
+  EXPECT_EQ(image_info.still_padding, 16u);
+}
+
+TEST(XmpImageInfoReader, CanReadFieldsByNamespaceRatherThanPrefix) {
+  ImageInfo image_info;
+  EXPECT_TRUE(ReadImageInfoFromXmp(kRenamedMotionPhotoXmp, &image_info).ok());
+  EXPECT_EQ(image_info.motion_photo, 1);
+  EXPECT_EQ(image_info.motion_photo_presentation_timestamp_us, -1);
+  EXPECT_EQ(image_info.still_mime_type, MimeType::kImageHeic);
+  EXPECT_EQ(image_info.video_mime_type, MimeType::kVideoMp4);
+  EXPECT_EQ(image_info.video_length, 100u);
+  EXPECT_EQ(image_info.still_padding, 0u);
+}
+
+TEST(XmpImageInfoReader, CanReadMicrovideoFields) {
+  ImageInfo image_info;
+  EXPECT_TRUE(ReadImageInfoFromXmp(kMicrovideoXmp, &image_info).ok());
+  EXPECT_EQ(image_info.motion_photo, 1);
+  EXPECT_EQ(image_info.motion_photo_presentation_timestamp_us, 200);
+  EXPECT_EQ(image_info.still_mime_type, MimeType::kImageJpeg);
+  EXPECT_EQ(image_info.video_mime_type, MimeType::kVideoMp4);
+  EXPECT_EQ(image_info.video_length, 4242u);
+  EXPECT_EQ(image_info.still_padding, 0u);
+}
+
+TEST(XmpImageInfoReader, MatchesTheDocumentPathForSampleData) {
+  for (const char *path : {"sample_data/jpeg_motion_photo/motion_photo.jpeg",
+                           "sample_data/heic_motion_photo/motion_photo.heic"}) {
+    std::string motion_photo = GetBytesFromFile(path);
+    MemoryByteSource source(motion_photo);
+    IXmpIOHelper *xmp_io_helper = GetXmpIOHelper(motion_photo);
+    ASSERT_NE(xmp_io_helper, nullptr);
+
+    std::string scratch;
+    absl::string_view xmp;
+    ASSERT_TRUE(xmp_io_helper->ReadXmpPacket(&source, &scratch, &xmp).ok());
+    EXPECT_TRUE(scratch.empty());
+
+    ImageInfo image_info;
+    EXPECT_TRUE(ReadImageInfoFromXmp(xmp, &image_info).ok());
+    EXPECT_EQ(image_info.motion_photo, 1);
+    EXPECT_EQ(image_info.video_mime_type, MimeType::kVideoMp4);
+    EXPECT_GT(image_info.video_length, 0u);
+  }
+}
+
+TEST(XmpImageInfoReader, FailsWithoutRequiredFields) {
+  std::string xmp = kMotionPhotoXmp;
+  xmp.replace(xmp.find("Item:Length='122562'"), 20, "Item:Length=''");
+
+  ImageInfo image_info;
+  EXPECT_FALSE(ReadImageInfoFromXmp(xmp, &image_info).ok());
+
+  xmp = kMotionPhotoXmp;
+  xmp.replace(xmp.find("Camera:MotionPhoto='1'"), 22, "");
+  EXPECT_FALSE(ReadImageInfoFromXmp(xmp, &image_info).ok());
+}
+
+TEST(XmpImageInfoReader, FailsOnMalformedFields) {
+  std::string xmp = kMotionPhotoXmp;
+  xmp.replace(xmp.find("'500000'"), 8, "'soon'");
+
+  ImageInfo image_info;
+  EXPECT_EQ(ReadImageInfoFromXmp(xmp, &image_info).code(),
+            absl::StatusCode::kInvalidArgument);
+
+  // An empty field is present, as with the xpath lookups, so an empty
+  // optional padding is malformed rather than absent.
+  xmp = kMotionPhotoXmp;
+  xmp.replace(xmp.find("Item:Padding='16'"), 17, "Item:Padding=''");
+  EXPECT_EQ(ReadImageInfoFromXmp(xmp, &image_info).code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+TEST(XmpImageInfoReader, FailsOnMalformedXml) {
+  ImageInfo image_info;
+  std::string xmp = kMotionPhotoXmp;
+  for (const char *malformed :
+       {"</rdf:Seq>", "</x:xmpmeta>", "Item:Padding='16'/>"}) {
+    std::string truncated = xmp;
+    truncated.erase(truncated.find(malformed), 1);
+    EXPECT_FALSE(ReadImageInfoFromXmp(truncated, &image_info).ok())
+        << malformed;
+  }
+
+  EXPECT_FALSE(
+      ReadImageInfoFromXmp(absl::StrCat(xmp, "<extra/>"), &image_info).ok());
+  EXPECT_FALSE(ReadImageInfoFromXmp(xmp.substr(0, xmp.length() / 2),
+                                    &image_info)
+                   .ok());
+}
+
+TEST(XmpImageInfoReader, LeavesUnsupportedXmlToTheDocumentPath) {
+  std::string xmp = kMotionPhotoXmp;
+  xmp.replace(xmp.find("'image/jpeg'"), 12, "'image&#47;jpeg'");
+
+  ImageInfo image_info;
+  EXPECT_EQ(ReadImageInfoFromXmp(xmp, &image_info).code(),
+            absl::StatusCode::kUnimplemented);
+  EXPECT_EQ(ReadImageInfoFromXmp(absl::StrCat("<!DOCTYPE x>", kMotionPhotoXmp),
+                                 &image_info)
+                .code(),
+            absl::StatusCode::kUnimplemented);
+}
+
+TEST(XmpImageInfoReader, FailsOnXmpExceedingLimits) {
+  ImageInfo image_info;
+  ParseLimits limits;
+  EXPECT_TRUE(ReadImageInfoFromXmp(kMotionPhotoXmp, limits, &image_info).ok());
+
+  limits.max_depth = 6;
+  EXPECT_EQ(ReadImageInfoFromXmp(kMotionPhotoXmp, limits, &image_info).code(),
+            absl::StatusCode::kResourceExhausted);
+
+  limits = ParseLimits();
+  limits.max_xmp_bytes = 16;
+  EXPECT_EQ(ReadImageInfoFromXmp(kMotionPhotoXmp, limits, &image_info).code(),
+            absl::StatusCode::kResourceExhausted);
+}
+
+}  // namespace libmphoto
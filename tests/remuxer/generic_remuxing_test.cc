@@ -12,7 +12,15 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
 #include "gtest/gtest.h"
+#include "libmphoto/common/fd_io.h"
 #include "libmphoto/demuxer/demuxer.h"
 #include "libmphoto/remuxer/remuxer.h"
 #include "tests/common/io_helper.h"
@@ -41,6 +49,302 @@ TEST(GenericRemuxing, CanFailIfVideoNotSet) {
             absl::StatusCode::kFailedPrecondition);
 }
 
+TEST(GenericRemuxing, CanFailIfStillNotSetAfterReset) {
+  std::string still_bytes = GetBytesFromFile("sample_data/jpeg/no_xmp.jpeg");
+  std::string video_bytes = GetBytesFromFile("sample_data/mp4/video.mp4");
+
+  Remuxer remuxer;
+  EXPECT_TRUE(remuxer.SetStill(still_bytes).ok());
+  EXPECT_TRUE(remuxer.SetVideo(video_bytes).ok());
+  remuxer.Reset();
+
+  std::string motion_photo;
+  EXPECT_EQ(remuxer.Finalize(&motion_photo).code(),
+            absl::StatusCode::kFailedPrecondition);
+}
+
+TEST(GenericRemuxing, CanReuseRemuxerAfterReset) {
+  std::string still_bytes = GetBytesFromFile("sample_data/jpeg/no_xmp.jpeg");
+  std::string video_bytes = GetBytesFromFile("sample_data/mp4/video.mp4");
+
+  Remuxer remuxer;
+  EXPECT_TRUE(remuxer.SetStill(still_bytes, 35).ok());
+  EXPECT_TRUE(remuxer.SetVideo(video_bytes).ok());
+  std::string first_motion_photo;
+  EXPECT_TRUE(remuxer.Finalize(&first_motion_photo).ok());
+
+  remuxer.Reset();
+  EXPECT_TRUE(remuxer.SetStill(still_bytes, 35).ok());
+  EXPECT_TRUE(remuxer.SetVideo(video_bytes).ok());
+  std::string second_motion_photo;
+  EXPECT_TRUE(remuxer.Finalize(&second_motion_photo).ok());
+
+  EXPECT_EQ(first_motion_photo, second_motion_photo) << "Bytes differ";
+}
+
+TEST(GenericRemuxing, CanRemuxReusingXmlParser) {
+  std::string still_bytes =
+      GetBytesFromFile("sample_data/jpeg/existing_xmp.jpeg");
+  std::string video_bytes = GetBytesFromFile("sample_data/mp4/video.mp4");
+
+  Remuxer remuxer;
+  EXPECT_TRUE(remuxer.SetStill(still_bytes).ok());
+  EXPECT_TRUE(remuxer.SetVideo(video_bytes).ok());
+  std::string expected_motion_photo;
+  EXPECT_TRUE(remuxer.Finalize(&expected_motion_photo).ok());
+
+  RemuxerOptions options;
+  options.reuse_xml_parser = true;
+  Remuxer reusing_remuxer(options);
+  for (int i = 0; i < 2; i++) {
+    reusing_remuxer.Reset();
+    EXPECT_TRUE(reusing_remuxer.SetStill(still_bytes).ok());
+    EXPECT_TRUE(reusing_remuxer.SetVideo(video_bytes).ok());
+    std::string motion_photo;
+    EXPECT_TRUE(reusing_remuxer.Finalize(&motion_photo).ok());
+    EXPECT_EQ(motion_photo, expected_motion_photo) << "Bytes differ";
+  }
+}
+
+TEST(GenericRemuxing, CanFailIfStillXmpExceedsParseLimits) {
+  std::string still_bytes =
+      GetBytesFromFile("sample_data/jpeg/existing_xmp.jpeg");
+  std::string video_bytes = GetBytesFromFile("sample_data/mp4/video.mp4");
+
+  RemuxerOptions options;
+  options.parse_limits.max_depth = 2;
+  Remuxer remuxer(options);
+  EXPECT_TRUE(remuxer.SetStill(still_bytes).ok());
+  EXPECT_TRUE(remuxer.SetVideo(video_bytes).ok());
+
+  std::string motion_photo;
+  EXPECT_EQ(remuxer.Finalize(&motion_photo).code(),
+            absl::StatusCode::kResourceExhausted);
+}
+
+TEST(GenericRemuxing, CanRemuxToSegmentsWithoutCopy) {
+  std::string still_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/still.jpeg");
+  std::string video_bytes = GetBytesFromFile("sample_data/mp4/video.mp4");
+
+  Remuxer remuxer;
+  EXPECT_TRUE(remuxer.SetStill(still_bytes).ok());
+  EXPECT_TRUE(remuxer.SetVideo(video_bytes).ok());
+  std::string motion_photo;
+  EXPECT_TRUE(remuxer.Finalize(&motion_photo).ok());
+
+  Remuxer borrowing_remuxer;
+  EXPECT_TRUE(borrowing_remuxer.SetStillWithoutCopy(still_bytes).ok());
+  EXPECT_TRUE(borrowing_remuxer.SetVideoWithoutCopy(video_bytes).ok());
+  std::vector<absl::string_view> segments;
+  EXPECT_TRUE(borrowing_remuxer.Finalize(&segments).ok());
+
+  // The video is borrowed rather than copied.
+  ASSERT_FALSE(segments.empty());
+  EXPECT_EQ(segments.back().data(), video_bytes.data());
+
+  std::string concatenated;
+  for (absl::string_view segment : segments) {
+    concatenated.append(segment.data(), segment.length());
+  }
+  EXPECT_EQ(concatenated, motion_photo) << "Bytes differ";
+}
+
+TEST(GenericRemuxing, CanRemuxToFd) {
+  std::string still_bytes = GetBytesFromFile("sample_data/jpeg/no_xmp.jpeg");
+  std::string video_bytes = GetBytesFromFile("sample_data/mp4/video.mp4");
+
+  Remuxer remuxer;
+  EXPECT_TRUE(remuxer.SetStill(still_bytes, 35).ok());
+  EXPECT_TRUE(remuxer.SetVideo(video_bytes).ok());
+
+  FILE *motion_photo_file = tmpfile();
+  EXPECT_TRUE(remuxer.FinalizeToFd(fileno(motion_photo_file)).ok());
+  EXPECT_EQ(GetBytesFromFd(fileno(motion_photo_file)),
+            GetBytesFromFile("sample_data/remuxed/jpeg/no_xmp.jpeg"))
+      << "Bytes differ";
+  fclose(motion_photo_file);
+}
+
+TEST(GenericRemuxing, CanRemuxVideoFromFileToFd) {
+  std::string still_bytes = GetBytesFromFile("sample_data/jpeg/no_xmp.jpeg");
+
+  Remuxer remuxer;
+  EXPECT_TRUE(remuxer.SetStill(still_bytes, 35).ok());
+  EXPECT_TRUE(remuxer.SetVideoFromFile("sample_data/mp4/video.mp4").ok());
+
+  FILE *motion_photo_file = tmpfile();
+  EXPECT_TRUE(remuxer.FinalizeToFd(fileno(motion_photo_file)).ok());
+  EXPECT_EQ(GetBytesFromFd(fileno(motion_photo_file)),
+            GetBytesFromFile("sample_data/remuxed/jpeg/no_xmp.jpeg"))
+      << "Bytes differ";
+  fclose(motion_photo_file);
+}
+
+TEST(GenericRemuxing, CanRemuxVideoFromFdToString) {
+  std::string still_bytes = GetBytesFromFile("sample_data/jpeg/no_xmp.jpeg");
+  int video_fd = open("sample_data/mp4/video.mp4", O_RDONLY);
+  ASSERT_GE(video_fd, 0);
+
+  Remuxer remuxer;
+  EXPECT_TRUE(remuxer.SetStill(still_bytes, 35).ok());
+  EXPECT_TRUE(remuxer.SetVideoFromFd(video_fd).ok());
+
+  std::string motion_photo;
+  EXPECT_TRUE(remuxer.Finalize(&motion_photo).ok());
+  EXPECT_EQ(motion_photo,
+            GetBytesFromFile("sample_data/remuxed/jpeg/no_xmp.jpeg"))
+      << "Bytes differ";
+
+  // A video read from a file has no segment to view it.
+  std::vector<absl::string_view> segments;
+  EXPECT_EQ(remuxer.Finalize(&segments).code(),
+            absl::StatusCode::kFailedPrecondition);
+  close(video_fd);
+}
+
+TEST(GenericRemuxing, CanRemuxVideoFromFileToFdForCloning) {
+  std::string still_bytes = GetBytesFromFile("sample_data/jpeg/no_xmp.jpeg");
+  std::string video_bytes = GetBytesFromFile("sample_data/mp4/video.mp4");
+
+  RemuxerOptions options;
+  options.clone_video = true;
+  Remuxer remuxer(options);
+  EXPECT_TRUE(remuxer.SetStill(still_bytes, 35).ok());
+  EXPECT_TRUE(remuxer.SetVideoFromFile("sample_data/mp4/video.mp4").ok());
+
+  FILE *motion_photo_file = tmpfile();
+  EXPECT_TRUE(remuxer.FinalizeToFd(fileno(motion_photo_file)).ok());
+  std::string motion_photo = GetBytesFromFd(fileno(motion_photo_file));
+  uint64_t block_size = GetFdBlockSize(fileno(motion_photo_file));
+  fclose(motion_photo_file);
+
+  // The still is padded so the video starts on a block boundary.
+  ASSERT_GT(block_size, 0u);
+  EXPECT_EQ((motion_photo.length() - video_bytes.length()) % block_size, 0u);
+
+  Demuxer demuxer;
+  EXPECT_TRUE(demuxer.Init(motion_photo).ok());
+  ImageInfo image_info;
+  EXPECT_TRUE(demuxer.GetInfo(&image_info).ok());
+  EXPECT_EQ(image_info.motion_photo_presentation_timestamp_us, 35);
+  EXPECT_EQ(image_info.video_length, video_bytes.length());
+
+  std::string demuxed_video_bytes;
+  EXPECT_TRUE(demuxer.GetVideo(&demuxed_video_bytes).ok());
+  EXPECT_EQ(demuxed_video_bytes, video_bytes) << "Bytes differ";
+}
+
+TEST(GenericRemuxing, CanRemuxWritingXmpInPlace) {
+  std::string still_bytes =
+      GetBytesFromFile("sample_data/jpeg/existing_xmp.jpeg");
+  std::string video_bytes = GetBytesFromFile("sample_data/mp4/video.mp4");
+
+  RemuxerOptions options;
+  options.write_xmp_in_place = true;
+  Remuxer remuxer(options);
+  EXPECT_TRUE(remuxer.SetStill(still_bytes, 35).ok());
+  EXPECT_TRUE(remuxer.SetVideo(video_bytes).ok());
+
+  // The xmp fits in the padding of the existing packet.
+  std::string motion_photo;
+  EXPECT_TRUE(remuxer.Finalize(&motion_photo).ok());
+  EXPECT_EQ(motion_photo.length(), still_bytes.length() + video_bytes.length());
+
+  Demuxer demuxer;
+  EXPECT_TRUE(demuxer.Init(motion_photo).ok());
+  ImageInfo image_info;
+  EXPECT_TRUE(demuxer.GetInfo(&image_info).ok());
+  EXPECT_EQ(image_info.motion_photo_presentation_timestamp_us, 35);
+  EXPECT_EQ(image_info.video_length, video_bytes.length());
+
+  std::string demuxed_video_bytes;
+  EXPECT_TRUE(demuxer.GetVideo(&demuxed_video_bytes).ok());
+  EXPECT_EQ(demuxed_video_bytes, video_bytes) << "Bytes differ";
+}
+
+TEST(GenericRemuxing, CanRemuxByStreamingVideo) {
+  std::string still_bytes =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/still.jpeg");
+  std::string video_bytes = GetBytesFromFile("sample_data/mp4/video.mp4");
+
+  FILE *motion_photo_file = tmpfile();
+  Remuxer remuxer;
+  EXPECT_TRUE(remuxer.Begin(still_bytes, 12, fileno(motion_photo_file)).ok());
+  // Chunks smaller than the video header are checked once it is complete.
+  for (size_t offset = 0; offset < video_bytes.length(); offset += 10) {
+    EXPECT_TRUE(
+        remuxer.AppendVideo(absl::string_view(video_bytes).substr(offset, 10))
+            .ok());
+  }
+  EXPECT_TRUE(remuxer.End().ok());
+  std::string motion_photo = GetBytesFromFd(fileno(motion_photo_file));
+  fclose(motion_photo_file);
+
+  Demuxer demuxer;
+  EXPECT_TRUE(demuxer.Init(motion_photo).ok());
+  ImageInfo image_info;
+  EXPECT_TRUE(demuxer.GetInfo(&image_info).ok());
+  EXPECT_EQ(image_info.motion_photo_presentation_timestamp_us, 12);
+  EXPECT_EQ(image_info.video_length, video_bytes.length());
+
+  std::string demuxed_video_bytes;
+  EXPECT_TRUE(demuxer.GetVideo(&demuxed_video_bytes).ok());
+  EXPECT_EQ(demuxed_video_bytes, video_bytes) << "Bytes differ";
+}
+
+TEST(GenericRemuxing, CanFailToStreamWithoutBegin) {
+  Remuxer remuxer;
+  EXPECT_EQ(remuxer.AppendVideo("video").code(),
+            absl::StatusCode::kFailedPrecondition);
+  EXPECT_EQ(remuxer.End().code(), absl::StatusCode::kFailedPrecondition);
+}
+
+TEST(GenericRemuxing, CanFailToStreamToAPipe) {
+  std::string still_bytes = GetBytesFromFile("sample_data/jpeg/no_xmp.jpeg");
+  int pipe_fds[2];
+  ASSERT_EQ(pipe(pipe_fds), 0);
+
+  Remuxer remuxer;
+  EXPECT_EQ(remuxer.Begin(still_bytes, 0, pipe_fds[1]).code(),
+            absl::StatusCode::kInvalidArgument);
+  close(pipe_fds[0]);
+  close(pipe_fds[1]);
+}
+
+TEST(GenericRemuxing, CanFailToStreamAHeicStill) {
+  std::string still_bytes =
+      GetBytesFromFile("sample_data/heic_motion_photo/still.heic");
+
+  FILE *motion_photo_file = tmpfile();
+  Remuxer remuxer;
+  EXPECT_EQ(remuxer.Begin(still_bytes, 0, fileno(motion_photo_file)).code(),
+            absl::StatusCode::kUnimplemented);
+  EXPECT_EQ(GetBytesFromFd(fileno(motion_photo_file)), "");
+  EXPECT_EQ(remuxer.AppendVideo("video").code(),
+            absl::StatusCode::kFailedPrecondition);
+  fclose(motion_photo_file);
+}
+
+TEST(GenericRemuxing, CanFailToStreamAnIncorrectVideoType) {
+  std::string still_bytes = GetBytesFromFile("sample_data/jpeg/no_xmp.jpeg");
+
+  FILE *motion_photo_file = tmpfile();
+  Remuxer remuxer;
+  EXPECT_TRUE(remuxer.Begin(still_bytes, 0, fileno(motion_photo_file)).ok());
+  EXPECT_TRUE(remuxer.AppendVideo(still_bytes).ok());
+  EXPECT_EQ(remuxer.End().code(), absl::StatusCode::kInvalidArgument);
+  fclose(motion_photo_file);
+}
+
+TEST(GenericRemuxing, CanFailIfIncorrectVideoFileType) {
+  Remuxer remuxer;
+  EXPECT_EQ(remuxer.SetVideoFromFile("sample_data/jpeg/no_xmp.jpeg").code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_EQ(remuxer.SetVideoFromFile("sample_data/mp4/missing.mp4").code(),
+            absl::StatusCode::kNotFound);
+}
+
 TEST(GenericRemuxing, CanFailIfIncorrectStillType) {
   std::string video_bytes = GetBytesFromFile("sample_data/mp4/video.mp4");
 
@@ -0,0 +1,64 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "libmphoto/common/box_parser.h"
+
+#include <cstdint>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "tests/common/io_helper.h"
+
+namespace libmphoto {
+
+namespace {
+
+TEST(BoxParser, CanWriteTheMpvdBoxHeaderOfAHeicMotionPhoto) {
+  std::string motion_photo =
+      GetBytesFromFile("sample_data/heic_motion_photo/motion_photo.heic");
+  std::string video =
+      GetBytesFromFile("sample_data/heic_motion_photo/video.mp4");
+
+  std::string header;
+  ASSERT_TRUE(
+      WriteLargeBoxHeader(FourCC("mpvd"), video.length(), &header).ok());
+  ASSERT_EQ(header.length(), kLargeBoxHeaderSize);
+  EXPECT_EQ(motion_photo.substr(motion_photo.length() - video.length() -
+                                header.length()),
+            header + video);
+
+  BoxHeader box_header;
+  ASSERT_TRUE(
+      ParseBoxHeader(header, header.length() + video.length(), &box_header)
+          .ok());
+  EXPECT_EQ(box_header.type, FourCC("mpvd"));
+  EXPECT_EQ(box_header.size, header.length() + video.length());
+  EXPECT_EQ(box_header.header_size, kLargeBoxHeaderSize);
+}
+
+TEST(BoxParser, CanFailToWriteABoxHeaderWhenTheSizeOverflows) {
+  std::string header;
+  EXPECT_EQ(WriteLargeBoxHeader(FourCC("mpvd"),
+                                UINT64_MAX - kLargeBoxHeaderSize + 1u, &header)
+                .code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_TRUE(
+      WriteLargeBoxHeader(FourCC("mpvd"), UINT64_MAX - kLargeBoxHeaderSize,
+                          &header)
+          .ok());
+}
+
+}  // namespace
+
+}  // namespace libmphoto
@@ -0,0 +1,88 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "libmphoto/common/xmp_io/heic_xmp_io_helper.h"
+
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "libmphoto/common/byte_source.h"
+#include "libmphoto/common/xml/libxml_deleter.h"
+#include "tests/common/io_helper.h"
+
+namespace libmphoto {
+
+namespace {
+
+constexpr char kStartXmpMetadata[] = "<x:xmpmeta";
+
+TEST(HeicXmpIOHelper, CanReadXmpPacketWithoutCopying) {
+  std::string image =
+      GetBytesFromFile("sample_data/heic_motion_photo/motion_photo.heic");
+
+  HeicXmpIOHelper helper;
+  MemoryByteSource source(image);
+  std::string scratch;
+  absl::string_view xmp;
+  ASSERT_TRUE(helper.ReadXmpPacket(&source, &scratch, &xmp).ok());
+
+  EXPECT_TRUE(scratch.empty());
+  EXPECT_GE(xmp.data(), image.data());
+  EXPECT_LE(xmp.data() + xmp.length(), image.data() + image.length());
+  EXPECT_NE(xmp.find(kStartXmpMetadata), std::string::npos);
+}
+
+TEST(HeicXmpIOHelper, CanGetXmpFromMemoryByWalkingBoxes) {
+  std::string image =
+      GetBytesFromFile("sample_data/heic_motion_photo/motion_photo.heic");
+
+  HeicXmpIOHelper helper;
+  std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc = helper.GetXmp(image);
+  ASSERT_TRUE(xml_doc);
+  EXPECT_STREQ(reinterpret_cast<const char *>(
+                   xmlDocGetRootElement(xml_doc.get())->name),
+               "xmpmeta");
+}
+
+TEST(HeicXmpIOHelper, CanFailWhenXmpNotPresent) {
+  std::string image = GetBytesFromFile("sample_data/mp4/video.mp4");
+
+  HeicXmpIOHelper helper;
+  MemoryByteSource source(image);
+  std::string scratch;
+  absl::string_view xmp;
+  EXPECT_EQ(helper.ReadXmpPacket(&source, &scratch, &xmp).code(),
+            absl::StatusCode::kNotFound);
+}
+
+TEST(HeicXmpIOHelper, CanFailToEditXmp) {
+  std::string image =
+      GetBytesFromFile("sample_data/heic_motion_photo/motion_photo.heic");
+
+  HeicXmpIOHelper helper;
+  std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc = helper.GetXmp(image);
+  ASSERT_TRUE(xml_doc);
+
+  ImageEdit edit;
+  absl::Status status =
+      helper.GetXmpEdit(*xml_doc, image, XmpWriteOptions(), &edit);
+  EXPECT_EQ(status.code(), absl::StatusCode::kUnimplemented);
+  EXPECT_FALSE(status.message().empty());
+}
+
+}  // namespace
+
+}  // namespace libmphoto
@@ -0,0 +1,192 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "libmphoto/common/xmp_io/jpeg_xmp_io_helper.h"
+
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "libmphoto/common/byte_source.h"
+#include "libmphoto/common/xml/libxml_deleter.h"
+#include "libmphoto/common/xmp_io/jpeg_xmp_locator.h"
+#include "tests/common/io_helper.h"
+
+namespace libmphoto {
+
+namespace {
+
+constexpr char kTestAttribute[] = "test";
+constexpr char kWritableTrailer[] = "<?xpacket end=\"w\"?>";
+constexpr char kReadOnlyTrailer[] = "<?xpacket end=\"r\"?>";
+
+// Returns a segment with the given marker and payload.
+std::string GetSegment(char marker, const std::string &payload) {
+  std::string segment = "\xFF";
+  segment += marker;
+  segment += static_cast<char>((payload.length() + 2) >> 8);
+  segment += static_cast<char>((payload.length() + 2) & 0xFF);
+  return segment + payload;
+}
+
+// Returns the image with edit applied.
+std::string ApplyEdit(const std::string &image, const ImageEdit &edit) {
+  return image.substr(0, edit.offset) + edit.replacement +
+         image.substr(edit.offset + edit.length);
+}
+
+// Sets an attribute of the root element of xml_doc.
+void SetTestAttribute(xmlDoc *xml_doc, const std::string &value) {
+  xmlSetProp(xmlDocGetRootElement(xml_doc), BAD_CAST kTestAttribute,
+             BAD_CAST value.c_str());
+}
+
+// Returns the test attribute of the root element of the xmp of image.
+std::string GetTestAttribute(const absl::string_view image) {
+  JpegXmpIOHelper helper;
+  std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc = helper.GetXmp(image);
+  if (!xml_doc) {
+    return "";
+  }
+  xmlChar *value =
+      xmlGetProp(xmlDocGetRootElement(xml_doc.get()), BAD_CAST kTestAttribute);
+  std::string result = value ? reinterpret_cast<const char *>(value) : "";
+  xmlFree(value);
+  return result;
+}
+
+TEST(JpegXmpIOHelper, CanReadXmpPacketPastThePrefix) {
+  std::string image =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/motion_photo.jpeg");
+  absl::string_view expected_xmp;
+  ASSERT_TRUE(LocateJpegXmp(image, &expected_xmp).ok());
+  std::string expected(expected_xmp);
+
+  // An exif segment straddles the end of the prefix, cutting through its
+  // signature or after it, and is followed by stray bytes.
+  for (size_t cut : {10u, 100u}) {
+    std::string segments =
+        GetSegment('\xE2', std::string(kPrefixReadSize - cut - 6, '\0')) +
+        GetSegment('\xE1', std::string("Exif\0\0", 6) +
+                                std::string(1000, '\0')) +
+        "stray";
+    std::string padded_image = image;
+    padded_image.insert(2, segments);
+
+    MemoryByteSource source(padded_image);
+    JpegXmpIOHelper helper;
+    std::string scratch;
+    absl::string_view xmp;
+    ASSERT_TRUE(helper.ReadXmpPacket(&source, &scratch, &xmp).ok());
+    EXPECT_EQ(xmp, expected);
+  }
+}
+
+TEST(JpegXmpIOHelper, CanWriteXmpInPlace) {
+  std::string image = GetBytesFromFile("sample_data/jpeg/existing_xmp.jpeg");
+
+  JpegXmpIOHelper helper;
+  std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc = helper.GetXmp(image);
+  ASSERT_TRUE(xml_doc);
+  SetTestAttribute(xml_doc.get(), "value");
+
+  XmpWriteOptions options;
+  options.in_place = true;
+  ImageEdit edit;
+  ASSERT_TRUE(helper.GetXmpEdit(*xml_doc, image, options, &edit).ok());
+  EXPECT_TRUE(edit.in_place);
+  EXPECT_EQ(edit.replacement.length(), edit.length);
+
+  std::string updated_image = ApplyEdit(image, edit);
+  EXPECT_EQ(updated_image.length(), image.length());
+  EXPECT_EQ(GetTestAttribute(updated_image), "value");
+}
+
+TEST(JpegXmpIOHelper, CanSpliceSegmentWhenXmpDoesNotFit) {
+  std::string image = GetBytesFromFile("sample_data/jpeg/existing_xmp.jpeg");
+
+  JpegXmpIOHelper helper;
+  std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc = helper.GetXmp(image);
+  ASSERT_TRUE(xml_doc);
+  std::string value(8 * 1024, 'x');
+  SetTestAttribute(xml_doc.get(), value);
+
+  XmpWriteOptions options;
+  options.in_place = true;
+  ImageEdit edit;
+  ASSERT_TRUE(helper.GetXmpEdit(*xml_doc, image, options, &edit).ok());
+  EXPECT_FALSE(edit.in_place);
+  EXPECT_GT(edit.replacement.length(), edit.length);
+
+  std::string updated_image = ApplyEdit(image, edit);
+  EXPECT_EQ(GetTestAttribute(updated_image), value);
+
+  // The new packet is padded, so a later update of the same size fits.
+  SetTestAttribute(xml_doc.get(), std::string(value.length(), 'y'));
+  ASSERT_TRUE(
+      helper.GetXmpEdit(*xml_doc, updated_image, options, &edit).ok());
+  EXPECT_TRUE(edit.in_place);
+}
+
+TEST(JpegXmpIOHelper, CanPadNewXmpSegment) {
+  std::string image = GetBytesFromFile("sample_data/jpeg/no_xmp.jpeg");
+
+  JpegXmpIOHelper helper;
+  std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc = helper.GetXmp(
+      GetBytesFromFile("sample_data/jpeg_motion_photo/still.jpeg"));
+  ASSERT_TRUE(xml_doc);
+
+  XmpWriteOptions options;
+  options.in_place = true;
+  ImageEdit edit;
+  ASSERT_TRUE(helper.GetXmpEdit(*xml_doc, image, options, &edit).ok());
+  EXPECT_FALSE(edit.in_place);
+  std::string updated_image = ApplyEdit(image, edit);
+
+  SetTestAttribute(xml_doc.get(), "value");
+  ASSERT_TRUE(
+      helper.GetXmpEdit(*xml_doc, updated_image, options, &edit).ok());
+  EXPECT_TRUE(edit.in_place);
+  EXPECT_EQ(GetTestAttribute(ApplyEdit(updated_image, edit)), "value");
+}
+
+TEST(JpegXmpIOHelper, CanKeepTheXpacketEndWhenWritingInPlace) {
+  std::string image = GetBytesFromFile("sample_data/jpeg/existing_xmp.jpeg");
+  size_t trailer = image.find(kWritableTrailer);
+  ASSERT_NE(trailer, std::string::npos);
+  image.replace(trailer, sizeof(kReadOnlyTrailer) - 1, kReadOnlyTrailer);
+
+  JpegXmpIOHelper helper;
+  std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc = helper.GetXmp(image);
+  ASSERT_TRUE(xml_doc);
+  SetTestAttribute(xml_doc.get(), "value");
+
+  XmpWriteOptions options;
+  options.in_place = true;
+  ImageEdit edit;
+  ASSERT_TRUE(helper.GetXmpEdit(*xml_doc, image, options, &edit).ok());
+  ASSERT_TRUE(edit.in_place);
+  EXPECT_NE(edit.replacement.find(kReadOnlyTrailer), std::string::npos);
+  EXPECT_EQ(edit.replacement.find(kWritableTrailer), std::string::npos);
+
+  // New segments are padded for later updates, so are writable.
+  SetTestAttribute(xml_doc.get(), std::string(8 * 1024, 'x'));
+  ASSERT_TRUE(helper.GetXmpEdit(*xml_doc, image, options, &edit).ok());
+  ASSERT_FALSE(edit.in_place);
+  EXPECT_NE(edit.replacement.find(kWritableTrailer), std::string::npos);
+}
+
+}  // namespace
+
+}  // namespace libmphoto
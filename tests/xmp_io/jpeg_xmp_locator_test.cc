@@ -0,0 +1,120 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "libmphoto/common/xmp_io/jpeg_xmp_locator.h"
+#include "tests/common/io_helper.h"
+
+namespace libmphoto {
+
+namespace {
+
+constexpr char kStartXmpMetadata[] = "<x:xmpmeta";
+constexpr char kEndXmpMetadata[] = "</x:xmpmeta>";
+
+// Returns an APP2 segment with a payload of length zero bytes.
+std::string GetApp2Segment(size_t length) {
+  std::string segment = "\xFF\xE2";
+  segment += static_cast<char>((length + 2) >> 8);
+  segment += static_cast<char>((length + 2) & 0xFF);
+  return segment + std::string(length, '\0');
+}
+
+// Checks xmp is a view into image holding its xmp metadata.
+void ExpectXmpWithin(const std::string &image, absl::string_view xmp) {
+  EXPECT_GE(xmp.data(), image.data());
+  EXPECT_LE(xmp.data() + xmp.length(), image.data() + image.length());
+  EXPECT_NE(xmp.find(kStartXmpMetadata), std::string::npos);
+  EXPECT_NE(xmp.find(kEndXmpMetadata), std::string::npos);
+}
+
+}  // namespace
+
+TEST(JpegXmpLocator, CanLocateXmpWithoutCopying) {
+  std::string image =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/motion_photo.jpeg");
+
+  absl::string_view xmp;
+  EXPECT_TRUE(LocateJpegXmp(image, &xmp).ok());
+  ExpectXmpWithin(image, xmp);
+}
+
+TEST(JpegXmpLocator, CanLocateXmpAfterManySegments) {
+  std::string image =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/motion_photo.jpeg");
+
+  std::string segments;
+  for (int i = 0; i < 1000; i++) {
+    segments += GetApp2Segment(i);
+  }
+  image.insert(2, segments);
+
+  absl::string_view xmp;
+  EXPECT_TRUE(LocateJpegXmp(image, &xmp).ok());
+  ExpectXmpWithin(image, xmp);
+}
+
+TEST(JpegXmpLocator, CanLocateXmpAfterFillAndStrayBytes) {
+  std::string image =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/motion_photo.jpeg");
+
+  // Fill bytes before a marker, followed by stray bytes before the next.
+  image.insert(2, GetApp2Segment(10) + std::string(100, '\x00') +
+                      std::string(40, '\xFF'));
+
+  absl::string_view xmp;
+  EXPECT_TRUE(LocateJpegXmp(image, &xmp).ok());
+  ExpectXmpWithin(image, xmp);
+}
+
+TEST(JpegXmpLocator, CanFailWhenXmpNotPresent) {
+  std::string image = GetBytesFromFile("sample_data/jpeg/no_xmp.jpeg");
+
+  absl::string_view xmp;
+  EXPECT_EQ(LocateJpegXmp(image, &xmp).code(), absl::StatusCode::kNotFound);
+}
+
+TEST(JpegXmpLocator, CanFailWhenNotAJpeg) {
+  std::string video = GetBytesFromFile("sample_data/mp4/video.mp4");
+
+  absl::string_view xmp;
+  EXPECT_EQ(LocateJpegXmp(video, &xmp).code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+TEST(JpegXmpLocator, CanFailWhenSegmentIsTruncated) {
+  std::string image =
+      GetBytesFromFile("sample_data/jpeg_motion_photo/motion_photo.jpeg");
+  std::string truncated = image.substr(0, image.find(kStartXmpMetadata));
+
+  absl::string_view xmp;
+  EXPECT_EQ(LocateJpegXmp(truncated, &xmp).code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+TEST(JpegXmpLocator, CanScanForBytes) {
+  std::string data(100, 'a');
+  data[37] = '\xFF';
+  data[90] = '\xFF';
+
+  EXPECT_EQ(ScanForByte(data, 0, '\xFF', true), 37u);
+  EXPECT_EQ(ScanForByte(data, 38, '\xFF', true), 90u);
+  EXPECT_EQ(ScanForByte(data, 91, '\xFF', true), data.length());
+  EXPECT_EQ(ScanForByte(data, 0, 'a', false), 37u);
+  EXPECT_EQ(ScanForByte(data, 37, '\xFF', false), 38u);
+}
+
+}  // namespace libmphoto
@@ -0,0 +1,89 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "libmphoto/common/stream_parser.h"
+#include "tests/common/io_helper.h"
+
+namespace libmphoto {
+
+namespace {
+
+// Returns a big endian 32 bit integer.
+std::string GetUint32(uint32_t value) {
+  std::string bytes;
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    bytes += static_cast<char>((value >> shift) & 0xFF);
+  }
+  return bytes;
+}
+
+// Returns an ftyp box with the given four character brands.
+std::string GetFtypBox(const std::string &major_brand,
+                       const std::string &compatible_brands) {
+  std::string payload = major_brand + GetUint32(0) + compatible_brands;
+  return GetUint32(8 + payload.length()) + "ftyp" + payload;
+}
+
+}  // namespace
+
+TEST(StreamParsing, CanIdentifySampleStreams) {
+  EXPECT_EQ(GetStreamMimeType(GetBytesFromFile(
+                "sample_data/jpeg_motion_photo/motion_photo.jpeg")),
+            MimeType::kImageJpeg);
+  EXPECT_EQ(GetStreamMimeType(GetBytesFromFile(
+                "sample_data/heic_motion_photo/motion_photo.heic")),
+            MimeType::kImageHeic);
+  EXPECT_EQ(GetStreamMimeType(GetBytesFromFile("sample_data/mp4/video.mp4")),
+            MimeType::kVideoMp4);
+}
+
+TEST(StreamParsing, CanIdentifyAvifAndHeifSequences) {
+  EXPECT_EQ(GetStreamMimeType(GetFtypBox("avif", "mif1miaf")),
+            MimeType::kImageAvif);
+  EXPECT_EQ(GetStreamMimeType(GetFtypBox("avis", "msf1avif")),
+            MimeType::kImageAvif);
+  EXPECT_EQ(GetStreamMimeType(GetFtypBox("msf1", "msf1hevc")),
+            MimeType::kImageHeifSequence);
+  EXPECT_EQ(GetStreamMimeType(GetFtypBox("hevc", "")),
+            MimeType::kImageHeifSequence);
+}
+
+TEST(StreamParsing, CanUseCompatibleBrandsAfterAGenericMajorBrand) {
+  EXPECT_EQ(GetStreamMimeType(GetFtypBox("mif1", "mif1avif")),
+            MimeType::kImageAvif);
+  EXPECT_EQ(GetStreamMimeType(GetFtypBox("mif1", "miaf")),
+            MimeType::kImageHeic);
+  EXPECT_EQ(GetStreamMimeType(GetFtypBox("qt  ", "qt  isom")),
+            MimeType::kVideoMp4);
+}
+
+TEST(StreamParsing, CanIgnoreBrandsOutsideTheFtypBox) {
+  std::string stream = GetFtypBox("3gp4", "") + "isom";
+  EXPECT_EQ(GetStreamMimeType(stream), MimeType::kUnknownMimeType);
+}
+
+TEST(StreamParsing, CanHandleTruncatedStreams) {
+  std::string ftyp = GetFtypBox("mif1", "heic");
+  EXPECT_EQ(GetStreamMimeType(ftyp.substr(0, 16)), MimeType::kImageHeic);
+  EXPECT_EQ(GetStreamMimeType(ftyp.substr(0, 12)),
+            MimeType::kUnknownMimeType);
+  EXPECT_EQ(GetStreamMimeType("\xFF"), MimeType::kUnknownMimeType);
+  EXPECT_EQ(GetStreamMimeType(""), MimeType::kUnknownMimeType);
+}
+
+}  // namespace libmphoto
@@ -0,0 +1,136 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "libmphoto/common/xml/xml_parser.h"
+
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "libmphoto/common/xml/libxml_deleter.h"
+
+namespace libmphoto {
+
+namespace {
+
+constexpr char kXmp[] =
+    "<x:xmpmeta xmlns:x='adobe:ns:meta/'>"
+    "<rdf:RDF xmlns:rdf='http://www.w3.org/1999/02/22-rdf-syntax-ns#'>"
+    "<rdf:Description/>"
+    "</rdf:RDF></x:xmpmeta>";
+
+TEST(XmlParser, SharesDictionaryOnlyWhileReuseIsEnabled) {
+  std::unique_ptr<xmlDoc, LibXmlDeleter> first = ReadXmlFromMemory(kXmp);
+  std::unique_ptr<xmlDoc, LibXmlDeleter> second = ReadXmlFromMemory(kXmp);
+  ASSERT_TRUE(first && second);
+  EXPECT_NE(first->dict, second->dict);
+
+  ScopedXmlParserReuse disabled(false);
+  first = ReadXmlFromMemory(kXmp);
+  second = ReadXmlFromMemory(kXmp);
+  ASSERT_TRUE(first && second);
+  EXPECT_NE(first->dict, second->dict);
+
+  {
+    ScopedXmlParserReuse enabled(true);
+    first = ReadXmlFromMemory(kXmp);
+    second = ReadXmlFromMemory(kXmp);
+    ASSERT_TRUE(first && second);
+    ASSERT_NE(first->dict, nullptr);
+    EXPECT_EQ(first->dict, second->dict);
+    EXPECT_EQ(first->children->name, second->children->name);
+  }
+
+  // Documents outlive the scope they were parsed in.
+  EXPECT_STREQ(reinterpret_cast<const char *>(second->children->name),
+               "xmpmeta");
+}
+
+TEST(XmlParser, ReusedContextRecoversFromMalformedXml) {
+  ScopedXmlParserReuse reuse(true);
+  EXPECT_FALSE(ReadXmlFromMemory("<x:xmpmeta xmlns:x='adobe:ns:meta/'>"));
+  EXPECT_FALSE(ReadXmlFromMemory(""));
+
+  std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc = ReadXmlFromMemory(kXmp);
+  ASSERT_TRUE(xml_doc);
+  EXPECT_STREQ(reinterpret_cast<const char *>(
+                   xmlDocGetRootElement(xml_doc.get())->name),
+               "xmpmeta");
+}
+
+// Returns an xmp with elements nested depth deep below the root.
+std::string GetNestedXmp(int depth) {
+  std::string xmp = "<x:xmpmeta xmlns:x='adobe:ns:meta/'>";
+  for (int i = 0; i < depth; i++) {
+    xmp += "<a>";
+  }
+  for (int i = 0; i < depth; i++) {
+    xmp += "</a>";
+  }
+  return xmp + "</x:xmpmeta>";
+}
+
+TEST(XmlParser, RejectsXmpExceedingLimits) {
+  ParseLimits limits;
+  limits.max_xmp_bytes = 1024;
+  limits.max_depth = 8;
+  limits.max_attributes = 2;
+  std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc;
+
+  for (bool reuse : {false, true}) {
+    ScopedXmlParserReuse xml_parser_reuse(reuse);
+    ScopedXmlParseLimits parse_limits(limits);
+    EXPECT_TRUE(ReadXmlFromMemory(GetNestedXmp(7), &xml_doc).ok());
+    EXPECT_TRUE(parse_limits.status().ok());
+
+    EXPECT_EQ(ReadXmlFromMemory(GetNestedXmp(8), &xml_doc).code(),
+              absl::StatusCode::kResourceExhausted);
+    EXPECT_FALSE(xml_doc);
+    EXPECT_EQ(parse_limits.status().code(),
+              absl::StatusCode::kResourceExhausted);
+
+    EXPECT_EQ(ReadXmlFromMemory(std::string(1025, ' '), &xml_doc).code(),
+              absl::StatusCode::kResourceExhausted);
+    EXPECT_EQ(ReadXmlFromMemory("<a b='1' c='2' d='3'/>", &xml_doc).code(),
+              absl::StatusCode::kResourceExhausted);
+    EXPECT_TRUE(ReadXmlFromMemory("<a b='1' c='2'/>", &xml_doc).ok());
+    EXPECT_EQ(ReadXmlFromMemory("<a>", &xml_doc).code(),
+              absl::StatusCode::kInvalidArgument);
+  }
+
+  // Limits only apply within the scope.
+  EXPECT_TRUE(ReadXmlFromMemory(GetNestedXmp(8), &xml_doc).ok());
+}
+
+TEST(XmlParser, RejectsEntityDeclarationsUnlessDtdAllowed) {
+  constexpr char kEntityXmp[] =
+      "<!DOCTYPE a [<!ENTITY e 'expanded'>]><a b='&e;'/>";
+  std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc;
+
+  ParseLimits limits;
+  {
+    ScopedXmlParseLimits parse_limits(limits);
+    EXPECT_EQ(ReadXmlFromMemory(kEntityXmp, &xml_doc).code(),
+              absl::StatusCode::kResourceExhausted);
+  }
+
+  limits.allow_dtd = true;
+  ScopedXmlParseLimits parse_limits(limits);
+  EXPECT_TRUE(ReadXmlFromMemory(kEntityXmp, &xml_doc).ok());
+}
+
+}  // namespace
+
+}  // namespace libmphoto
@@ -0,0 +1,193 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "libmphoto/common/xml/libxml_deleter.h"
+#include "libmphoto/common/xml/xml_utils.h"
+#include "libmphoto/common/xmp_field_paths.h"
+#include "libmphoto/common/xmp_io/xmp_io_helper.h"
+#include "libxml/parser.h"
+#include "tests/common/io_helper.h"
+
+namespace libmphoto {
+
+namespace {
+
+// Fields spread across descriptions, with the first rdf:li lacking a value
+// and a second list whose entries must not be counted with the first.
+constexpr char kSplitXmp[] =
+    "<x:xmpmeta xmlns:x='adobe:ns:meta/'>"
+    "<rdf:RDF xmlns:rdf='http://www.w3.org/1999/02/22-rdf-syntax-ns#'"
+    "    xmlns:Camera='http://ns.google.com/photos/1.0/camera/'"
+    "    xmlns:Container='http://ns.google.com/photos/1.0/container/'"
+    "    xmlns:Item='http://ns.google.com/photos/1.0/container/item/'>"
+    "<rdf:Description Camera:MotionPhotoVersion='1'/>"
+    "<rdf:Description Camera:MotionPhoto='' Camera:MicroVideo='1'>"
+    "<Container:Directory><rdf:Seq>"
+    "<rdf:li><Container:Item Item:Length='1'/>"
+    "<Container:Item Item:Mime='image/jpeg'/></rdf:li>"
+    "<rdf:Bag/>"
+    "<rdf:li><Container:Item Item:Mime='video/mp4' Item:Length='2'/></rdf:li>"
+    "</rdf:Seq><rdf:Seq>"
+    "<rdf:li><Container:Item Item:Padding='3'/></rdf:li>"
+    "</rdf:Seq></Container:Directory></rdf:Description>"
+    "<rdf:Description Camera:MotionPhoto='1'/>"
+    "</rdf:RDF></x:xmpmeta>";
+
+constexpr const char *kFieldXPaths[] = {
+    kMotionPhotoXPath,
+    kMotionPhotoVersionXPath,
+    kMotionPhotoPresentationTimestampUsXPath,
+    kImageMimeTypeXPath,
+    kVideoMimeTypeXPath,
+    kVideoLengthXPath,
+    kStillPaddingXPath,
+    kMicrovideoXPath,
+    kMicrovideoVersionXPath,
+    kMicrovideoOffsetXPath,
+    kMicrovideoPresentationTimestampUsXPath};
+constexpr size_t kFieldCount = sizeof(kFieldXPaths) / sizeof(kFieldXPaths[0]);
+
+std::unique_ptr<xmlDoc, LibXmlDeleter> ParseXml(const char *xml) {
+  return std::unique_ptr<xmlDoc, LibXmlDeleter>(
+      xmlReadMemory(xml, std::strlen(xml), ".xml", nullptr, 0));
+}
+
+// Checks the single walk lookup agrees with evaluating each xpath.
+void ExpectLookupMatchesXPaths(const xmlDoc &xml_doc) {
+  XmlFieldLookup lookup;
+  ASSERT_TRUE(FindXmlAttributes(kFieldXPaths, kFieldCount, kNamespaces,
+                                xml_doc, &lookup)
+                  .ok());
+  EXPECT_EQ(lookup.found | lookup.missing, (1u << kFieldCount) - 1);
+  EXPECT_EQ(lookup.found & lookup.missing, 0u);
+
+  auto xpath_context =
+      GetXPathContext(kNamespaces, const_cast<xmlDoc *>(&xml_doc));
+  ASSERT_TRUE(xpath_context);
+  for (size_t i = 0; i < kFieldCount; i++) {
+    std::string value;
+    bool found = FindXmlAttributeValue(kFieldXPaths[i], *xpath_context, &value);
+    ASSERT_EQ(found, (lookup.found >> i) & 1) << kFieldXPaths[i];
+    if (found) {
+      EXPECT_EQ(GetXmlAttributeValue(*lookup.attributes[i]), value)
+          << kFieldXPaths[i];
+    } else {
+      EXPECT_EQ(lookup.attributes[i], nullptr);
+    }
+  }
+}
+
+}  // namespace
+
+TEST(XmlUtils, FindXmlAttributesMatchesXPathsOnSampleData) {
+  for (const char *path : {"sample_data/jpeg_motion_photo/motion_photo.jpeg",
+                           "sample_data/microvideo/still.jpeg"}) {
+    std::string image = GetBytesFromFile(path);
+    std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc =
+        GetXmpIOHelper(image)->GetXmp(image);
+    ASSERT_TRUE(xml_doc) << path;
+    ExpectLookupMatchesXPaths(*xml_doc);
+  }
+}
+
+TEST(XmlUtils, FindXmlAttributesMatchesXPathsAcrossDescriptions) {
+  std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc = ParseXml(kSplitXmp);
+  ASSERT_TRUE(xml_doc);
+  ExpectLookupMatchesXPaths(*xml_doc);
+
+  // The first motion photo attribute in document order is selected, even
+  // though it is empty and a later one is not.
+  XmlFieldLookup lookup;
+  ASSERT_TRUE(FindXmlAttributes(kFieldXPaths, kFieldCount, kNamespaces,
+                                *xml_doc, &lookup)
+                  .ok());
+  EXPECT_EQ(GetXmlAttributeValue(*lookup.attributes[0]), "");
+  EXPECT_EQ(GetXmlAttributeValue(*lookup.attributes[3]), "image/jpeg");
+  EXPECT_EQ(GetXmlAttributeValue(*lookup.attributes[5]), "2");
+  EXPECT_EQ(GetXmlAttributeValue(*lookup.attributes[6]), "3");
+  EXPECT_EQ(lookup.missing, 1u << 2 | 1u << 8 | 1u << 9 | 1u << 10);
+}
+
+TEST(XmlUtils, CanEvaluateXPathsCallingFunctionsOnManyThreads) {
+  // Evaluating last() writes to the compiled xpath.
+  constexpr char kLastDescriptionXPath[] =
+      "//rdf:Description[last()]/@Camera:MotionPhoto";
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; i++) {
+    threads.emplace_back([&kLastDescriptionXPath]() {
+      std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc = ParseXml(kSplitXmp);
+      ASSERT_TRUE(xml_doc);
+      auto xpath_context = GetXPathContext(kNamespaces, xml_doc.get());
+      ASSERT_TRUE(xpath_context);
+      for (int j = 0; j < 1000; j++) {
+        std::string value;
+        ASSERT_TRUE(FindXmlAttributeValue(kLastDescriptionXPath,
+                                          *xpath_context, &value));
+        EXPECT_EQ(value, "1");
+      }
+    });
+  }
+
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+}
+
+TEST(XmlUtils, CanSetXmlAttributesFoundInOneWalk) {
+  std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc = ParseXml(kSplitXmp);
+  ASSERT_TRUE(xml_doc);
+
+  XmlFieldLookup lookup;
+  ASSERT_TRUE(FindXmlAttributes(kFieldXPaths, kFieldCount, kNamespaces,
+                                *xml_doc, &lookup)
+                  .ok());
+  EXPECT_TRUE(CheckXmlFieldsFound(lookup, 1u << 5, kFieldXPaths).ok());
+  EXPECT_EQ(CheckXmlFieldsFound(lookup, 1u << 2, kFieldXPaths).code(),
+            absl::StatusCode::kNotFound);
+
+  SetXmlAttributeValue("12345", lookup.attributes[5]);
+  auto xpath_context = GetXPathContext(kNamespaces, xml_doc.get());
+  std::string value;
+  EXPECT_TRUE(
+      GetXmlAttributeValue(kVideoLengthXPath, *xpath_context, &value).ok());
+  EXPECT_EQ(value, "12345");
+}
+
+TEST(XmlUtils, FindXmlAttributesRejectsUnsupportedXPaths) {
+  std::unique_ptr<xmlDoc, LibXmlDeleter> xml_doc = ParseXml(kSplitXmp);
+  ASSERT_TRUE(xml_doc);
+
+  XmlFieldLookup lookup;
+  for (const char *xpath :
+       {"/x:xmpmeta/rdf:RDF", "//rdf:Description/@Camera:MotionPhoto",
+        "/x:xmpmeta/rdf:RDF/rdf:Description[last()]/@Camera:MotionPhoto",
+        "/x:xmpmeta/rdf:RDF/rdf:Description/@Camera:MotionPhoto[1]",
+        "/x:xmpmeta/Unknown:RDF/@Camera:MotionPhoto"}) {
+    EXPECT_EQ(
+        FindXmlAttributes(&xpath, 1, kNamespaces, *xml_doc, &lookup).code(),
+        absl::StatusCode::kInvalidArgument)
+        << xpath;
+  }
+}
+
+}  // namespace libmphoto